@@ -0,0 +1,229 @@
+/* bl-highlight-bench.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+// Loads each markdown file given on the command line into a document
+// and times how long it takes to highlight from scratch. A markdown
+// view is attached when a display is available, but never shown, so
+// the viewport-first path is exercised as well. Results are printed
+// to stdout as JSON.
+
+#include "bl-document.h"
+#include "bl-markdown-view.h"
+
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#define DEFAULT_ITERATIONS 5
+
+typedef struct
+{
+    gint64 parse_time;
+    gint64 apply_time;
+    gint64 wall_time;
+    guint spans;
+} BenchRun;
+
+static gint
+compare_runs (const BenchRun *a,
+              const BenchRun *b)
+{
+    gint64 total_a = a->parse_time + a->apply_time;
+    gint64 total_b = b->parse_time + b->apply_time;
+    return (total_a > total_b) - (total_a < total_b);
+}
+
+static gboolean
+run_once (GFile    *file,
+          gboolean  have_display,
+          BenchRun *run)
+{
+    BlDocument *document = bl_document_new_untitled ();
+    BlHighlighter *highlighter = bl_document_get_highlighter (document);
+
+    // Highlight as soon as the text is in, and in as few chunks as
+    // possible, so the timings are not dominated by the scheduler
+    bl_highlighter_set_delay (highlighter, 0, 0);
+    bl_highlighter_set_budget (highlighter, 1000);
+
+    GtkWidget *view = NULL;
+
+    if (have_display)
+    {
+        view = g_object_ref_sink (g_object_new (BL_TYPE_MARKDOWN_VIEW, NULL));
+        bl_markdown_view_set_buffer (BL_MARKDOWN_VIEW (view), GTK_TEXT_BUFFER (document));
+        bl_markdown_view_set_highlight_delay (BL_MARKDOWN_VIEW (view), 0, 0);
+        bl_markdown_view_set_highlight_budget (BL_MARKDOWN_VIEW (view), 1000);
+    }
+
+    // Highlighting is held back until the file is in
+    bl_document_load (document, file, 0);
+
+    while (bl_document_is_loading (document))
+        g_main_context_iteration (NULL, TRUE);
+
+    gint64 start = g_get_monotonic_time ();
+
+    while (bl_highlighter_is_busy (highlighter))
+        g_main_context_iteration (NULL, TRUE);
+
+    const BlHighlightStats *stats = bl_highlighter_get_stats (highlighter);
+    run->wall_time = g_get_monotonic_time () - start;
+    run->parse_time = stats->last_parse_time;
+    run->apply_time = stats->last_apply_time;
+    run->spans = stats->last_spans;
+
+    gboolean ok = bl_document_get_load_error (document) == NULL;
+
+    if (view != NULL)
+    {
+        gtk_widget_destroy (view);
+        g_object_unref (view);
+    }
+
+    g_object_unref (document);
+    return ok;
+}
+
+static gboolean
+bench_file (const gchar *path,
+            guint        iterations,
+            gboolean     have_display,
+            gboolean     first)
+{
+    GFile *file = g_file_new_for_path (path);
+    GFileInfo *info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    if (info == NULL)
+    {
+        g_printerr ("Could not read %s\n", path);
+        g_object_unref (file);
+        return FALSE;
+    }
+
+    goffset size = g_file_info_get_size (info);
+    g_object_unref (info);
+
+    GArray *runs = g_array_sized_new (FALSE, FALSE, sizeof (BenchRun), iterations);
+
+    for (guint i = 0; i < iterations; i++)
+    {
+        BenchRun run;
+
+        if (!run_once (file, have_display, &run))
+        {
+            g_printerr ("Could not load %s\n", path);
+            g_array_free (runs, TRUE);
+            g_object_unref (file);
+            return FALSE;
+        }
+
+        g_array_append_val (runs, run);
+    }
+
+    // Report the median run
+    g_array_sort (runs, (GCompareFunc) compare_runs);
+    BenchRun *median = &g_array_index (runs, BenchRun, runs->len / 2);
+
+    gint64 total = median->parse_time + median->apply_time;
+    gdouble spans_per_second = total > 0 ? median->spans * (G_USEC_PER_SEC / (gdouble)total) : 0;
+
+    gchar *name = g_file_get_basename (file);
+    gchar *escaped = g_strescape (name, NULL);
+
+    g_print ("%s    {\n"
+             "      \"file\": \"%s\",\n"
+             "      \"bytes\": %" G_GINT64_FORMAT ",\n"
+             "      \"iterations\": %u,\n"
+             "      \"parse_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"apply_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"wall_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"spans\": %u,\n"
+             "      \"spans_per_second\": %.0f\n"
+             "    }",
+             first ? "" : ",\n",
+             escaped, (gint64)size, iterations,
+             median->parse_time, median->apply_time, median->wall_time,
+             median->spans, spans_per_second);
+
+    g_free (escaped);
+    g_free (name);
+    g_array_free (runs, TRUE);
+    g_object_unref (file);
+    return TRUE;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gint iterations = DEFAULT_ITERATIONS;
+    gchar **files = NULL;
+    GError *error = NULL;
+
+    GOptionEntry entries[] = {
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Runs per file", "N" },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL, "FILE…" },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new ("- benchmark markdown highlighting");
+    g_option_context_add_main_entries (context, entries, NULL);
+
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    g_option_context_free (context);
+
+    if (files == NULL || iterations < 1)
+    {
+        g_printerr ("Usage: %s [-n N] FILE…\n", g_get_prgname ());
+        return EXIT_FAILURE;
+    }
+
+    // Documents work without a display, views do not
+    gboolean have_display = gtk_init_check (&argc, &argv);
+
+    g_print ("{\n"
+             "  \"display\": %s,\n"
+             "  \"results\": [\n",
+             have_display ? "true" : "false");
+
+    gboolean ok = TRUE;
+
+    for (guint i = 0; files[i] != NULL && ok; i++)
+        ok = bench_file (files[i], iterations, have_display, i == 0);
+
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    // ru_maxrss is in kilobytes on Linux
+    g_print ("\n  ],\n"
+             "  \"peak_rss_kb\": %ld\n"
+             "}\n",
+             usage.ru_maxrss);
+
+    g_strfreev (files);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
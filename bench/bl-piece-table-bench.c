@@ -0,0 +1,393 @@
+/* bl-piece-table-bench.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Compares the piece table with a GtkTextBuffer holding the same file:
+// opening it, making random small edits, mapping offsets to lines and
+// back, and reading out a screenful of lines. Each backend is run in
+// its own process so that peak memory use can be told apart. Unless a
+// file is given, one of `--size` megabytes is generated first. Results
+// are printed to stdout as JSON.
+
+#include "bl-piece-table.h"
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define DEFAULT_SIZE_MB 1024
+#define DEFAULT_OPERATIONS 10000
+
+// Lines read out at a time, as the editor does for its window
+#define WINDOW_LINES 256
+
+#define EDIT_TEXT "edited! "
+#define EDIT_LENGTH 8
+
+typedef struct
+{
+    gint64 open_time;
+    gint64 edit_time;
+    gint64 lookup_time;
+    gint64 read_time;
+    guint pieces;
+} BenchResult;
+
+// Random edits and lookups, the same for either backend
+typedef struct
+{
+    GRand *rand;
+    gsize length;
+} BenchCursor;
+
+static gsize
+next_offset (BenchCursor *cursor)
+{
+    return (gsize)(g_rand_double (cursor->rand) * cursor->length);
+}
+
+// Plain ASCII, so byte and character offsets agree
+static gboolean
+generate_file (const gchar *path,
+               gsize        size)
+{
+    FILE *out = g_fopen (path, "w");
+
+    if (out == NULL)
+        return FALSE;
+
+    gsize written = 0;
+
+    for (guint section = 0; written < size; section++)
+    {
+        written += fprintf (out, "## Section %u\n\n", section);
+
+        for (guint line = 0; line < 8; line++)
+            written += fprintf (out, "Line %u of section %u, with *some* emphasis and `code`.\n",
+                                line, section);
+
+        written += fprintf (out, "\n");
+    }
+
+    return fclose (out) == 0;
+}
+
+static gboolean
+bench_pieces (const gchar *path,
+              guint        operations,
+              BenchResult *result)
+{
+    gint64 start = g_get_monotonic_time ();
+
+    GMappedFile *mapped = g_mapped_file_new (path, FALSE, NULL);
+
+    if (mapped == NULL)
+        return FALSE;
+
+    GBytes *bytes = g_mapped_file_get_bytes (mapped);
+    BlPieceTable *table = bl_piece_table_new (bytes);
+    g_bytes_unref (bytes);
+    g_mapped_file_unref (mapped);
+
+    result->open_time = g_get_monotonic_time () - start;
+
+    BenchCursor cursor = { g_rand_new_with_seed (42), bl_piece_table_get_length (table) };
+
+    start = g_get_monotonic_time ();
+
+    for (guint i = 0; i < operations; i++)
+    {
+        gsize offset = next_offset (&cursor);
+
+        if (i % 2 == 0)
+        {
+            bl_piece_table_insert (table, offset, EDIT_TEXT, EDIT_LENGTH);
+            cursor.length += EDIT_LENGTH;
+        }
+        else
+        {
+            gsize length = MIN (EDIT_LENGTH, cursor.length - offset);
+            bl_piece_table_delete (table, offset, length);
+            cursor.length -= length;
+        }
+    }
+
+    result->edit_time = g_get_monotonic_time () - start;
+    start = g_get_monotonic_time ();
+
+    for (guint i = 0; i < operations; i++)
+    {
+        guint line = bl_piece_table_get_line_at_offset (table, next_offset (&cursor));
+        bl_piece_table_get_line_start (table, line);
+    }
+
+    result->lookup_time = g_get_monotonic_time () - start;
+    start = g_get_monotonic_time ();
+
+    guint n_lines = bl_piece_table_get_n_lines (table);
+
+    for (guint i = 0; i < operations / 100; i++)
+    {
+        guint first = g_rand_int_range (cursor.rand, 0, n_lines);
+        gsize from = bl_piece_table_get_line_start (table, first);
+        gsize to = bl_piece_table_get_line_start (table, first + WINDOW_LINES);
+        g_free (bl_piece_table_get_text (table, from, to - from));
+    }
+
+    result->read_time = g_get_monotonic_time () - start;
+    result->pieces = bl_piece_table_get_n_pieces (table);
+
+    g_rand_free (cursor.rand);
+    bl_piece_table_unref (table);
+    return TRUE;
+}
+
+static gboolean
+bench_buffer (const gchar *path,
+              guint        operations,
+              BenchResult *result)
+{
+    gint64 start = g_get_monotonic_time ();
+
+    gchar *contents;
+    gsize length;
+
+    if (!g_file_get_contents (path, &contents, &length, NULL))
+        return FALSE;
+
+    GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+    gtk_text_buffer_set_text (buffer, contents, length);
+    g_free (contents);
+
+    result->open_time = g_get_monotonic_time () - start;
+
+    BenchCursor cursor = { g_rand_new_with_seed (42), length };
+    GtkTextIter iter;
+    GtkTextIter end;
+
+    start = g_get_monotonic_time ();
+
+    for (guint i = 0; i < operations; i++)
+    {
+        gsize offset = next_offset (&cursor);
+        gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset);
+
+        if (i % 2 == 0)
+        {
+            gtk_text_buffer_insert (buffer, &iter, EDIT_TEXT, EDIT_LENGTH);
+            cursor.length += EDIT_LENGTH;
+        }
+        else
+        {
+            gsize length = MIN (EDIT_LENGTH, cursor.length - offset);
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + length);
+            gtk_text_buffer_delete (buffer, &iter, &end);
+            cursor.length -= length;
+        }
+    }
+
+    result->edit_time = g_get_monotonic_time () - start;
+    start = g_get_monotonic_time ();
+
+    for (guint i = 0; i < operations; i++)
+    {
+        gtk_text_buffer_get_iter_at_offset (buffer, &iter, next_offset (&cursor));
+        gtk_text_buffer_get_iter_at_line (buffer, &iter, gtk_text_iter_get_line (&iter));
+    }
+
+    result->lookup_time = g_get_monotonic_time () - start;
+    start = g_get_monotonic_time ();
+
+    gint n_lines = gtk_text_buffer_get_line_count (buffer);
+
+    for (guint i = 0; i < operations / 100; i++)
+    {
+        gint first = g_rand_int_range (cursor.rand, 0, n_lines);
+        gtk_text_buffer_get_iter_at_line (buffer, &iter, first);
+        gtk_text_buffer_get_iter_at_line (buffer, &end, first + WINDOW_LINES);
+        g_free (gtk_text_buffer_get_text (buffer, &iter, &end, TRUE));
+    }
+
+    result->read_time = g_get_monotonic_time () - start;
+    result->pieces = 0;
+
+    g_rand_free (cursor.rand);
+    g_object_unref (buffer);
+    return TRUE;
+}
+
+// Runs one backend in this process and prints its results
+static gboolean
+run_backend (const gchar *backend,
+             const gchar *path,
+             guint        operations)
+{
+    BenchResult result;
+    gboolean ok;
+
+    if (g_strcmp0 (backend, "pieces") == 0)
+        ok = bench_pieces (path, operations, &result);
+    else if (g_strcmp0 (backend, "buffer") == 0)
+        ok = bench_buffer (path, operations, &result);
+    else
+        ok = FALSE;
+
+    if (!ok)
+    {
+        g_printerr ("Could not run %s on %s\n", backend, path);
+        return FALSE;
+    }
+
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    // ru_maxrss is in kilobytes on Linux
+    g_print ("    {\n"
+             "      \"backend\": \"%s\",\n"
+             "      \"open_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"edit_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"lookup_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"read_us\": %" G_GINT64_FORMAT ",\n"
+             "      \"pieces\": %u,\n"
+             "      \"peak_rss_kb\": %ld\n"
+             "    }",
+             backend, result.open_time, result.edit_time,
+             result.lookup_time, result.read_time, result.pieces,
+             usage.ru_maxrss);
+
+    return TRUE;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gint size = DEFAULT_SIZE_MB;
+    gint operations = DEFAULT_OPERATIONS;
+    gchar *backend = NULL;
+    gchar **files = NULL;
+    GError *error = NULL;
+
+    GOptionEntry entries[] = {
+        { "size", 's', 0, G_OPTION_ARG_INT, &size, "Size of the generated file", "MB" },
+        { "operations", 'n', 0, G_OPTION_ARG_INT, &operations, "Edits and lookups per backend", "N" },
+        { "backend", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &backend, NULL, NULL },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL, "[FILE]" },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new ("- benchmark the piece table");
+    g_option_context_add_main_entries (context, entries, NULL);
+
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    g_option_context_free (context);
+
+    if (size < 1 || operations < 1)
+    {
+        g_printerr ("Usage: %s [-s MB] [-n N] [FILE]\n", g_get_prgname ());
+        return EXIT_FAILURE;
+    }
+
+    // Child process
+    if (backend != NULL)
+    {
+        gboolean ok = files != NULL && run_backend (backend, files[0], operations);
+        g_strfreev (files);
+        g_free (backend);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    gchar *path;
+
+    if (files != NULL)
+    {
+        path = g_strdup (files[0]);
+    }
+    else
+    {
+        gint fd = g_file_open_tmp ("bluedit-bench-XXXXXX.md", &path, &error);
+
+        if (fd < 0)
+        {
+            g_printerr ("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+
+        close (fd);
+
+        if (!generate_file (path, (gsize)size * 1024 * 1024))
+        {
+            g_printerr ("Could not write %s\n", path);
+            g_unlink (path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    GStatBuf st;
+    g_stat (path, &st);
+
+    g_print ("{\n"
+             "  \"bytes\": %" G_GINT64_FORMAT ",\n"
+             "  \"operations\": %d,\n"
+             "  \"results\": [\n",
+             (gint64)st.st_size, operations);
+
+    const gchar *backends[] = { "pieces", "buffer" };
+    gboolean ok = TRUE;
+
+    for (guint i = 0; i < G_N_ELEMENTS (backends) && ok; i++)
+    {
+        gchar *operations_arg = g_strdup_printf ("--operations=%d", operations);
+        gchar *backend_arg = g_strdup_printf ("--backend=%s", backends[i]);
+        gchar *child_argv[] = { argv[0], operations_arg, backend_arg, path, NULL };
+        gchar *output = NULL;
+        gint status;
+
+        ok = g_spawn_sync (NULL, child_argv, NULL, G_SPAWN_DEFAULT, NULL, NULL,
+                           &output, NULL, &status, &error)
+             && g_spawn_check_exit_status (status, &error);
+
+        if (ok)
+            g_print ("%s%s", i == 0 ? "" : ",\n", output);
+        else
+            g_printerr ("%s\n", error->message);
+
+        g_free (output);
+        g_free (backend_arg);
+        g_free (operations_arg);
+    }
+
+    g_print ("\n  ]\n"
+             "}\n");
+
+    if (files == NULL)
+        g_unlink (path);
+
+    g_free (path);
+    g_strfreev (files);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+
+# Writes the markdown corpus used by the highlighting benchmarks.
+# Output is fully deterministic so results can be compared between
+# builds and machines.
+
+import os
+import random
+import sys
+
+WORDS = (
+    'editor buffer markdown heading paragraph window split tile view '
+    'document parser render style font spacing cursor line column '
+    'offset chunk frame clock layout theme save load file path'
+).split()
+
+
+def sentence(rng, words):
+    out = []
+    for _ in range(words):
+        word = rng.choice(WORDS)
+        roll = rng.random()
+        if roll < 0.05:
+            word = '**' + word + '**'
+        elif roll < 0.10:
+            word = '*' + word + '*'
+        elif roll < 0.12:
+            word = '`' + word + '`'
+        out.append(word)
+    return ' '.join(out).capitalize() + '.'
+
+
+def paragraph(rng):
+    return ' '.join(sentence(rng, rng.randint(6, 18))
+                    for _ in range(rng.randint(2, 6)))
+
+
+def section(rng, depth):
+    lines = ['#' * depth + ' ' + sentence(rng, rng.randint(2, 5))[:-1], '']
+
+    for _ in range(rng.randint(1, 4)):
+        kind = rng.random()
+        if kind < 0.15:
+            lines += ['- ' + sentence(rng, rng.randint(3, 10))
+                      for _ in range(rng.randint(2, 6))]
+        elif kind < 0.22:
+            lines += ['```', 'let x = ' + rng.choice(WORDS) + ';', '```']
+        elif kind < 0.28:
+            lines += ['> ' + paragraph(rng)]
+        else:
+            lines += [paragraph(rng)]
+        lines.append('')
+
+    return lines
+
+
+def notes_small(rng):
+    # A typical note: a few kilobytes
+    lines = []
+    for i in range(6):
+        lines += section(rng, 1 if i == 0 else 2)
+    return '\n'.join(lines)
+
+
+def manual(rng, size):
+    # A long structured document with every heading level
+    lines = []
+    length = 0
+    while length < size:
+        block = section(rng, rng.randint(1, 6))
+        lines += block
+        length += sum(len(line) + 1 for line in block)
+    return '\n'.join(lines)
+
+
+def nested_emphasis(rng):
+    # Deeply nested and unbalanced delimiters, which make the
+    # inline parser do the most work per byte
+    lines = []
+    for i in range(2000):
+        depth = 1 + i % 40
+        opener = ''.join(rng.choice('*_') for _ in range(depth))
+        closer = opener[::-1] if i % 3 else ''
+        lines.append(opener + rng.choice(WORDS) + closer +
+                     ' **a *b **c *d** e* f** g*' * (1 + i % 4))
+        lines.append('')
+    return '\n'.join(lines)
+
+
+def main():
+    outdir = sys.argv[1]
+    corpus = {
+        'notes-small.md': notes_small(random.Random(1)),
+        'manual-1mb.md': manual(random.Random(2), 1024 * 1024),
+        'nested-emphasis.md': nested_emphasis(random.Random(3)),
+    }
+
+    for name, text in corpus.items():
+        with open(os.path.join(outdir, name), 'w', encoding='utf-8') as f:
+            f.write(text + '\n')
+
+
+if __name__ == '__main__':
+    main()
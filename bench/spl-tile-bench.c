@@ -0,0 +1,212 @@
+/* spl-tile-bench.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Times the libsplit tile manager as the number of areas grows: the
+// splits that build each layout, hit testing random points, finding
+// the edge under a point and moving it. Layouts are built by splitting
+// random areas in half until they hold the wanted number. Results are
+// printed to stdout as JSON, in nanoseconds per operation.
+
+#include <spl-tile-manager.h>
+
+#include <stdlib.h>
+
+#define DEFAULT_MAX_AREAS 800
+#define DEFAULT_OPERATIONS 100000
+
+// Edges are nudged back and forth by this much, so the layout being
+// measured stays the same
+#define MOVE_DELTA 1e-7
+
+// Moves per edge dragged
+#define DRAG_LENGTH 100
+
+typedef struct
+{
+    guint areas;
+    gdouble split_ns;
+    gdouble hit_ns;
+    gdouble edge_find_ns;
+    gdouble edge_move_ns;
+} BenchResult;
+
+// An area under a random point. Points exactly on an edge belong to
+// no area, so those are tried again.
+static SplArea *
+random_area (SplTileManager *manager,
+             GRand          *rand)
+{
+    SplArea *area = NULL;
+
+    while (area == NULL)
+        area = spl_area_get_for_coords (manager,
+                                        g_rand_double (rand),
+                                        g_rand_double (rand));
+
+    return area;
+}
+
+static void
+run_bench (guint        n_areas,
+           gint         operations,
+           BenchResult *result)
+{
+    GRand *rand = g_rand_new_with_seed (n_areas);
+    SplTileManager *manager = spl_tile_manager_new ();
+
+    // Let areas get as small as they need to
+    g_object_set (manager, "minimum-size", 0.0, NULL);
+    spl_tile_manager_resize (manager, 1920, 1080);
+    spl_tile_manager_create_initial (manager);
+
+    // Splitting
+    gint64 split_time = 0;
+
+    for (guint count = 1; count < n_areas; count++)
+    {
+        SplArea *area = random_area (manager, rand);
+        guint direction = g_rand_boolean (rand) ? SPL_HORIZONTAL : SPL_VERTICAL;
+
+        gint64 start = g_get_monotonic_time ();
+        spl_area_split (manager, area, direction, 0.5);
+        split_time += g_get_monotonic_time () - start;
+    }
+
+    if (!spl_tile_manager_check_invariants (manager))
+        g_error ("Layout of %u areas is broken", n_areas);
+
+    // Hit Testing
+    gint64 start = g_get_monotonic_time ();
+
+    for (gint i = 0; i < operations; i++)
+        spl_area_get_for_coords (manager, g_rand_double (rand), g_rand_double (rand));
+
+    gint64 hit_time = g_get_monotonic_time () - start;
+
+    // Edge Lookups. The right edge of a random area, found by its midpoint.
+    gint64 find_time = 0;
+
+    for (gint i = 0; i < operations; i++)
+    {
+        SplArea *area = random_area (manager, rand);
+        gdouble x = area->tr->x;
+        gdouble y = (area->tr->y + area->br->y) / 2;
+
+        start = g_get_monotonic_time ();
+        spl_edge_get_for_coords (manager, x, y, MOVE_DELTA / 2);
+        find_time += g_get_monotonic_time () - start;
+    }
+
+    // Edge Moves. Dragging an edge moves it many times in a row.
+    gint64 move_time = 0;
+    gint moves = 0;
+
+    for (gint i = 0; i < operations; i += DRAG_LENGTH)
+    {
+        SplArea *area = random_area (manager, rand);
+        gdouble x = area->tr->x;
+        gdouble y = (area->tr->y + area->br->y) / 2;
+        SplEdge *edge = spl_edge_get_for_coords (manager, x, y, MOVE_DELTA / 2);
+
+        if (edge == NULL)
+            continue;
+
+        start = g_get_monotonic_time ();
+
+        for (gint j = 0; j < DRAG_LENGTH; j++)
+            spl_edge_move (manager, edge, x + (j % 2 == 0 ? MOVE_DELTA : 0));
+
+        move_time += g_get_monotonic_time () - start;
+        moves += DRAG_LENGTH;
+    }
+
+    result->areas = g_list_length (spl_tile_manager_get_areas (manager));
+    result->split_ns = (gdouble) split_time * 1000 / MAX (n_areas - 1, 1);
+    result->hit_ns = (gdouble) hit_time * 1000 / operations;
+    result->edge_find_ns = (gdouble) find_time * 1000 / operations;
+    result->edge_move_ns = (gdouble) move_time * 1000 / MAX (moves, 1);
+
+    g_object_unref (manager);
+    g_rand_free (rand);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gint max_areas = DEFAULT_MAX_AREAS;
+    gint operations = DEFAULT_OPERATIONS;
+    GError *error = NULL;
+
+    GOptionEntry entries[] = {
+        { "areas", 'a', 0, G_OPTION_ARG_INT, &max_areas, "Largest layout to build", "N" },
+        { "operations", 'n', 0, G_OPTION_ARG_INT, &operations, "Hit tests and edge moves per layout", "N" },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new (NULL);
+    g_option_context_add_main_entries (context, entries, NULL);
+
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    g_option_context_free (context);
+
+    if (max_areas < 1 || operations < 1)
+    {
+        g_printerr ("Usage: %s [-a N] [-n N]\n", g_get_prgname ());
+        return EXIT_FAILURE;
+    }
+
+    g_print ("{\n"
+             "  \"operations\": %d,\n"
+             "  \"results\": [\n",
+             operations);
+
+    // Doubling the number of areas each time
+    for (gint n_areas = 25; ; n_areas *= 2)
+    {
+        BenchResult result;
+        run_bench (MIN (n_areas, max_areas), operations, &result);
+
+        g_print ("    {\n"
+                 "      \"areas\": %u,\n"
+                 "      \"split_ns\": %.1f,\n"
+                 "      \"hit_test_ns\": %.1f,\n"
+                 "      \"edge_find_ns\": %.1f,\n"
+                 "      \"edge_move_ns\": %.1f\n"
+                 "    }",
+                 result.areas, result.split_ns, result.hit_ns,
+                 result.edge_find_ns, result.edge_move_ns);
+
+        if (n_areas >= max_areas)
+            break;
+
+        g_print (",\n");
+    }
+
+    g_print ("\n  ]\n"
+             "}\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/* bl-arena.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-arena.h"
+
+#include <string.h>
+
+// Every block is preceded by its size, padded so the block itself
+// stays suitably aligned for any type
+#define ALIGNMENT 16
+#define HEADER_SIZE ALIGNMENT
+#define ALIGN_UP(size) (((size) + ALIGNMENT - 1) & ~((gsize)ALIGNMENT - 1))
+
+typedef struct
+{
+    guint8 *data;
+    gsize size;
+    gsize used;
+} BlArenaChunk;
+
+struct _BlArena
+{
+    GArray *chunks;
+    guint current;
+    gsize chunk_size;
+    BlArenaStats stats;
+};
+
+BlArena *
+bl_arena_new (gsize chunk_size)
+{
+    BlArena *self = g_new0 (BlArena, 1);
+    self->chunks = g_array_new (FALSE, FALSE, sizeof (BlArenaChunk));
+    self->chunk_size = ALIGN_UP (chunk_size);
+    return self;
+}
+
+void
+bl_arena_free (BlArena *self)
+{
+    for (guint i = 0; i < self->chunks->len; i++)
+        g_free (g_array_index (self->chunks, BlArenaChunk, i).data);
+
+    g_array_free (self->chunks, TRUE);
+    g_free (self);
+}
+
+void
+bl_arena_reset (BlArena *self)
+{
+    // Chunks past the current one went unused last time round
+    guint keep = MIN (self->current + 1, self->chunks->len);
+
+    for (guint i = keep; i < self->chunks->len; i++)
+        g_free (g_array_index (self->chunks, BlArenaChunk, i).data);
+
+    g_array_set_size (self->chunks, keep);
+
+    self->stats.bytes = 0;
+    self->stats.allocations = 0;
+    self->stats.system_allocations = 0;
+    self->stats.capacity = 0;
+
+    for (guint i = 0; i < self->chunks->len; i++)
+    {
+        BlArenaChunk *chunk = &g_array_index (self->chunks, BlArenaChunk, i);
+        chunk->used = 0;
+        self->stats.capacity += chunk->size;
+    }
+
+    self->current = 0;
+}
+
+static gsize *
+get_header (gpointer mem)
+{
+    return (gsize *)((guint8 *)mem - HEADER_SIZE);
+}
+
+gpointer
+bl_arena_alloc (BlArena *self,
+                gsize    size)
+{
+    gsize needed = HEADER_SIZE + ALIGN_UP (size);
+    BlArenaChunk *chunk = NULL;
+
+    // Move on to the next chunk once the current one is full
+    for (; self->current < self->chunks->len; self->current++)
+    {
+        chunk = &g_array_index (self->chunks, BlArenaChunk, self->current);
+
+        if (chunk->size - chunk->used >= needed)
+            break;
+
+        chunk = NULL;
+    }
+
+    if (chunk == NULL)
+    {
+        // Oversized blocks get a chunk of their own
+        BlArenaChunk new_chunk;
+        new_chunk.size = MAX (self->chunk_size, needed);
+        new_chunk.data = g_malloc (new_chunk.size);
+        new_chunk.used = 0;
+
+        g_array_append_val (self->chunks, new_chunk);
+        self->current = self->chunks->len - 1;
+        chunk = &g_array_index (self->chunks, BlArenaChunk, self->current);
+
+        self->stats.system_allocations++;
+        self->stats.capacity += new_chunk.size;
+    }
+
+    guint8 *block = chunk->data + chunk->used + HEADER_SIZE;
+    *get_header (block) = size;
+    chunk->used += needed;
+
+    self->stats.bytes += size;
+    self->stats.allocations++;
+
+    return block;
+}
+
+gpointer
+bl_arena_alloc0 (BlArena *self,
+                 gsize    size)
+{
+    // Chunks are reused, so they are not zeroed already
+    gpointer mem = bl_arena_alloc (self, size);
+    memset (mem, 0, size);
+    return mem;
+}
+
+gpointer
+bl_arena_realloc (BlArena  *self,
+                  gpointer  mem,
+                  gsize     size)
+{
+    if (mem == NULL)
+        return bl_arena_alloc (self, size);
+
+    gsize old_size = *get_header (mem);
+
+    if (size <= old_size)
+        return mem;
+
+    // The most recent block can simply grow into the free space after
+    // it, which is the common case for a string being appended to
+    if (self->current < self->chunks->len)
+    {
+        BlArenaChunk *chunk = &g_array_index (self->chunks, BlArenaChunk, self->current);
+        gsize grow = ALIGN_UP (size) - ALIGN_UP (old_size);
+
+        if ((guint8 *)mem + ALIGN_UP (old_size) == chunk->data + chunk->used &&
+            chunk->size - chunk->used >= grow)
+        {
+            chunk->used += grow;
+            *get_header (mem) = size;
+            self->stats.bytes += size - old_size;
+            return mem;
+        }
+    }
+
+    gpointer new_mem = bl_arena_alloc (self, size);
+    memcpy (new_mem, mem, old_size);
+    return new_mem;
+}
+
+void
+bl_arena_get_stats (BlArena      *self,
+                    BlArenaStats *stats)
+{
+    *stats = self->stats;
+}
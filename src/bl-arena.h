@@ -0,0 +1,60 @@
+/* bl-arena.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Counters for the allocations made since the last reset.
+// `system_allocations` counts the chunks that had to be malloc'd,
+// which is zero once the arena has grown to its working size.
+typedef struct
+{
+    gsize bytes;
+    guint allocations;
+    guint system_allocations;
+    gsize capacity;
+} BlArenaStats;
+
+// Bump allocator. Individual blocks are never freed; instead the
+// whole arena is reset and its chunks are reused for the next round.
+typedef struct _BlArena BlArena;
+
+BlArena *  bl_arena_new        (gsize         chunk_size);
+void       bl_arena_free       (BlArena      *self);
+
+// Forgets every allocation. Chunks that the last round did not need
+// are released, the rest are kept for the next round.
+void       bl_arena_reset      (BlArena      *self);
+
+gpointer   bl_arena_alloc      (BlArena      *self,
+                                gsize         size);
+gpointer   bl_arena_alloc0     (BlArena      *self,
+                                gsize         size);
+gpointer   bl_arena_realloc    (BlArena      *self,
+                                gpointer      mem,
+                                gsize         size);
+
+void       bl_arena_get_stats  (BlArena      *self,
+                                BlArenaStats *stats);
+
+G_END_DECLS
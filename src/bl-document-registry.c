@@ -0,0 +1,215 @@
+/* bl-document-registry.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-document-registry.h"
+
+typedef struct
+{
+    guint64 device;
+    guint64 inode;
+} FileId;
+
+// What a document was registered under, so it can be taken out again.
+// `changed` is the file's inode change time then, in microseconds.
+typedef struct
+{
+    GFile *file;
+    FileId *id;
+    guint64 changed;
+} Entry;
+
+struct _BlDocumentRegistry
+{
+    GHashTable *by_id;
+    GHashTable *by_file;
+    GHashTable *entries;
+};
+
+static guint
+file_id_hash (gconstpointer key)
+{
+    const FileId *id = key;
+    return g_int64_hash (&id->inode) ^ g_int64_hash (&id->device);
+}
+
+static gboolean
+file_id_equal (gconstpointer a,
+               gconstpointer b)
+{
+    const FileId *id_a = a;
+    const FileId *id_b = b;
+    return id_a->device == id_b->device && id_a->inode == id_b->inode;
+}
+
+static void
+entry_free (Entry *entry)
+{
+    g_object_unref (entry->file);
+    g_free (entry->id);
+    g_free (entry);
+}
+
+BlDocumentRegistry *
+bl_document_registry_new (void)
+{
+    BlDocumentRegistry *self = g_new0 (BlDocumentRegistry, 1);
+
+    // Keys are owned by the entries
+    self->by_id = g_hash_table_new (file_id_hash, file_id_equal);
+    self->by_file = g_hash_table_new ((GHashFunc) g_file_hash, (GEqualFunc) g_file_equal);
+    self->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           NULL, (GDestroyNotify) entry_free);
+    return self;
+}
+
+void
+bl_document_registry_free (BlDocumentRegistry *self)
+{
+    g_hash_table_destroy (self->by_id);
+    g_hash_table_destroy (self->by_file);
+    g_hash_table_destroy (self->entries);
+    g_free (self);
+}
+
+// Device and inode of the file a path leads to, and when the inode
+// last changed. Only asked of local files, as anything else could
+// mean a round trip to a server.
+static FileId *
+query_id (GFile   *file,
+          guint64 *changed)
+{
+    if (!g_file_is_native (file))
+        return NULL;
+
+    GFileInfo *info = g_file_query_info (file,
+                                         G_FILE_ATTRIBUTE_UNIX_DEVICE ","
+                                         G_FILE_ATTRIBUTE_UNIX_INODE ","
+                                         G_FILE_ATTRIBUTE_TIME_CHANGED ","
+                                         G_FILE_ATTRIBUTE_TIME_CHANGED_USEC,
+                                         G_FILE_QUERY_INFO_NONE,
+                                         NULL, NULL);
+
+    if (info == NULL)
+        return NULL;
+
+    FileId *id = NULL;
+
+    if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_DEVICE) &&
+        g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE))
+    {
+        id = g_new0 (FileId, 1);
+        id->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+        id->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+    }
+
+    if (changed != NULL)
+        *changed = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_CHANGED) * G_USEC_PER_SEC +
+                   g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_CHANGED_USEC);
+
+    g_object_unref (info);
+    return id;
+}
+
+void
+bl_document_registry_remove (BlDocumentRegistry *self,
+                             BlDocument         *document)
+{
+    Entry *entry = g_hash_table_lookup (self->entries, document);
+
+    if (entry == NULL)
+        return;
+
+    // Another document may have taken the key over since
+    if (g_hash_table_lookup (self->by_file, entry->file) == document)
+        g_hash_table_remove (self->by_file, entry->file);
+
+    if (entry->id != NULL && g_hash_table_lookup (self->by_id, entry->id) == document)
+        g_hash_table_remove (self->by_id, entry->id);
+
+    g_hash_table_remove (self->entries, document);
+}
+
+void
+bl_document_registry_add (BlDocumentRegistry *self,
+                          BlDocument         *document)
+{
+    bl_document_registry_remove (self, document);
+
+    GFile *file = bl_document_get_file (document);
+
+    if (file == NULL || bl_document_is_untitled (document))
+        return;
+
+    Entry *entry = g_new0 (Entry, 1);
+    entry->file = g_object_ref (file);
+    entry->id = query_id (file, &entry->changed);
+
+    g_hash_table_insert (self->entries, document, entry);
+    // Replaced along with the key, which belongs to the new entry
+    g_hash_table_replace (self->by_file, entry->file, document);
+
+    if (entry->id != NULL)
+        g_hash_table_replace (self->by_id, entry->id, document);
+}
+
+BlDocument *
+bl_document_registry_lookup (BlDocumentRegistry *self,
+                             GFile              *file)
+{
+    guint64 changed = 0;
+    FileId *id = query_id (file, &changed);
+    BlDocument *document = NULL;
+
+    if (id != NULL)
+        document = g_hash_table_lookup (self->by_id, id);
+
+    // The file may have been replaced since it was registered, and its
+    // inode handed to another. The inode would then have changed since
+    // too, and only then is the document's own file looked at again.
+    if (document != NULL)
+    {
+        Entry *entry = g_hash_table_lookup (self->entries, document);
+
+        if (changed != entry->changed)
+        {
+            FileId *current = query_id (entry->file, NULL);
+
+            if (current == NULL || !file_id_equal (current, id))
+            {
+                bl_document_registry_add (self, document);
+                document = NULL;
+            }
+            else
+            {
+                // Still the same file, just written to meanwhile
+                entry->changed = changed;
+            }
+
+            g_free (current);
+        }
+    }
+
+    g_free (id);
+
+    if (document == NULL)
+        document = g_hash_table_lookup (self->by_file, file);
+
+    return document;
+}
@@ -0,0 +1,51 @@
+/* bl-document-registry.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include "bl-document.h"
+
+G_BEGIN_DECLS
+
+// Open documents by the file they hold. Local files are matched by
+// device and inode, so a file reached through a symlink or another
+// path is found as the same document. Anything else falls back to
+// comparing the GFile. Lookups are a hash table probe plus a stat,
+// and a second one only when the file has changed since it was
+// registered.
+typedef struct _BlDocumentRegistry BlDocumentRegistry;
+
+BlDocumentRegistry *  bl_document_registry_new     (void);
+void                  bl_document_registry_free    (BlDocumentRegistry *self);
+
+// Registers the document under its current file, replacing whatever
+// it was registered under before. Untitled documents are skipped.
+void                  bl_document_registry_add     (BlDocumentRegistry *self,
+                                                    BlDocument         *document);
+void                  bl_document_registry_remove  (BlDocumentRegistry *self,
+                                                    BlDocument         *document);
+
+// The open document holding `file`, or NULL
+BlDocument *          bl_document_registry_lookup  (BlDocumentRegistry *self,
+                                                    GFile              *file);
+
+G_END_DECLS
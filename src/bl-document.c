@@ -19,38 +19,884 @@
  */
 
 #include "bl-document.h"
+#include "bl-journal.h"
+#include "bl-mapped-text.h"
+#include "bl-piece-table.h"
+#include "bl-undo.h"
+
+#include <string.h>
 
 struct _BlDocument
 {
     GtkTextBuffer parent_instance;
     GFile* file;
     gboolean untitled;
-    guint hash;
+
+    // Save State. Every edit bumps `sequence`, so the document is
+    // clean while it still matches the value recorded at save time.
+    guint64 sequence;
+    guint64 saved_sequence;
+    gint saved_chars;
+    guint saved_hash;
+    gboolean saved_hash_known;
+
+    BlLineIndex *lines;
+    BlHighlighter *highlighter;
+
+    // Loading. Documents made from a file only read it once they are
+    // first shown, which `load_pending` waits for.
+    gboolean load_pending;
+    gboolean loading;
+    GCancellable *load_cancellable;
+    GInputStream *load_stream;
+    goffset load_size;
+    goffset load_read;
+    guint32 load_hash;
+    gboolean load_hash_partial;
+    GError *load_error;
+
+    // Saving
+    gboolean saving;
+    GFile *save_queued;
+    GError *save_error;
+
+    // Start of a character split across two reads
+    gchar carry[4];
+    gsize carry_len;
+
+    // Files at least this large are mapped rather than loaded. The
+    // buffer then only holds the lines from `window_start` onwards.
+    gsize map_threshold;
+    BlMappedText *mapped;
+    guint window_start;
+
+    // Once a mapped file is made editable, the text lives in a piece
+    // table over the mapping and the buffer is a window onto it, with
+    // edits to the buffer passed through. `window_offset` is the byte
+    // at which the buffer starts.
+    BlPieceTable *pieces;
+    gsize window_offset;
+    gboolean setting_window;
+
+    // Degraded Mode. Documents past either limit (zero for none) are
+    // neither highlighted nor hashed, unless the user asks for them
+    // to be anyway. `longest_line` only ever grows until a reload.
+    gsize n_bytes;
+    gsize longest_line;
+    gsize degrade_size;
+    guint degrade_line_length;
+    gboolean degraded;
+    gboolean degrade_overridden;
+    guint degrade_id;
+
+    // Crash Recovery. Edits since the last save, to be replayed over
+    // the saved file if we never get to save them. A journal from a
+    // previous run that could not be replayed is held onto, and left
+    // on disk, until the user lets it go.
+    BlJournal *journal;
+    BlJournalRecovery *unrecovered;
+    GError *recovery_error;
+
+    // Undo History. Edits made while undoing or redoing are not
+    // recorded, and mapped files keep no history.
+    BlUndo *undo;
+    gboolean undoing;
 };
 
-G_DEFINE_TYPE (BlDocument, bl_document, GTK_TYPE_TEXT_BUFFER)
+G_DEFINE_TYPE (BlDocument, bl_document, GTK_TYPE_TEXT_BUFFER)
+
+enum
+{
+    LOADED,
+    LOAD_PROGRESS,
+    SAVED,
+    DEGRADED_CHANGED,
+    RECOVERY_CHANGED,
+    NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS];
+
+// Bytes read from the file and inserted into the buffer at a time
+#define LOAD_CHUNK_SIZE (256 * 1024)
+
+// Same hash as g_str_hash, but it can be continued across pieces of
+// text. Used to recognise an edited document returning to its saved
+// contents.
+#define HASH_INIT 5381
+
+static guint32
+hash_text (guint32      hash,
+           const gchar *text,
+           gsize        length)
+{
+    for (gsize i = 0; i < length; i++)
+        hash = (hash << 5) + hash + (guchar)text[i];
+
+    return hash;
+}
+
+static void set_saved_state (BlDocument *self, guint64 sequence, gint chars, guint hash, gboolean hash_known);
+static guint hash_contents (BlDocument *self);
+static void restore_saved_state (BlDocument *self);
+static void update_degraded (BlDocument *self);
+static gboolean exceeds_limits (BlDocument *self);
+
+// Associates the document with a file, without loading it
+void
+bl_document_set_file (BlDocument* document, GFile* file)
+{
+    if (file == NULL)
+    {
+        g_error("File is invalid");
+        return;
+    }
+
+    g_set_object (&document->file, file);
+    document->untitled = FALSE;
+}
+
+static void
+finish_load (BlDocument *self,
+             GError     *error)
+{
+    if (self->load_stream != NULL)
+    {
+        g_input_stream_close_async (self->load_stream, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+        g_clear_object (&self->load_stream);
+    }
+
+    g_clear_object (&self->load_cancellable);
+    g_clear_error (&self->load_error);
+    self->load_error = error;
+    self->loading = FALSE;
+    self->carry_len = 0;
+
+    // Never leave half a file behind, where saving would truncate it
+    if (error != NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Could not load document: %s", error->message);
+
+        gtk_text_buffer_set_text (GTK_TEXT_BUFFER (self), "", 0);
+        self->load_hash = HASH_INIT;
+        self->load_hash_partial = FALSE;
+    }
+
+    // Decide before highlighting starts, which could take a long time
+    // on a document about to be degraded
+    update_degraded (self);
+
+    // Hashing stopped part way through when the document grew too
+    // large. If it was allowed to anyway, hash the whole thing now.
+    if (self->load_hash_partial && !self->degraded)
+    {
+        self->load_hash = hash_contents (self);
+        self->load_hash_partial = FALSE;
+    }
+
+    // The buffer now matches what is on disk
+    set_saved_state (self, self->sequence,
+                     gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (self)),
+                     self->load_hash, !self->load_hash_partial);
+
+    if (self->highlighter != NULL)
+        bl_highlighter_set_deferred (self->highlighter, FALSE);
+
+    // Nothing typed yet, whatever the buffer went through above
+    g_clear_pointer (&self->journal, bl_journal_discard);
+    bl_undo_clear (self->undo);
+    bl_undo_set_saved (self->undo, bl_undo_checkpoint (self->undo));
+
+    g_signal_emit (self, signals[LOADED], 0);
+    g_object_unref (self);
+}
+
+static void
+insert_at_end (BlDocument  *self,
+               const gchar *text,
+               gsize        length)
+{
+    // Hash as we go, so finishing the load does not have to. Large
+    // documents are not hashed at all.
+    if (!self->degraded && !exceeds_limits (self))
+        self->load_hash = hash_text (self->load_hash, text, length);
+    else
+        self->load_hash_partial = TRUE;
+
+    GtkTextIter end;
+    gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (self), &end);
+    gtk_text_buffer_insert (GTK_TEXT_BUFFER (self), &end, text, length);
+}
+
+static gboolean
+invalid_text (GError **error)
+{
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "The file is not valid UTF-8 text");
+    return FALSE;
+}
+
+// Appends a chunk of the file to the buffer. A character cut off at
+// the end of the chunk is held back until the next one arrives.
+static gboolean
+insert_chunk (BlDocument   *self,
+              const gchar  *data,
+              gsize         length,
+              GError      **error)
+{
+    while (self->carry_len > 0 && length > 0)
+    {
+        self->carry[self->carry_len++] = *data++;
+        length--;
+
+        gunichar c = g_utf8_get_char_validated (self->carry, self->carry_len);
+
+        if (c == (gunichar)-2 && self->carry_len < sizeof (self->carry))
+            continue;
+
+        if (c == (gunichar)-1 || c == (gunichar)-2)
+            return invalid_text (error);
+
+        insert_at_end (self, self->carry, self->carry_len);
+        self->carry_len = 0;
+    }
+
+    const gchar *valid_end;
+
+    if (!g_utf8_validate (data, length, &valid_end))
+    {
+        gsize rest = data + length - valid_end;
+
+        if (rest >= sizeof (self->carry) ||
+            g_utf8_get_char_validated (valid_end, rest) != (gunichar)-2)
+            return invalid_text (error);
+
+        memcpy (self->carry, valid_end, rest);
+        self->carry_len = rest;
+    }
+
+    if (valid_end > data)
+        insert_at_end (self, data, valid_end - data);
+
+    return TRUE;
+}
+
+static void read_next_chunk (BlDocument *self);
+
+static void
+cb_chunk_read (GInputStream *stream,
+               GAsyncResult *result,
+               BlDocument   *self)
+{
+    GError *error = NULL;
+    GBytes *bytes = g_input_stream_read_bytes_finish (stream, result, &error);
+
+    if (bytes == NULL)
+    {
+        finish_load (self, error);
+        return;
+    }
+
+    gsize length;
+    const gchar *data = g_bytes_get_data (bytes, &length);
+
+    // An empty read is the end of the file
+    if (length == 0)
+    {
+        if (self->carry_len > 0)
+            g_set_error (&error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "The file ends partway through a character");
+
+        g_bytes_unref (bytes);
+        finish_load (self, error);
+        return;
+    }
+
+    self->load_read += length;
+    gboolean inserted = insert_chunk (self, data, length, &error);
+    g_bytes_unref (bytes);
+
+    if (!inserted)
+    {
+        finish_load (self, error);
+        return;
+    }
+
+    g_signal_emit (self, signals[LOAD_PROGRESS], 0);
+    read_next_chunk (self);
+}
+
+static void
+read_next_chunk (BlDocument *self)
+{
+    // The read itself happens on a GIO worker thread. Completing at
+    // idle priority lets a frame be drawn between chunks.
+    g_input_stream_read_bytes_async (self->load_stream, LOAD_CHUNK_SIZE,
+                                     G_PRIORITY_DEFAULT_IDLE,
+                                     self->load_cancellable,
+                                     (GAsyncReadyCallback) cb_chunk_read,
+                                     self);
+}
+
+// Lines shown when a mapped file is first opened
+#define MAPPED_INITIAL_LINES 256
+
+static gboolean
+try_map (BlDocument *self)
+{
+    if (self->map_threshold == 0 || self->load_size < (goffset)self->map_threshold)
+        return FALSE;
+
+    // Only local files can be mapped. Anything else is loaded as usual.
+    gchar *path = g_file_get_path (self->file);
+
+    if (path == NULL)
+        return FALSE;
+
+    GError *error = NULL;
+    GMappedFile *mapped = g_mapped_file_new (path, FALSE, &error);
+    g_free (path);
+
+    if (mapped == NULL)
+    {
+        g_debug ("Could not map file, loading it instead: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    self->mapped = bl_mapped_text_new (mapped);
+    g_mapped_file_unref (mapped);
+
+    bl_document_set_window (self, 0, MAPPED_INITIAL_LINES);
+    return TRUE;
+}
+
+static void
+cb_size_queried (GFileInputStream *stream,
+                 GAsyncResult     *result,
+                 BlDocument       *self)
+{
+    // Without a size, progress is simply shown as activity
+    GFileInfo *info = g_file_input_stream_query_info_finish (stream, result, NULL);
+
+    if (info != NULL)
+    {
+        self->load_size = g_file_info_get_size (info);
+        g_object_unref (info);
+    }
+
+    if (try_map (self))
+    {
+        finish_load (self, NULL);
+        return;
+    }
+
+    read_next_chunk (self);
+}
+
+static void
+cb_file_opened (GFile        *file,
+                GAsyncResult *result,
+                BlDocument   *self)
+{
+    GError *error = NULL;
+    GFileInputStream *stream = g_file_read_finish (file, result, &error);
+
+    if (stream == NULL)
+    {
+        finish_load (self, error);
+        return;
+    }
+
+    self->load_stream = G_INPUT_STREAM (stream);
+    g_file_input_stream_query_info_async (stream, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                          G_PRIORITY_DEFAULT,
+                                          self->load_cancellable,
+                                          (GAsyncReadyCallback) cb_size_queried,
+                                          self);
+}
+
+// Replaces the contents of the document with `file`, streaming it in
+// without blocking the main loop. "load-progress" is emitted after
+// each chunk and "loaded" once finished, whether or not it succeeded.
+// Highlighting is held back until then.
+//
+// Local files of at least `map_threshold` bytes (unless it is zero)
+// are mapped instead, and the document is read-only until
+// `bl_document_make_editable` is called.
+void
+bl_document_load (BlDocument *self,
+                  GFile      *file,
+                  gsize       map_threshold)
+{
+    g_return_if_fail (G_IS_FILE (file));
+    g_return_if_fail (!self->loading);
+
+    bl_document_set_file (self, file);
+    self->load_pending = FALSE;
+    g_clear_pointer (&self->mapped, bl_mapped_text_free);
+    g_clear_pointer (&self->pieces, bl_piece_table_unref);
+    g_clear_pointer (&self->journal, bl_journal_discard);
+    bl_undo_clear (self->undo);
+    self->map_threshold = map_threshold;
+
+    self->loading = TRUE;
+    self->load_size = 0;
+    self->load_read = 0;
+    self->load_hash = HASH_INIT;
+    self->load_hash_partial = FALSE;
+    self->carry_len = 0;
+    self->load_cancellable = g_cancellable_new ();
+    g_clear_error (&self->load_error);
+
+    bl_highlighter_set_deferred (self->highlighter, TRUE);
+    gtk_text_buffer_set_text (GTK_TEXT_BUFFER (self), "", 0);
+
+    // A new file gets a fresh look at its size
+    self->degrade_overridden = FALSE;
+    self->longest_line = 0;
+
+    if (self->degraded)
+    {
+        self->degraded = FALSE;
+        bl_highlighter_set_enabled (self->highlighter, TRUE);
+        g_signal_emit (self, signals[DEGRADED_CHANGED], 0);
+    }
+
+    // Kept alive until the load has finished
+    g_object_ref (self);
+    g_file_read_async (file, G_PRIORITY_DEFAULT,
+                       self->load_cancellable,
+                       (GAsyncReadyCallback) cb_file_opened,
+                       self);
+}
+
+// Starts loading a document made by `bl_document_new_from_file` the
+// first time its contents are needed
+void
+bl_document_ensure_loaded (BlDocument *self)
+{
+    if (self->load_pending)
+        bl_document_load (self, self->file, self->map_threshold);
+}
+
+// Whether the file has yet to be read at all
+gboolean
+bl_document_is_load_pending (BlDocument *self)
+{
+    return self->load_pending;
+}
+
+void
+bl_document_cancel_load (BlDocument *self)
+{
+    if (self->load_cancellable != NULL)
+        g_cancellable_cancel (self->load_cancellable);
+}
+
+gboolean
+bl_document_is_loading (BlDocument *self)
+{
+    return self->loading;
+}
+
+// Fraction of the file loaded so far, or -1 if the size is unknown
+gdouble
+bl_document_get_load_progress (BlDocument *self)
+{
+    if (self->load_size <= 0)
+        return -1;
+
+    return CLAMP ((gdouble)self->load_read / self->load_size, 0, 1);
+}
+
+// The reason the last load failed, or NULL if it succeeded
+const GError *
+bl_document_get_load_error (BlDocument *self)
+{
+    return self->load_error;
+}
+
+// Whether the buffer only holds part of the document
+gboolean
+bl_document_is_mapped (BlDocument *self)
+{
+    return self->mapped != NULL;
+}
+
+// Mapped documents are read-only until `bl_document_make_editable`
+gboolean
+bl_document_is_read_only (BlDocument *self)
+{
+    return self->mapped != NULL && self->pieces == NULL;
+}
+
+// Lines in a mapped file. This is an estimate until the file has been
+// scanned to the end, which only happens once it is scrolled there.
+guint
+bl_document_get_mapped_lines (BlDocument *self)
+{
+    g_return_val_if_fail (self->mapped != NULL, 0);
+
+    if (self->pieces != NULL)
+        return bl_piece_table_get_n_lines (self->pieces);
+
+    return bl_mapped_text_get_n_lines (self->mapped);
+}
+
+// Line of the mapped file shown at the top of the buffer
+guint
+bl_document_get_window_start (BlDocument *self)
+{
+    return self->window_start;
+}
+
+// Fills the buffer with lines [first_line, first_line + n_lines) of the
+// mapped file. Nothing else of the file is kept in memory.
+void
+bl_document_set_window (BlDocument *self,
+                        guint       first_line,
+                        guint       n_lines)
+{
+    g_return_if_fail (self->mapped != NULL);
+
+    gchar *text;
+
+    if (self->pieces != NULL)
+    {
+        // Past the end of the file, the last line is shown instead
+        first_line = MIN (first_line, bl_piece_table_get_n_lines (self->pieces) - 1);
+
+        gsize start = bl_piece_table_get_line_start (self->pieces, first_line);
+        gsize end = first_line + n_lines < bl_piece_table_get_n_lines (self->pieces)
+            ? bl_piece_table_get_line_start (self->pieces, first_line + n_lines)
+            : bl_piece_table_get_length (self->pieces);
+
+        text = bl_piece_table_get_text (self->pieces, start, end - start);
+        self->window_offset = start;
+    }
+    else
+    {
+        text = bl_mapped_text_get_lines (self->mapped, first_line, n_lines);
+
+        if (bl_mapped_text_is_complete (self->mapped))
+            first_line = MIN (first_line, bl_mapped_text_get_n_lines (self->mapped) - 1);
+    }
+
+    // Moving the window is not an edit
+    self->window_start = first_line;
+    self->setting_window = TRUE;
+    gtk_text_buffer_set_text (GTK_TEXT_BUFFER (self), text, -1);
+    self->setting_window = FALSE;
+    g_free (text);
+}
+
+static void
+build_pieces_thread (GTask        *task,
+                     BlDocument   *self,
+                     GBytes       *original,
+                     GCancellable *cancellable)
+{
+    gsize length;
+    const gchar *data = g_bytes_get_data (original, &length);
+
+    // Edits arrive from the buffer, which only holds valid text, so
+    // the window has to be exactly the bytes in the table
+    if (!g_utf8_validate (data, length, NULL))
+    {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                 "File is not valid UTF-8");
+        return;
+    }
+
+    g_task_return_pointer (task, bl_piece_table_new (original),
+                           (GDestroyNotify) bl_piece_table_unref);
+}
+
+static void
+cb_pieces_built (BlDocument   *self,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    GError *error = NULL;
+    BlPieceTable *pieces = g_task_propagate_pointer (G_TASK (result), &error);
+
+    g_clear_object (&self->load_cancellable);
+    self->loading = FALSE;
+
+    if (pieces == NULL)
+    {
+        // Still readable, so this is not a failed load
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Could not make document editable: %s", error->message);
+
+        g_error_free (error);
+    }
+    else
+    {
+        self->pieces = pieces;
+        bl_document_set_window (self, self->window_start,
+                                gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self)));
+        set_saved_state (self, self->sequence, 0, 0, FALSE);
+    }
+
+    g_signal_emit (self, signals[LOADED], 0);
+}
+
+// Lets a mapped file be edited without loading it into the buffer.
+// The text is moved into a piece table on a worker thread, during
+// which the document counts as loading. "loaded" is emitted after.
+void
+bl_document_make_editable (BlDocument *self)
+{
+    g_return_if_fail (self->mapped != NULL);
+    g_return_if_fail (!self->loading);
+
+    if (self->pieces != NULL)
+        return;
+
+    self->loading = TRUE;
+    self->load_size = 0;
+    self->load_cancellable = g_cancellable_new ();
+
+    GTask *task = g_task_new (self, self->load_cancellable,
+                              (GAsyncReadyCallback) cb_pieces_built, NULL);
+    g_task_set_task_data (task, bl_mapped_text_get_bytes (self->mapped),
+                          (GDestroyNotify) g_bytes_unref);
+    g_task_run_in_thread (task, (GTaskThreadFunc) build_pieces_thread);
+    g_object_unref (task);
+}
+
+typedef struct
+{
+    GFile *file;
+    guint64 sequence;
+    guint64 undo_position;
+    gint chars;
+
+    // Either a copy of the buffer, or the spans of a piece table
+    // (which stay valid while the table is referenced)
+    GBytes *contents;
+    BlPieceTable *pieces;
+    GArray *spans;
+    gboolean skip_hash;
+
+    // Result
+    guint hash;
+} BlSaveJob;
+
+static void
+save_job_free (BlSaveJob *job)
+{
+    g_object_unref (job->file);
+    g_clear_pointer (&job->contents, g_bytes_unref);
+    g_clear_pointer (&job->spans, g_array_unref);
+    g_clear_pointer (&job->pieces, bl_piece_table_unref);
+    g_free (job);
+}
+
+static gboolean
+write_contents (BlSaveJob      *job,
+                GOutputStream  *stream,
+                GCancellable   *cancellable,
+                GError        **error)
+{
+    // Piece tables are too large to be worth hashing
+    if (job->spans != NULL)
+    {
+        for (guint i = 0; i < job->spans->len; i++)
+        {
+            BlPieceSpan *span = &g_array_index (job->spans, BlPieceSpan, i);
+
+            if (!g_output_stream_write_all (stream, span->data, span->length,
+                                            NULL, cancellable, error))
+                return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    gsize length;
+    const gchar *data = g_bytes_get_data (job->contents, &length);
+
+    if (!g_output_stream_write_all (stream, data, length, NULL, cancellable, error))
+        return FALSE;
+
+    if (!job->skip_hash)
+        job->hash = hash_text (HASH_INIT, data, length);
+
+    return TRUE;
+}
+
+static void
+save_thread (GTask        *task,
+             BlDocument   *self,
+             BlSaveJob    *job,
+             GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    // GIO writes to a temporary file and only renames it over the
+    // original once it is closed, so a failed save leaves it intact
+    GFileOutputStream *stream = g_file_replace (job->file, NULL, FALSE,
+                                                G_FILE_CREATE_NONE,
+                                                cancellable, &error);
+
+    if (stream == NULL)
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    if (!write_contents (job, G_OUTPUT_STREAM (stream), cancellable, &error))
+    {
+        // Closing with a cancelled cancellable discards the new file
+        GCancellable *discard = g_cancellable_new ();
+        g_cancellable_cancel (discard);
+        g_output_stream_close (G_OUTPUT_STREAM (stream), discard, NULL);
+        g_object_unref (discard);
+
+        g_object_unref (stream);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    gboolean closed = g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, &error);
+    g_object_unref (stream);
+
+    if (!closed)
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+save_done (BlDocument   *self,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+    GTask *task = G_TASK (result);
+    BlSaveJob *job = g_task_get_task_data (task);
+    GError *error = NULL;
+
+    self->saving = FALSE;
+    g_clear_error (&self->save_error);
+
+    if (g_task_propagate_boolean (task, &error))
+    {
+        // Anything typed since the snapshot is still unsaved
+        set_saved_state (self, job->sequence, job->chars, job->hash, !job->skip_hash);
+
+        // A journal cannot be checked against a file we have no hash for
+        if (job->skip_hash)
+            g_clear_pointer (&self->journal, bl_journal_discard);
+
+        if (self->journal != NULL)
+        {
+            gchar *uri = g_file_get_uri (job->file);
+            bl_journal_rebase (self->journal, job->sequence, uri, job->chars, job->hash);
+            g_free (uri);
+        }
+
+        // Edits made during the save may already have been undone
+        bl_undo_set_saved (self->undo, job->undo_position);
+        restore_saved_state (self);
+
+        if (self->file == NULL || !g_file_equal (self->file, job->file))
+            bl_document_set_file (self, job->file);
+    }
+    else
+    {
+        g_warning ("Could not save document: %s", error->message);
+        self->save_error = error;
+    }
 
+    g_signal_emit (self, signals[SAVED], 0);
+
+    // Saved again while this one was being written
+    if (self->save_queued != NULL)
+    {
+        GFile *file = g_steal_pointer (&self->save_queued);
+        bl_document_save (self, file);
+        g_object_unref (file);
+    }
+}
+
+// Writes the document to `file` (or its own file if NULL) on a worker
+// thread. The contents are copied when this is called, so the buffer
+// can be edited straight away. Only the copy happens on the calling
+// thread, and only piece tables are saved without one. "saved" is emitted once the file is
+// written or the save has failed. On success the document becomes
+// associated with `file`.
 void
-bl_document_set_file (BlDocument* document, GFile* file)
+bl_document_save (BlDocument *self,
+                  GFile      *file)
 {
-    // Load from buffer
-    gchar *contents;
-    gsize length;
-
     if (file == NULL)
+        file = self->file;
+
+    g_return_if_fail (G_IS_FILE (file));
+    g_return_if_fail (!self->loading && !self->load_pending);
+    g_return_if_fail (!bl_document_is_read_only (self));
+
+    // Only one write to disk at a time. The latest request wins.
+    if (self->saving)
     {
-        g_error("File is invalid");
+        g_set_object (&self->save_queued, file);
         return;
     }
 
-    if (g_file_load_contents (file, NULL, &contents, &length, NULL, NULL))
+    BlSaveJob *job = g_new0 (BlSaveJob, 1);
+    job->file = g_object_ref (file);
+    job->sequence = self->sequence;
+    job->undo_position = bl_undo_checkpoint (self->undo);
+    job->skip_hash = self->degraded || self->pieces != NULL;
+
+    if (self->pieces != NULL)
     {
-        gtk_text_buffer_set_text (GTK_TEXT_BUFFER (document), contents, length);
-        g_free (contents);
+        // The mapping stays valid even when saving over its own file,
+        // as the new file is renamed into place rather than written
+        job->pieces = bl_piece_table_ref (self->pieces);
+        job->spans = bl_piece_table_get_spans (self->pieces);
     }
+    else
+    {
+        GtkTextIter start;
+        GtkTextIter end;
+        gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (self), &start, &end);
 
-    document->file = file;
-    document->untitled = FALSE;
+        // A full copy, linear in the size of the document and made
+        // here on the main thread. The buffer has no cheaper way to
+        // take a snapshot. Files large enough for that to matter are
+        // mapped, and save the spans of their piece table instead.
+        gchar *text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (self), &start, &end, TRUE);
+        job->contents = g_bytes_new_take (text, strlen (text));
+        job->chars = gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (self));
+    }
+
+    self->saving = TRUE;
+
+    GTask *task = g_task_new (self, NULL, (GAsyncReadyCallback) save_done, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) save_job_free);
+    g_task_run_in_thread (task, (GTaskThreadFunc) save_thread);
+    g_object_unref (task);
+}
+
+gboolean
+bl_document_is_saving (BlDocument *self)
+{
+    return self->saving;
+}
+
+// The reason the last save failed, or NULL if it succeeded
+const GError *
+bl_document_get_save_error (BlDocument *self)
+{
+    return self->save_error;
 }
 
 BlDocument* bl_document_new ()
@@ -59,14 +905,15 @@ BlDocument* bl_document_new ()
     return doc;
 }
 
-BlDocument* bl_document_new_from_file(GFile* file)
+BlDocument* bl_document_new_from_file(GFile* file, gsize map_threshold)
 {
     g_assert(G_IS_FILE(file));
     BlDocument *doc = bl_document_new();
-    bl_document_set_file (BL_DOCUMENT(doc), file);
-    doc->untitled = FALSE;
-    bl_document_update_save_hash (doc);
-    // TODO: set file as a property so it can be loaded in initialisation
+
+    // Nothing is read until `bl_document_ensure_loaded` is called
+    bl_document_set_file (doc, file);
+    doc->map_threshold = map_threshold;
+    doc->load_pending = TRUE;
 
     return BL_DOCUMENT(doc);
 }
@@ -75,22 +922,361 @@ BlDocument* bl_document_new_untitled ()
 {
     BlDocument* doc = bl_document_new ();
     doc->untitled = TRUE;
-    bl_document_update_save_hash (doc);
+    bl_document_mark_saved (doc);
     return doc;
 }
 
+static void
+bl_document_dispose (GObject *object)
+{
+    BlDocument *self = BL_DOCUMENT (object);
+
+    bl_document_cancel_load (self);
+    g_clear_pointer (&self->journal, bl_journal_discard);
+
+    if (self->degrade_id != 0)
+    {
+        g_source_remove (self->degrade_id);
+        self->degrade_id = 0;
+    }
+
+    // A parse in flight holds its own reference to the highlighter,
+    // so make sure it lets go of the buffer now
+    if (self->highlighter != NULL)
+    {
+        g_object_run_dispose (G_OBJECT (self->highlighter));
+        g_clear_object (&self->highlighter);
+    }
+
+    G_OBJECT_CLASS (bl_document_parent_class)->dispose (object);
+}
+
 static void
 bl_document_finalize (GObject *object)
 {
+    BlDocument *self = BL_DOCUMENT (object);
+
+    bl_line_index_free (self->lines);
+    bl_undo_free (self->undo);
+    g_clear_object (&self->file);
+    g_clear_object (&self->save_queued);
+    g_clear_pointer (&self->mapped, bl_mapped_text_free);
+    g_clear_pointer (&self->pieces, bl_piece_table_unref);
+    g_clear_error (&self->load_error);
+    g_clear_error (&self->save_error);
+    g_clear_pointer (&self->unrecovered, bl_journal_recovery_free);
+    g_clear_error (&self->recovery_error);
+
     G_OBJECT_CLASS (bl_document_parent_class)->finalize (object);
 }
 
+static gboolean
+exceeds_limits (BlDocument *self)
+{
+    return (self->degrade_size > 0 && self->n_bytes >= self->degrade_size) ||
+           (self->degrade_line_length > 0 && self->longest_line >= self->degrade_line_length);
+}
+
+static void
+update_degraded (BlDocument *self)
+{
+    // Once degraded, a document stays that way until it is reloaded,
+    // rather than flipping back and forth while edited near a limit
+    gboolean degraded = !self->degrade_overridden && (self->degraded || exceeds_limits (self));
+
+    if (degraded == self->degraded)
+        return;
+
+    self->degraded = degraded;
+    bl_highlighter_set_enabled (self->highlighter, !degraded);
+    g_signal_emit (self, signals[DEGRADED_CHANGED], 0);
+}
+
+static gboolean
+cb_degrade_idle (BlDocument *self)
+{
+    self->degrade_id = 0;
+    update_degraded (self);
+    return G_SOURCE_REMOVE;
+}
+
+// Tracks the size of the document and the longest line, measuring
+// only the lines an insertion touched
+static void
+measure_insert (BlDocument *self,
+                gint        line,
+                guint       added_lines,
+                gsize       length)
+{
+    guint n_lines = bl_line_index_get_n_lines (self->lines);
+    self->n_bytes += length;
+
+    for (guint i = line; i <= line + added_lines; i++)
+    {
+        gsize start = bl_line_index_get_line_start (self->lines, i).byte;
+        gsize end = i + 1 < n_lines
+            ? bl_line_index_get_line_start (self->lines, i + 1).byte
+            : self->n_bytes;
+
+        self->longest_line = MAX (self->longest_line, end - start);
+    }
+
+    // Tags cannot be stripped in the middle of an insertion
+    if (!self->degraded && !self->degrade_overridden &&
+        self->degrade_id == 0 && exceeds_limits (self))
+        self->degrade_id = g_idle_add ((GSourceFunc) cb_degrade_idle, self);
+}
+
+// Sets the size in bytes, and line length in bytes, past which the
+// document is degraded. Either can be zero for no limit.
+void
+bl_document_set_degrade_limits (BlDocument *self,
+                                gsize       size,
+                                guint       line_length)
+{
+    self->degrade_size = size;
+    self->degrade_line_length = line_length;
+    update_degraded (self);
+}
+
+// Whether highlighting and hashing are off because the document is
+// too large, in which case views should stop wrapping lines as well
+gboolean
+bl_document_is_degraded (BlDocument *self)
+{
+    return self->degraded;
+}
+
+// Turns everything back on, however large the document gets
+void
+bl_document_override_degraded (BlDocument *self)
+{
+    self->degrade_overridden = TRUE;
+    update_degraded (self);
+
+    // Hashing was skipped while degraded. If the buffer still matches
+    // the file, catch up so content checks and journals can use it.
+    if (!self->saved_hash_known && !self->loading && self->mapped == NULL &&
+        self->sequence == self->saved_sequence)
+    {
+        set_saved_state (self, self->sequence, self->saved_chars,
+                         hash_contents (self), TRUE);
+    }
+}
+
+// The journal for the next edit, started if need be
+static BlJournal *
+get_journal (BlDocument *self)
+{
+    // Nothing to record while a file is streamed in, and windows onto
+    // large files are not journaled
+    if (self->loading || self->setting_window || self->mapped != NULL)
+        return NULL;
+
+    // A journal is replayed over the saved file, so it can only start
+    // while the document still matches it
+    if (self->journal == NULL && self->sequence == self->saved_sequence &&
+        self->saved_hash_known)
+    {
+        gchar *uri = self->file != NULL ? g_file_get_uri (self->file) : NULL;
+        self->journal = bl_journal_new (uri, self->saved_chars, self->saved_hash);
+        g_free (uri);
+    }
+
+    return self->journal;
+}
+
+// The history to record the next edit in, if any
+static BlUndo *
+get_undo (BlDocument *self)
+{
+    if (self->loading || self->setting_window || self->mapped != NULL || self->undoing)
+        return NULL;
+
+    return self->undo;
+}
+
+static void
+bl_document_insert_text (GtkTextBuffer *buffer,
+                         GtkTextIter   *pos,
+                         const gchar   *text,
+                         gint           length)
+{
+    BlDocument *self = BL_DOCUMENT (buffer);
+
+    // Record the position before `pos` is moved past the new text
+    gint line = gtk_text_iter_get_line (pos);
+    gint byte_column = gtk_text_iter_get_line_index (pos);
+    gint char_column = gtk_text_iter_get_line_offset (pos);
+    guint n_lines = bl_line_index_get_n_lines (self->lines);
+    gint offset = bl_line_index_get_line_start (self->lines, line).chr + char_column;
+    BlJournal *journal = get_journal (self);
+    BlUndo *undo = get_undo (self);
+
+    if (journal != NULL)
+        bl_journal_insert (journal, self->sequence + 1, offset,
+                           text, length < 0 ? strlen (text) : (gsize)length);
+
+    if (undo != NULL)
+        bl_undo_insert (undo, offset, text, length < 0 ? strlen (text) : (gsize)length);
+
+    if (self->pieces != NULL && !self->setting_window)
+    {
+        gsize offset = bl_line_index_get_line_start (self->lines, line).byte + byte_column;
+        bl_piece_table_insert (self->pieces, self->window_offset + offset,
+                               text, length < 0 ? strlen (text) : (gsize)length);
+    }
+
+    GTK_TEXT_BUFFER_CLASS (bl_document_parent_class)->insert_text (buffer, pos, text, length);
+
+    if (!self->setting_window)
+        self->sequence++;
+
+    bl_line_index_insert (self->lines, line, byte_column, char_column, text, length);
+    measure_insert (self, line, bl_line_index_get_n_lines (self->lines) - n_lines,
+                    length < 0 ? strlen (text) : (gsize)length);
+}
+
+static void
+bl_document_delete_range (GtkTextBuffer *buffer,
+                          GtkTextIter   *start,
+                          GtkTextIter   *end)
+{
+    BlDocument *self = BL_DOCUMENT (buffer);
+
+    gtk_text_iter_order (start, end);
+
+    gint start_line = gtk_text_iter_get_line (start);
+    gint start_byte = gtk_text_iter_get_line_index (start);
+    gint start_char = gtk_text_iter_get_line_offset (start);
+    gint end_line = gtk_text_iter_get_line (end);
+    gint end_byte = gtk_text_iter_get_line_index (end);
+    gint end_char = gtk_text_iter_get_line_offset (end);
+
+    gsize from = bl_line_index_get_line_start (self->lines, start_line).byte + start_byte;
+    gsize to = bl_line_index_get_line_start (self->lines, end_line).byte + end_byte;
+    gint from_offset = bl_line_index_get_line_start (self->lines, start_line).chr + start_char;
+    gint to_offset = bl_line_index_get_line_start (self->lines, end_line).chr + end_char;
+    BlJournal *journal = get_journal (self);
+    BlUndo *undo = get_undo (self);
+
+    if (journal != NULL)
+        bl_journal_delete (journal, self->sequence + 1, from_offset, to_offset);
+
+    // The deleted text is needed to put it back
+    if (undo != NULL)
+    {
+        gchar *text = gtk_text_iter_get_text (start, end);
+        bl_undo_delete (undo, from_offset, text, strlen (text));
+        g_free (text);
+    }
+
+    if (self->pieces != NULL && !self->setting_window)
+        bl_piece_table_delete (self->pieces, self->window_offset + from, to - from);
+
+    self->n_bytes -= to - from;
+
+    GTK_TEXT_BUFFER_CLASS (bl_document_parent_class)->delete_range (buffer, start, end);
+
+    if (!self->setting_window)
+        self->sequence++;
+    bl_line_index_delete (self->lines,
+                          start_line, start_byte, start_char,
+                          end_line, end_byte, end_char);
+}
+
+static void
+bl_document_begin_user_action (GtkTextBuffer *buffer)
+{
+    BlDocument *self = BL_DOCUMENT (buffer);
+
+    bl_undo_begin_action (self->undo);
+}
+
+static void
+bl_document_end_user_action (GtkTextBuffer *buffer)
+{
+    BlDocument *self = BL_DOCUMENT (buffer);
+
+    bl_undo_end_action (self->undo);
+}
+
 static void
 bl_document_class_init (BlDocumentClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkTextBufferClass *buffer_class = GTK_TEXT_BUFFER_CLASS (klass);
 
+    object_class->dispose = bl_document_dispose;
     object_class->finalize = bl_document_finalize;
+
+    // Keep the line index in step with every edit
+    buffer_class->insert_text = bl_document_insert_text;
+    buffer_class->delete_range = bl_document_delete_range;
+
+    // Each user action is undone as a whole
+    buffer_class->begin_user_action = bl_document_begin_user_action;
+    buffer_class->end_user_action = bl_document_end_user_action;
+
+    signals[LOADED] =
+        g_signal_newv ("loaded",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
+
+    signals[SAVED] =
+        g_signal_newv ("saved",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
+
+    signals[DEGRADED_CHANGED] =
+        g_signal_newv ("degraded-changed",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
+
+    signals[RECOVERY_CHANGED] =
+        g_signal_newv ("recovery-changed",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
+
+    signals[LOAD_PROGRESS] =
+        g_signal_newv ("load-progress",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
 }
 
 gboolean bl_document_is_untitled (BlDocument* doc)
@@ -101,7 +1287,7 @@ gboolean bl_document_is_untitled (BlDocument* doc)
 gchar* bl_document_get_basename(BlDocument* doc)
 {
     if (doc->untitled)
-        return "Untitled Document";
+        return g_strdup ("Untitled Document");
     GFile* file = bl_document_get_file(doc);
     return g_file_get_basename (file);
 }
@@ -147,38 +1333,131 @@ GtkTextBuffer* bl_document_get_buffer (BlDocument* doc)
     return GTK_TEXT_BUFFER (doc);
 }
 
+// The tags used for markdown highlighting. Each view changes the
+// "user-style" tag to match its font settings.
+static void
+create_tags (BlDocument *self)
+{
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (self);
+
+    // PSA: `create_tag` needs to be NULL terminated, otherwise
+    // everything breaks, in a very painful way.
+
+    // Tag: Heading 1
+    gtk_text_buffer_create_tag(buffer, "heading1",
+                               "scale", (double)2,
+                               NULL);
+    // Tag: Heading 2
+    gtk_text_buffer_create_tag(buffer, "heading2",
+                               "foreground", "#d70022",
+                               "scale", (double)1.5,
+                               NULL);
+
+    // Tag: Heading 3
+    gtk_text_buffer_create_tag(buffer, "heading3",
+                               "foreground", "#0a84ff",
+                               "scale", (double)1.4,
+                               NULL);
+
+    // Tag: Heading 4
+    gtk_text_buffer_create_tag(buffer, "heading4",
+                               "foreground", "#ff9400",
+                               "scale", (double)1.3,
+                               NULL);
+
+    // Tag: Heading 5
+    gtk_text_buffer_create_tag(buffer, "heading5",
+                               "foreground", "#9400ff",
+                               "scale", (double)1.2,
+                               NULL);
+
+    // Tag: Heading 6
+    gtk_text_buffer_create_tag(buffer, "heading6",
+                               "foreground", "#363959",
+                               "weight", PANGO_WEIGHT_BOLD,
+                               NULL);
+
+    // Tag: Bold
+    gtk_text_buffer_create_tag(buffer, "bold",
+                               "weight", PANGO_WEIGHT_BOLD,
+                               NULL);
+
+    // Tag: Italic
+    gtk_text_buffer_create_tag(buffer, "italic",
+                               "style", PANGO_STYLE_ITALIC,
+                               NULL);
+
+    // Tag: Widget Font Styling
+    GtkTextTag *user_style =
+        gtk_text_buffer_create_tag (buffer, "user-style",
+                                    NULL);
+
+    gtk_text_tag_set_priority (user_style, 0);
+}
+
+BlHighlighter *
+bl_document_get_highlighter (BlDocument *self)
+{
+    return self->highlighter;
+}
+
+BlLineIndex *
+bl_document_get_line_index (BlDocument *self)
+{
+    return self->lines;
+}
+
 static void
 bl_document_init(BlDocument* self)
 {
     self->file = NULL;
+    self->lines = bl_line_index_new ();
+    self->degrade_size = BL_DOCUMENT_DEFAULT_DEGRADE_SIZE;
+    self->degrade_line_length = BL_DOCUMENT_DEFAULT_DEGRADE_LINE_LENGTH;
+    self->undo = bl_undo_new (BL_DOCUMENT_DEFAULT_UNDO_LIMIT);
+
+    // Parsing and tagging happen once here, however many views
+    // are showing the document
+    create_tags (self);
+    self->highlighter = bl_highlighter_new (GTK_TEXT_BUFFER (self));
     // TODO: Load contents from file here
     // when the initial property is set
     // Currently done in `helper_set_file`
 }
 
-guint bl_document_get_current_hash (BlDocument *self)
+// Characters hashed per slice
+#define HASH_CHUNK_SIZE 65536
+
+// Hashes the contents from the buffer, one slice at a time so the
+// buffer is never copied as a whole
+static guint
+hash_contents (BlDocument *self)
 {
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (self);
+    guint32 hash = HASH_INIT;
+
     GtkTextIter start;
     GtkTextIter end;
-    gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (self), &start);
-    gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (self), &end);
+    gtk_text_buffer_get_start_iter (buffer, &start);
 
-    // Get text from GtkTextBuffer
-    gchar* text;
-    text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (self), &start, &end, FALSE);
+    while (!gtk_text_iter_is_end (&start))
+    {
+        end = start;
+        gtk_text_iter_forward_chars (&end, HASH_CHUNK_SIZE);
 
-    GString *str = g_string_new(text);
-    return g_string_hash (str);
-}
+        gchar *text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+        hash = hash_text (hash, text, strlen (text));
+        g_free (text);
+        start = end;
+    }
 
-guint bl_document_get_save_hash (BlDocument *self)
-{
-    return self->hash;
+    return hash;
 }
 
-void bl_document_set_save_hash (BlDocument *self, guint cmp)
+guint64
+bl_document_get_sequence (BlDocument *self)
 {
-    self->hash = cmp;
+    return self->sequence;
 }
 
 gboolean bl_document_unsaved_changes (BlDocument *self)
@@ -186,16 +1465,218 @@ gboolean bl_document_unsaved_changes (BlDocument *self)
     if (self == NULL)
         return FALSE;
 
-    guint current = bl_document_get_current_hash (self);
-    guint saved = bl_document_get_save_hash (self);
+    if (bl_document_is_read_only (self))
+        return FALSE;
 
-    if (current == saved)
+    if (self->sequence == self->saved_sequence)
         return FALSE;
-    else
+
+    // The buffer is only part of a piece table
+    if (self->pieces != NULL)
+        return TRUE;
+
+    // Edits undone back to the saved state, which the history knows
+    // without looking at the contents. A document retyped back to what
+    // was saved still counts as changed.
+    return !bl_undo_is_saved (self->undo);
+}
+
+// Records the state the document was in when `sequence` was current
+// as the one on disk. The length and hash are what a journal written
+// against it is checked by.
+static void
+set_saved_state (BlDocument *self,
+                 guint64     sequence,
+                 gint        chars,
+                 guint       hash,
+                 gboolean    hash_known)
+{
+    self->saved_sequence = sequence;
+    self->saved_chars = chars;
+    self->saved_hash = hash;
+    self->saved_hash_known = hash_known;
+}
+
+static void
+rebase_journal (BlDocument *self)
+{
+    if (self->journal == NULL)
+        return;
+
+    if (!self->saved_hash_known)
+    {
+        g_clear_pointer (&self->journal, bl_journal_discard);
+        return;
+    }
+
+    gchar *uri = self->file != NULL ? g_file_get_uri (self->file) : NULL;
+    bl_journal_rebase (self->journal, self->sequence, uri, self->saved_chars, self->saved_hash);
+    g_free (uri);
+}
+
+// Once the history is back at the saved state, the current sequence
+// stands for the saved contents and the journal has nothing to replay
+static void
+restore_saved_state (BlDocument *self)
+{
+    if (self->sequence == self->saved_sequence || !bl_undo_is_saved (self->undo))
+        return;
+
+    set_saved_state (self, self->sequence, self->saved_chars, self->saved_hash,
+                     self->saved_hash_known);
+    rebase_journal (self);
+}
+
+void bl_document_mark_saved (BlDocument *self)
+{
+    set_saved_state (self, self->sequence,
+                     gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (self)),
+                     self->degraded ? 0 : hash_contents (self), !self->degraded);
+
+    bl_undo_set_saved (self->undo, bl_undo_checkpoint (self->undo));
+    rebase_journal (self);
+}
+
+// Undo History
+static gboolean
+has_history (BlDocument *self)
+{
+    return !self->loading && self->mapped == NULL;
+}
+
+gboolean
+bl_document_can_undo (BlDocument *self)
+{
+    return has_history (self) && bl_undo_can_undo (self->undo);
+}
+
+gboolean
+bl_document_can_redo (BlDocument *self)
+{
+    return has_history (self) && bl_undo_can_redo (self->undo);
+}
+
+gboolean
+bl_document_undo (BlDocument *self)
+{
+    if (!bl_document_can_undo (self))
+        return FALSE;
+
+    self->undoing = TRUE;
+    bl_undo_undo (self->undo, GTK_TEXT_BUFFER (self));
+    self->undoing = FALSE;
+
+    restore_saved_state (self);
+    return TRUE;
+}
+
+gboolean
+bl_document_redo (BlDocument *self)
+{
+    if (!bl_document_can_redo (self))
+        return FALSE;
+
+    self->undoing = TRUE;
+    bl_undo_redo (self->undo, GTK_TEXT_BUFFER (self));
+    self->undoing = FALSE;
+
+    restore_saved_state (self);
+    return TRUE;
+}
+
+// Oldest edits are forgotten once the history takes up more than
+// `limit` bytes (zero for no limit)
+void
+bl_document_set_undo_limit (BlDocument *self,
+                            gsize       limit)
+{
+    bl_undo_set_limit (self->undo, limit);
+}
+
+// Drops the record of unsaved edits, for a document closed without
+// saving them
+void
+bl_document_discard_journal (BlDocument *self)
+{
+    g_clear_pointer (&self->journal, bl_journal_discard);
+}
+
+static gboolean
+apply_recovery (BlDocument         *self,
+                BlJournalRecovery  *recovery,
+                GError            **error)
+{
+    if (self->load_pending || self->loading || self->mapped != NULL)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "The document is not fully loaded");
+        return FALSE;
+    }
+
+    // Too large to have been hashed, so there is nothing to check the
+    // journal's base against
+    if (!self->saved_hash_known)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     "The document is too large to recover");
+        return FALSE;
+    }
+
+    return bl_journal_recovery_apply (recovery, GTK_TEXT_BUFFER (self),
+                                      self->saved_chars, self->saved_hash, error);
+}
+
+// Replays edits left in a journal by a previous run, taking ownership
+// of `recovery`. The document must have finished loading the file the
+// journal was written against. The journal is only removed once it
+// has been replayed. Otherwise it stays on disk and with the document,
+// whose recovery error is set, until bl_document_discard_recovery().
+gboolean
+bl_document_recover (BlDocument         *self,
+                     BlJournalRecovery  *recovery,
+                     GError            **error)
+{
+    GError *local_error = NULL;
+
+    if (apply_recovery (self, recovery, &local_error))
+    {
+        bl_journal_recovery_discard (recovery);
         return TRUE;
+    }
+
+    g_clear_pointer (&self->unrecovered, bl_journal_recovery_free);
+    g_clear_error (&self->recovery_error);
+    self->unrecovered = recovery;
+    self->recovery_error = g_error_copy (local_error);
+    g_propagate_error (error, local_error);
+
+    g_signal_emit (self, signals[RECOVERY_CHANGED], 0);
+    return FALSE;
+}
+
+// Why edits from a previous run could not be replayed, or NULL
+const GError *
+bl_document_get_recovery_error (BlDocument *self)
+{
+    return self->recovery_error;
+}
+
+const gchar *
+bl_document_get_recovery_path (BlDocument *self)
+{
+    return self->unrecovered != NULL ? bl_journal_recovery_get_path (self->unrecovered) : NULL;
 }
 
-void bl_document_update_save_hash (BlDocument *self)
+// Gives up on the edits that could not be recovered, removing their
+// journal from disk
+void
+bl_document_discard_recovery (BlDocument *self)
 {
-    self->hash = bl_document_get_current_hash (self);
+    if (self->unrecovered == NULL)
+        return;
+
+    g_clear_pointer (&self->unrecovered, bl_journal_recovery_discard);
+    g_clear_error (&self->recovery_error);
+
+    g_signal_emit (self, signals[RECOVERY_CHANGED], 0);
 }
@@ -22,12 +22,16 @@
 
 #include <gtk/gtk.h>
 
+#include "bl-highlighter.h"
+#include "bl-journal.h"
+#include "bl-line-index.h"
+
 G_BEGIN_DECLS
 
 #define BL_TYPE_DOCUMENT (bl_document_get_type())
 G_DECLARE_FINAL_TYPE (BlDocument, bl_document, BL, DOCUMENT, GtkTextBuffer)
 
-BlDocument* bl_document_new_from_file(GFile* file);
+BlDocument* bl_document_new_from_file(GFile* file, gsize map_threshold);
 BlDocument* bl_document_new_untitled ();
 GFile* bl_document_get_file(BlDocument* doc);
 GtkTextBuffer* bl_document_get_buffer(BlDocument* doc);
@@ -37,13 +41,61 @@ gchar* bl_document_get_uri (BlDocument *doc);
 void bl_document_set_file (BlDocument* document, GFile* file);
 gboolean bl_document_is_untitled (BlDocument* doc);
 
-// Low Level Hash Functions
-void bl_document_set_save_hash (BlDocument *self, guint cmp);
-guint bl_document_get_save_hash (BlDocument *self);
-guint bl_document_get_current_hash (BlDocument *self);
+// Loading
+void bl_document_load (BlDocument *self, GFile *file, gsize map_threshold);
+void bl_document_ensure_loaded (BlDocument *self);
+gboolean bl_document_is_load_pending (BlDocument *self);
+void bl_document_cancel_load (BlDocument *self);
+gboolean bl_document_is_loading (BlDocument *self);
+gdouble bl_document_get_load_progress (BlDocument *self);
+const GError *bl_document_get_load_error (BlDocument *self);
+
+// Large Files
+gboolean bl_document_is_mapped (BlDocument *self);
+gboolean bl_document_is_read_only (BlDocument *self);
+guint bl_document_get_mapped_lines (BlDocument *self);
+guint bl_document_get_window_start (BlDocument *self);
+void bl_document_set_window (BlDocument *self, guint first_line, guint n_lines);
+void bl_document_make_editable (BlDocument *self);
+
+// Degraded Mode
+#define BL_DOCUMENT_DEFAULT_DEGRADE_SIZE (16 * 1024 * 1024)
+#define BL_DOCUMENT_DEFAULT_DEGRADE_LINE_LENGTH 10000
+
+void bl_document_set_degrade_limits (BlDocument *self, gsize size, guint line_length);
+gboolean bl_document_is_degraded (BlDocument *self);
+void bl_document_override_degraded (BlDocument *self);
+
+// Saving
+void bl_document_save (BlDocument *self, GFile *file);
+gboolean bl_document_is_saving (BlDocument *self);
+const GError *bl_document_get_save_error (BlDocument *self);
 
-// High Level Hash Functions
+// Highlighting
+BlHighlighter *bl_document_get_highlighter (BlDocument *self);
+
+// Line Index
+BlLineIndex *bl_document_get_line_index (BlDocument *self);
+
+// Save State
+guint64 bl_document_get_sequence (BlDocument *self);
 gboolean bl_document_unsaved_changes (BlDocument *self);
-void bl_document_update_save_hash (BlDocument *self);
+void bl_document_mark_saved (BlDocument *self);
+
+// Undo History
+#define BL_DOCUMENT_DEFAULT_UNDO_LIMIT (64 * 1024 * 1024)
+
+gboolean bl_document_can_undo (BlDocument *self);
+gboolean bl_document_can_redo (BlDocument *self);
+gboolean bl_document_undo (BlDocument *self);
+gboolean bl_document_redo (BlDocument *self);
+void bl_document_set_undo_limit (BlDocument *self, gsize limit);
+
+// Crash Recovery
+void bl_document_discard_journal (BlDocument *self);
+gboolean bl_document_recover (BlDocument *self, BlJournalRecovery *recovery, GError **error);
+const GError *bl_document_get_recovery_error (BlDocument *self);
+const gchar *bl_document_get_recovery_path (BlDocument *self);
+void bl_document_discard_recovery (BlDocument *self);
 
 G_END_DECLS
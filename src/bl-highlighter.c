@@ -0,0 +1,1850 @@
+/* bl-highlighter.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-highlighter.h"
+#include "bl-arena.h"
+#include "bl-document.h"
+#include "bl-line-index.h"
+#include "bl-trace.h"
+#include <cmark.h>
+
+// Styles produced by the parser thread. Each maps onto a tag
+// created by BlDocument.
+typedef enum
+{
+    BL_STYLE_HEADING1,
+    BL_STYLE_HEADING2,
+    BL_STYLE_HEADING3,
+    BL_STYLE_HEADING4,
+    BL_STYLE_HEADING5,
+    BL_STYLE_HEADING6,
+    BL_STYLE_BOLD,
+    BL_STYLE_ITALIC,
+    BL_STYLE_NONE
+} BlSpanStyle;
+
+static const gchar *style_tag_names[] = {
+    "heading1",
+    "heading2",
+    "heading3",
+    "heading4",
+    "heading5",
+    "heading6",
+    "bold",
+    "italic"
+};
+
+struct _BlHighlighter
+{
+    GObject parent_instance;
+
+    GtkTextBuffer *buffer;
+    GtkTextTag *user_style_tag;
+    GtkTextTag *style_tags[BL_STYLE_NONE];
+
+    // Views showing the buffer
+    GList *views;
+
+    // Incremental Highlighting
+    GArray *blocks;
+    gboolean dirty;
+    gint dirty_start;
+    gint dirty_end;
+    gboolean needs_full;
+
+    // Background Parsing
+    BlArena *arena;
+    guint generation;
+    gboolean running;
+    GCancellable *cancellable;
+    gint inflight_start;
+    gint inflight_end;
+    gboolean inflight_full;
+    GArray *inflight_lines;
+
+    // Progressive Tagging
+    GTask *applying;
+    GArray *apply_edits;
+    GArray *apply_todo;
+    gint apply_cursor;
+    guint apply_id;
+    gdouble budget;
+    gint64 apply_time;
+
+    // Spans currently tagged in the buffer, ordered by start offset
+    GArray *spans;
+    gint spans_max;
+    gboolean spans_known;
+
+    // Scheduling
+    guint debounce;
+    guint max_latency;
+    GtkWidget *tick_widget;
+    guint tick_id;
+    guint timeout_id;
+    guint pending_changes;
+    gint64 burst_start;
+    gint64 last_change;
+    gboolean deferred;
+    gboolean disabled;
+    BlHighlightStats stats;
+};
+
+G_DEFINE_TYPE (BlHighlighter, bl_highlighter, G_TYPE_OBJECT)
+
+enum
+{
+    PARSED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+// A styled range of the buffer, in character offsets
+typedef struct
+{
+    gint start;
+    gint end;
+    BlSpanStyle style;
+} BlSpan;
+
+static BlSpanStyle
+get_node_style (cmark_node *node)
+{
+    switch (cmark_node_get_type(node))
+    {
+        // All Headings (1-6)
+        case CMARK_NODE_HEADING:
+        {
+            int level = cmark_node_get_heading_level(node);
+            if (level >= 1 && level <= 6)
+                return BL_STYLE_HEADING1 + (level - 1);
+            return BL_STYLE_NONE;
+        }
+
+        // Bold
+        case CMARK_NODE_STRONG:
+            return BL_STYLE_BOLD;
+
+        // Italic
+        case CMARK_NODE_EMPH:
+            return BL_STYLE_ITALIC;
+
+        // Do nothing (for completeness)
+        default:
+            return BL_STYLE_NONE;
+    }
+}
+
+// Top-level cmark block, in buffer lines (0-indexed, inclusive)
+typedef struct
+{
+    gint start_line;
+    gint end_line;
+    cmark_node_type type;
+} BlBlock;
+
+// A buffer edit made while a parse result is being applied, in
+// character offsets. Negative deltas are deletions.
+typedef struct
+{
+    gint offset;
+    gint delta;
+} BlEdit;
+
+// Lines added at `first`, or lines (first, last] removed, while a
+// full parse is running
+typedef struct
+{
+    gint first;
+    gint last;
+    gint added;
+} BlLineEdit;
+
+// A range of characters still to be tagged
+typedef struct
+{
+    gint start;
+    gint end;
+} BlRange;
+
+// Maximum number of neighbouring blocks we will pull into an
+// incremental pass before giving up and parsing the whole document
+#define MAX_REGION_EXTENSIONS 8
+
+static void
+shift_range (gint *start,
+             gint *end,
+             gint  line,
+             gint  delta)
+{
+    // Lines were inserted (delta > 0) at `line`. Anything after
+    // the insertion moves down, anything spanning it grows.
+    if (*start > line)
+    {
+        *start += delta;
+        *end += delta;
+    }
+    else if (*end >= line)
+    {
+        *end += delta;
+    }
+}
+
+static void
+collapse_range (gint *start,
+                gint *end,
+                gint  first,
+                gint  last)
+{
+    // Lines (first, last] were removed and `first` absorbed
+    // whatever was left of `last`.
+    gint removed = last - first;
+
+    if (*start > last)
+    {
+        *start -= removed;
+        *end -= removed;
+        return;
+    }
+
+    if (*end < first)
+        return;
+
+    *start = MIN (*start, first);
+    *end = (*end > last) ? *end - removed : first;
+}
+
+static void
+mark_dirty (BlHighlighter  *self,
+            gint            start_line,
+            gint            end_line)
+{
+    if (!self->dirty)
+    {
+        self->dirty_start = start_line;
+        self->dirty_end = end_line;
+        self->dirty = TRUE;
+        return;
+    }
+
+    self->dirty_start = MIN (self->dirty_start, start_line);
+    self->dirty_end = MAX (self->dirty_end, end_line);
+}
+
+static gboolean
+text_has_fence (const gchar *text,
+                gssize       length)
+{
+    // Fenced code blocks change the meaning of everything after
+    // them, so they can never be handled incrementally
+    if (length < 0)
+        length = strlen (text);
+
+    for (const gchar *c = text; c + 2 < text + length; c++)
+    {
+        if ((c[0] == '`' && c[1] == '`' && c[2] == '`') ||
+            (c[0] == '~' && c[1] == '~' && c[2] == '~'))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+insert_into_spans (BlHighlighter  *self,
+                   gint            offset,
+                   gint            length)
+{
+    // Inserted text never picks up tags, so a span that the insertion
+    // lands strictly inside is split in two around it
+    GArray *tails = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+    guint first_after = self->spans->len;
+
+    for (guint i = 0; i < self->spans->len; i++)
+    {
+        BlSpan *span = &g_array_index (self->spans, BlSpan, i);
+
+        if (span->start >= offset)
+        {
+            first_after = MIN (first_after, i);
+            span->start += length;
+            span->end += length;
+        }
+        else if (span->end > offset)
+        {
+            BlSpan tail = { offset + length, span->end + length, span->style };
+            g_array_append_val (tails, tail);
+            span->end = offset;
+        }
+    }
+
+    if (tails->len > 0)
+        g_array_insert_vals (self->spans, first_after, tails->data, tails->len);
+
+    g_array_free (tails, TRUE);
+}
+
+static void
+delete_from_spans (BlHighlighter  *self,
+                   gint            start,
+                   gint            end)
+{
+    gint removed = end - start;
+    guint kept = 0;
+
+    for (guint i = 0; i < self->spans->len; i++)
+    {
+        BlSpan span = g_array_index (self->spans, BlSpan, i);
+
+        if (span.start >= end)
+            span.start -= removed;
+        else if (span.start > start)
+            span.start = start;
+
+        if (span.end >= end)
+            span.end -= removed;
+        else if (span.end > start)
+            span.end = start;
+
+        // Spans that were entirely deleted disappear
+        if (span.start < span.end)
+            g_array_index (self->spans, BlSpan, kept++) = span;
+    }
+
+    g_array_set_size (self->spans, kept);
+}
+
+static void
+cb_insert_text (GtkTextBuffer  *buffer,
+                GtkTextIter    *location,
+                gchar          *text,
+                gint            length,
+                BlHighlighter  *self)
+{
+    gint line = gtk_text_iter_get_line (location);
+    gint added = 0;
+
+    for (gint i = 0; i < length; i++)
+    {
+        if (text[i] == '\n')
+            added++;
+    }
+
+    if (added > 0)
+    {
+        for (guint i = 0; i < self->blocks->len; i++)
+        {
+            BlBlock *block = &g_array_index (self->blocks, BlBlock, i);
+            shift_range (&block->start_line, &block->end_line, line, added);
+        }
+
+        if (self->dirty)
+            shift_range (&self->dirty_start, &self->dirty_end, line, added);
+
+        if (self->running)
+            shift_range (&self->inflight_start, &self->inflight_end, line, added);
+
+        if (self->inflight_full)
+        {
+            BlLineEdit edit = { line, line, added };
+            g_array_append_val (self->inflight_lines, edit);
+        }
+    }
+
+    if (text_has_fence (text, length))
+        self->needs_full = TRUE;
+
+    if (self->applying != NULL || self->inflight_full)
+    {
+        BlEdit edit = { gtk_text_iter_get_offset (location), g_utf8_strlen (text, length) };
+        g_array_append_val (self->apply_edits, edit);
+    }
+
+    insert_into_spans (self, gtk_text_iter_get_offset (location),
+                       g_utf8_strlen (text, length));
+
+    mark_dirty (self, line, line + added);
+}
+
+static void
+cb_delete_range (GtkTextBuffer  *buffer,
+                 GtkTextIter    *start,
+                 GtkTextIter    *end,
+                 BlHighlighter  *self)
+{
+    gint first = gtk_text_iter_get_line (start);
+    gint last = gtk_text_iter_get_line (end);
+
+    if (last > first)
+    {
+        for (guint i = 0; i < self->blocks->len; i++)
+        {
+            BlBlock *block = &g_array_index (self->blocks, BlBlock, i);
+            collapse_range (&block->start_line, &block->end_line, first, last);
+        }
+
+        if (self->dirty)
+            collapse_range (&self->dirty_start, &self->dirty_end, first, last);
+
+        if (self->running)
+            collapse_range (&self->inflight_start, &self->inflight_end, first, last);
+
+        if (self->inflight_full)
+        {
+            BlLineEdit edit = { first, last, 0 };
+            g_array_append_val (self->inflight_lines, edit);
+        }
+    }
+
+    // Only the deleted slice is inspected, never the whole buffer
+    gchar *removed = gtk_text_buffer_get_slice (buffer, start, end, TRUE);
+    if (text_has_fence (removed, -1))
+        self->needs_full = TRUE;
+    g_free (removed);
+
+    if (self->applying != NULL || self->inflight_full)
+    {
+        BlEdit edit = { gtk_text_iter_get_offset (start),
+                        gtk_text_iter_get_offset (start) - gtk_text_iter_get_offset (end) };
+        g_array_append_val (self->apply_edits, edit);
+    }
+
+    delete_from_spans (self, gtk_text_iter_get_offset (start),
+                       gtk_text_iter_get_offset (end));
+
+    mark_dirty (self, first, first);
+}
+
+static void
+cb_insert_text_after (GtkTextBuffer  *buffer,
+                      GtkTextIter    *location,
+                      gchar          *text,
+                      gint            length,
+                      BlHighlighter  *self)
+{
+    // The default handler has moved `location` to the end of the
+    // inserted text. Give it the user's font straight away so typing
+    // never waits on the parser thread.
+    GtkTextIter start = *location;
+    gtk_text_iter_backward_chars (&start, g_utf8_strlen (text, length));
+    gtk_text_buffer_apply_tag (buffer, self->user_style_tag, &start, location);
+}
+
+static gboolean
+line_is_blank (GtkTextBuffer *buffer,
+               gint           line)
+{
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
+
+    while (!gtk_text_iter_ends_line (&iter))
+    {
+        if (!g_unichar_isspace (gtk_text_iter_get_char (&iter)))
+            return FALSE;
+
+        gtk_text_iter_forward_char (&iter);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+block_is_structural (BlBlock *block)
+{
+    // Blocks whose extent depends on a closing marker elsewhere
+    // in the document (e.g. ``` or </div>)
+    return block->type == CMARK_NODE_CODE_BLOCK ||
+           block->type == CMARK_NODE_HTML_BLOCK;
+}
+
+// Widens the dirty lines to the enclosing top-level blocks. Returns
+// FALSE if the edit cannot be handled incrementally.
+static gboolean
+get_dirty_region (BlHighlighter  *self,
+                  GtkTextBuffer  *buffer,
+                  gint           *region_start,
+                  gint           *region_end)
+{
+    if (self->needs_full || self->blocks->len == 0)
+        return FALSE;
+
+    gint last_line = gtk_text_buffer_get_line_count (buffer) - 1;
+    gint start = CLAMP (self->dirty_start, 0, last_line);
+    gint end = CLAMP (self->dirty_end, start, last_line);
+
+    // Blocks directly touching the edit can be affected by it
+    // (e.g. a setext underline or a deleted blank line)
+    gint touch_start = MAX (start - 1, 0);
+    gint touch_end = MIN (end + 1, last_line);
+
+    for (gint pass = 0; pass <= MAX_REGION_EXTENSIONS; pass++)
+    {
+        gboolean grown = FALSE;
+
+        for (guint i = 0; i < self->blocks->len; i++)
+        {
+            BlBlock *block = &g_array_index (self->blocks, BlBlock, i);
+
+            if (block->end_line < touch_start ||
+                block->start_line > touch_end)
+                continue;
+
+            if (block_is_structural (block))
+                return FALSE;
+
+            if (block->start_line < start)
+            {
+                start = block->start_line;
+                grown = TRUE;
+            }
+
+            if (block->end_line > end)
+            {
+                end = MIN (block->end_line, last_line);
+                grown = TRUE;
+            }
+        }
+
+        // Keep pulling in neighbours until the region is bounded by
+        // blank lines (or the document edges) on both sides. Blocks
+        // separated by a blank line are parsed independently.
+        gboolean open_start = start > 0 && !line_is_blank (buffer, start - 1);
+        gboolean open_end = end < last_line && !line_is_blank (buffer, end + 1);
+
+        if (!grown && !open_start && !open_end)
+        {
+            *region_start = start;
+            *region_end = end;
+            return TRUE;
+        }
+
+        touch_start = open_start ? start - 1 : start;
+        touch_end = open_end ? end + 1 : end;
+
+        if (!grown)
+        {
+            // No known block covers the neighbouring line
+            start = touch_start;
+            end = touch_end;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+replace_blocks (BlHighlighter  *self,
+                gint            start_line,
+                gint            end_line,
+                GArray         *new_blocks)
+{
+    // Remove every block in the re-parsed region and splice the
+    // freshly parsed ones into its place (blocks are kept sorted)
+    guint insert_at = self->blocks->len;
+
+    for (guint i = 0; i < self->blocks->len; )
+    {
+        BlBlock *block = &g_array_index (self->blocks, BlBlock, i);
+
+        if (block->end_line >= start_line &&
+            block->start_line <= end_line)
+        {
+            insert_at = MIN (insert_at, i);
+            g_array_remove_index (self->blocks, i);
+            continue;
+        }
+
+        if (block->start_line > end_line)
+            insert_at = MIN (insert_at, i);
+
+        i++;
+    }
+
+    g_array_insert_vals (self->blocks, insert_at,
+                         new_blocks->data, new_blocks->len);
+}
+
+static void
+get_region_iters (GtkTextBuffer *buffer,
+                  gint           start_line,
+                  gint           end_line,
+                  GtkTextIter   *start,
+                  GtkTextIter   *end)
+{
+    gtk_text_buffer_get_iter_at_line (buffer, start, start_line);
+    gtk_text_buffer_get_iter_at_line (buffer, end, end_line);
+    if (!gtk_text_iter_ends_line (end))
+        gtk_text_iter_forward_to_line_end (end);
+}
+
+// Snapshot of a region handed to the parser thread. The text is
+// owned by the job, so the buffer is free to change while it runs.
+typedef struct
+{
+    gchar *text;
+    gint start_line;
+    gint end_line;
+    gint start_offset;
+    gint end_offset;
+    guint generation;
+    gboolean incremental;
+
+    // Line starts within `text`, copied from the document's line
+    // index. NULL if the buffer does not keep one.
+    GArray *lines;
+
+    // Owned by the highlighter. Only one parse runs at a time, so
+    // the worker has it to itself.
+    BlArena *arena;
+
+    // Results
+    GArray *spans;
+    GArray *blocks;
+    gint max_span;
+    BlArenaStats arena_stats;
+    gint64 parse_time;
+} BlParseJob;
+
+static void
+parse_job_free (BlParseJob *job)
+{
+    g_free (job->text);
+
+    if (job->lines != NULL)
+        g_array_free (job->lines, TRUE);
+
+    if (job->spans != NULL)
+        g_array_free (job->spans, TRUE);
+
+    if (job->blocks != NULL)
+        g_array_free (job->blocks, TRUE);
+
+    g_free (job);
+}
+
+// Converts a cmark (line, byte column) position into a character
+// offset relative to the start of the snapshot
+static gint
+get_offset_for_sourcepos (const gchar *text,
+                          gsize        length,
+                          GArray      *lines,
+                          gint         line,
+                          gint         column)
+{
+    if (line >= (gint)lines->len)
+        return g_array_index (lines, BlLineStart, lines->len - 1).chr +
+               g_utf8_strlen (text + g_array_index (lines, BlLineStart, lines->len - 1).byte, -1);
+
+    BlLineStart *start = &g_array_index (lines, BlLineStart, line);
+    gsize line_end = (line + 1 < (gint)lines->len)
+                   ? g_array_index (lines, BlLineStart, line + 1).byte - 1
+                   : length;
+
+    // Guard against columns past the end of the line
+    gsize bytes = MIN ((gsize)column, line_end - start->byte);
+
+    return start->chr + g_utf8_strlen (text + start->byte, bytes);
+}
+
+// cmark's allocator hooks take no user data, so the worker thread
+// publishes the arena it is parsing into here
+static GPrivate current_arena;
+
+static void *
+arena_calloc (size_t count,
+              size_t size)
+{
+    if (size != 0 && count > G_MAXSIZE / size)
+        g_error ("Markdown parser allocation overflow");
+
+    return bl_arena_alloc0 (g_private_get (&current_arena), count * size);
+}
+
+static void *
+arena_realloc (void   *mem,
+               size_t  size)
+{
+    return bl_arena_realloc (g_private_get (&current_arena), mem, size);
+}
+
+static void
+arena_free (void *mem)
+{
+    // Everything is released at once when the arena is reset
+}
+
+static cmark_mem arena_mem = { arena_calloc, arena_realloc, arena_free };
+
+// Size of each arena chunk
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// Number of nodes visited between cancellation checks
+#define CANCEL_CHECK_INTERVAL 256
+
+static void
+parse_thread (GTask        *task,
+              gpointer      source_object,
+              BlParseJob   *job,
+              GCancellable *cancellable)
+{
+    // Adapted from https://github.com/ali-rantakari/peg-markdown-highlight/blob/master/example_gtk2/gtkexample.c
+    // Modified for gtk3 and cmark by Matthew Jakeman
+
+    const gchar *text = job->text;
+
+    // Get length
+    gsize length = strlen(text);
+
+    // A fence may have been completed one character at a time,
+    // which the incremental pass cannot handle
+    if (job->incremental && text_has_fence (text, length))
+    {
+        g_task_return_boolean (task, FALSE);
+        return;
+    }
+
+    // Sourcepos is turned into character offsets through the line
+    // starts. Plain buffers have no index, so build one here.
+    if (job->lines == NULL)
+    {
+        job->lines = g_array_new (FALSE, FALSE, sizeof (BlLineStart));
+
+        BlLineIndex *index = bl_line_index_new ();
+        bl_line_index_reset (index, text, length);
+        bl_line_index_copy_range (index, 0, bl_line_index_get_n_lines (index) - 1, job->lines);
+        bl_line_index_free (index);
+    }
+
+    GArray *lines = job->lines;
+    gint64 parse_start = g_get_monotonic_time ();
+
+    // Markdown Parsing. Nodes are bump-allocated from the arena and
+    // never freed one by one; the next parse simply reuses the memory.
+    bl_arena_reset (job->arena);
+    g_private_set (&current_arena, job->arena);
+
+    cmark_parser *parser = cmark_parser_new_with_mem (CMARK_OPT_DEFAULT | CMARK_OPT_SOURCEPOS,
+                                                      &arena_mem);
+    cmark_parser_feed (parser, text, length);
+    cmark_node *document = cmark_parser_finish (parser);
+    cmark_parser_free (parser);
+
+    job->spans = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+
+    // Cmark Iterator loop
+    cmark_event_type ev_type;
+    cmark_iter *iter = cmark_iter_new(document);
+    guint visited = 0;
+
+    while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+        // Give up early if the buffer has already moved on
+        if (++visited % CANCEL_CHECK_INTERVAL == 0 &&
+            g_cancellable_is_cancelled (cancellable))
+            break;
+
+        if (ev_type == CMARK_EVENT_ENTER) {
+            cmark_node *cur = cmark_iter_get_node(iter);
+
+            BlSpanStyle style = get_node_style (cur);
+            if (style == BL_STYLE_NONE)
+                continue;
+
+            // Get cmark positioning
+            int start_line = cmark_node_get_start_line (cur);
+            int start_col = cmark_node_get_start_column (cur);
+            int end_line = cmark_node_get_end_line (cur);
+            int end_col = cmark_node_get_end_column (cur);
+
+            BL_TRACE ("highlight-node",
+                      BL_TRACE_STR ("BL_NODE_TYPE", cmark_node_get_type_string (cur)),
+                      BL_TRACE_INT ("BL_START_LINE", start_line),
+                      BL_TRACE_INT ("BL_START_COLUMN", start_col),
+                      BL_TRACE_INT ("BL_END_LINE", end_line),
+                      BL_TRACE_INT ("BL_END_COLUMN", end_col));
+
+            // Hacky code to work around cmark's strangeness
+            // TODO: Migrate to a different library in the future
+            // Or submit a patch to cmark?
+
+            start_col = start_col == 0 ? 0 : start_col - 1;
+            end_col = end_col == 0 ? 0 : end_col;
+            start_line = start_line == 0 ? 0 : start_line - 1;
+            end_line = end_line == 0 ? 0 : end_line - 1;
+
+            BlSpan span;
+            span.start = job->start_offset +
+                get_offset_for_sourcepos (text, length, lines, start_line, start_col);
+            span.end = job->start_offset +
+                get_offset_for_sourcepos (text, length, lines, end_line, end_col);
+            span.style = style;
+            g_array_append_val (job->spans, span);
+
+            job->max_span = MAX (job->max_span, span.end - span.start);
+        }
+    }
+
+    cmark_iter_free (iter);
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_private_set (&current_arena, NULL);
+        return;
+    }
+
+    // Record the top-level blocks so the next edit can be widened
+    // to them without re-parsing the whole document
+    job->blocks = g_array_new (FALSE, FALSE, sizeof (BlBlock));
+
+    for (cmark_node *child = cmark_node_first_child (document);
+         child != NULL;
+         child = cmark_node_next (child))
+    {
+        BlBlock block;
+        block.start_line = cmark_node_get_start_line (child) - 1 + job->start_line;
+        block.end_line = cmark_node_get_end_line (child) - 1 + job->start_line;
+        block.type = cmark_node_get_type (child);
+        g_array_append_val (job->blocks, block);
+    }
+
+    // The document tree lives in the arena, so there is nothing to free
+    g_private_set (&current_arena, NULL);
+    bl_arena_get_stats (job->arena, &job->arena_stats);
+    job->parse_time = g_get_monotonic_time () - parse_start;
+
+    BL_TRACE ("highlight-arena",
+              BL_TRACE_INT ("BL_BYTES", job->arena_stats.bytes),
+              BL_TRACE_INT ("BL_ALLOCATIONS", job->arena_stats.allocations),
+              BL_TRACE_INT ("BL_SYSTEM_ALLOCATIONS", job->arena_stats.system_allocations));
+
+    g_task_return_boolean (task, TRUE);
+}
+
+// Maps an offset in the parsed snapshot onto the current buffer by
+// replaying the edits made since the apply phase began
+static gint
+translate_offset (BlHighlighter  *self,
+                  gint            offset)
+{
+    for (guint i = 0; i < self->apply_edits->len; i++)
+    {
+        BlEdit *edit = &g_array_index (self->apply_edits, BlEdit, i);
+
+        if (edit->delta > 0)
+        {
+            if (offset >= edit->offset)
+                offset += edit->delta;
+        }
+        else if (offset >= edit->offset - edit->delta)
+        {
+            offset += edit->delta;
+        }
+        else if (offset > edit->offset)
+        {
+            // Inside the deleted text
+            offset = edit->offset;
+        }
+    }
+
+    return offset;
+}
+
+// Index of the first span starting at or after `offset`
+static guint
+find_first_span (GArray *spans,
+                 gint    offset)
+{
+    guint low = 0;
+    guint high = spans->len;
+
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (g_array_index (spans, BlSpan, mid).start < offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+// Merged, sorted ranges covered by `style` in a list of spans
+// that is itself sorted by start offset
+static GArray *
+get_style_coverage (GArray      *spans,
+                    BlSpanStyle  style)
+{
+    GArray *ranges = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+
+    for (guint i = 0; i < spans->len; i++)
+    {
+        BlSpan *span = &g_array_index (spans, BlSpan, i);
+
+        if (span->style != style || span->start >= span->end)
+            continue;
+
+        if (ranges->len > 0)
+        {
+            BlSpan *last = &g_array_index (ranges, BlSpan, ranges->len - 1);
+
+            if (span->start <= last->end)
+            {
+                last->end = MAX (last->end, span->end);
+                continue;
+            }
+        }
+
+        g_array_append_val (ranges, *span);
+    }
+
+    return ranges;
+}
+
+static void
+update_tag_range (BlHighlighter  *self,
+                  GtkTextTag     *tag,
+                  gint            start,
+                  gint            end,
+                  gboolean        apply)
+{
+    GtkTextIter start_iter;
+    GtkTextIter end_iter;
+    gtk_text_buffer_get_iter_at_offset (self->buffer, &start_iter, start);
+    gtk_text_buffer_get_iter_at_offset (self->buffer, &end_iter, end);
+
+    if (apply)
+        gtk_text_buffer_apply_tag (self->buffer, tag, &start_iter, &end_iter);
+    else
+        gtk_text_buffer_remove_tag (self->buffer, tag, &start_iter, &end_iter);
+}
+
+// Applies (or removes) `tag` over every part of `a` not covered by `b`
+static void
+update_tag_difference (BlHighlighter  *self,
+                       GtkTextTag     *tag,
+                       GArray         *a,
+                       GArray         *b,
+                       gboolean        apply)
+{
+    guint j = 0;
+
+    for (guint i = 0; i < a->len; i++)
+    {
+        BlSpan *range = &g_array_index (a, BlSpan, i);
+        gint cur = range->start;
+
+        while (j < b->len && g_array_index (b, BlSpan, j).end <= cur)
+            j++;
+
+        for (guint k = j; k < b->len && cur < range->end; k++)
+        {
+            BlSpan *other = &g_array_index (b, BlSpan, k);
+
+            if (other->start >= range->end)
+                break;
+
+            if (other->start > cur)
+                update_tag_range (self, tag, cur, other->start, apply);
+
+            cur = MAX (cur, other->end);
+        }
+
+        if (cur < range->end)
+            update_tag_range (self, tag, cur, range->end, apply);
+    }
+}
+
+// Re-tags the snapshot range [range_start, range_end). Only the
+// difference from what is already tagged there touches the buffer,
+// so unchanged text keeps its layout.
+static void
+apply_range (BlHighlighter  *self,
+             BlParseJob     *job,
+             gint            range_start,
+             gint            range_end)
+{
+    gint start = translate_offset (self, range_start);
+    gint end = translate_offset (self, range_end);
+
+    // New spans for the range, clipped and moved into buffer offsets.
+    // The parser emits them ordered by start offset, so nothing before
+    // this index can reach into the range.
+    GArray *new_spans = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+
+    for (guint i = find_first_span (job->spans, range_start - job->max_span);
+         i < job->spans->len; i++)
+    {
+        BlSpan *span = &g_array_index (job->spans, BlSpan, i);
+
+        if (span->start >= range_end)
+            break;
+
+        if (span->end <= range_start)
+            continue;
+
+        BlSpan clipped;
+        clipped.start = translate_offset (self, MAX (span->start, range_start));
+        clipped.end = translate_offset (self, MIN (span->end, range_end));
+        clipped.style = span->style;
+
+        if (clipped.start < clipped.end)
+            g_array_append_val (new_spans, clipped);
+    }
+
+    // Old spans for the range, split into the part inside it and
+    // whatever is left over on either side
+    guint first = find_first_span (self->spans, start - self->spans_max);
+    guint last = first;
+
+    GArray *old_spans = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+    GArray *before = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+    GArray *after = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+
+    for (; last < self->spans->len; last++)
+    {
+        BlSpan span = g_array_index (self->spans, BlSpan, last);
+
+        if (span.start >= end)
+            break;
+
+        if (span.end <= start)
+        {
+            g_array_append_val (before, span);
+            continue;
+        }
+
+        BlSpan inside = { MAX (span.start, start), MIN (span.end, end), span.style };
+        g_array_append_val (old_spans, inside);
+
+        if (span.start < start)
+        {
+            BlSpan head = { span.start, start, span.style };
+            g_array_append_val (before, head);
+        }
+
+        if (span.end > end)
+        {
+            BlSpan tail = { end, span.end, span.style };
+            g_array_append_val (after, tail);
+        }
+    }
+
+    if (!self->spans_known)
+    {
+        // Nothing is known about what is tagged here yet, so clear it
+        for (gint style = 0; style < BL_STYLE_NONE; style++)
+            update_tag_range (self, self->style_tags[style], start, end, FALSE);
+
+        g_array_set_size (old_spans, 0);
+    }
+
+    for (gint style = 0; style < BL_STYLE_NONE; style++)
+    {
+        GArray *old_coverage = get_style_coverage (old_spans, style);
+        GArray *new_coverage = get_style_coverage (new_spans, style);
+
+        update_tag_difference (self, self->style_tags[style], old_coverage, new_coverage, FALSE);
+        update_tag_difference (self, self->style_tags[style], new_coverage, old_coverage, TRUE);
+
+        g_array_free (old_coverage, TRUE);
+        g_array_free (new_coverage, TRUE);
+    }
+
+    // Swap the new spans into the model in order
+    g_array_remove_range (self->spans, first, last - first);
+    g_array_insert_vals (self->spans, first, after->data, after->len);
+    g_array_insert_vals (self->spans, first, new_spans->data, new_spans->len);
+    g_array_insert_vals (self->spans, first, before->data, before->len);
+
+    for (guint i = 0; i < new_spans->len; i++)
+    {
+        BlSpan *span = &g_array_index (new_spans, BlSpan, i);
+        self->spans_max = MAX (self->spans_max, span->end - span->start);
+    }
+
+    g_array_free (new_spans, TRUE);
+    g_array_free (old_spans, TRUE);
+    g_array_free (before, TRUE);
+    g_array_free (after, TRUE);
+}
+
+// Characters tagged between budget checks
+#define APPLY_CHUNK_SIZE 4096
+
+// Tags the parts of the snapshot range [start, end) that have not
+// been applied yet and takes them off the to-do list
+static void
+apply_todo_range (BlHighlighter *self,
+                  BlParseJob    *job,
+                  gint           start,
+                  gint           end)
+{
+    gint64 apply_start = g_get_monotonic_time ();
+    GArray *todo = g_array_new (FALSE, FALSE, sizeof (BlRange));
+
+    for (guint i = 0; i < self->apply_todo->len; i++)
+    {
+        BlRange range = g_array_index (self->apply_todo, BlRange, i);
+
+        if (range.end <= start || range.start >= end)
+        {
+            g_array_append_val (todo, range);
+            continue;
+        }
+
+        gint clip_start = MAX (range.start, start);
+        gint clip_end = MIN (range.end, end);
+        apply_range (self, job, clip_start, clip_end);
+
+        // Keep whatever is left on either side
+        if (range.start < clip_start)
+        {
+            BlRange head = { range.start, clip_start };
+            g_array_append_val (todo, head);
+        }
+
+        if (range.end > clip_end)
+        {
+            BlRange tail = { clip_end, range.end };
+            g_array_append_val (todo, tail);
+        }
+    }
+
+    g_array_free (self->apply_todo, TRUE);
+    self->apply_todo = todo;
+    self->apply_cursor = end;
+
+    self->apply_time += g_get_monotonic_time () - apply_start;
+}
+
+// Applies the rest of the current job in chunks, carrying on from
+// the last range applied (usually the bottom of a viewport) and then
+// wrapping round to the top. Returns TRUE once finished.
+static gboolean
+apply_remaining (BlHighlighter *self)
+{
+    BlParseJob *job = g_task_get_task_data (self->applying);
+    gint64 deadline = g_get_monotonic_time () + (gint64)(self->budget * 1000);
+
+    while (self->apply_todo->len > 0)
+    {
+        guint i = 0;
+
+        while (i < self->apply_todo->len &&
+               g_array_index (self->apply_todo, BlRange, i).end <= self->apply_cursor)
+            i++;
+
+        if (i == self->apply_todo->len)
+            i = 0;
+
+        BlRange range = g_array_index (self->apply_todo, BlRange, i);
+        apply_todo_range (self, job, range.start,
+                          MIN (range.start + APPLY_CHUNK_SIZE, range.end));
+
+        if (g_get_monotonic_time () >= deadline)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void start_pass (BlHighlighter *self);
+
+static void
+finish_pass (BlHighlighter *self)
+{
+    self->running = FALSE;
+
+    // If a burst is still being collected, the scheduler will
+    // start the next pass once it settles
+    if (self->pending_changes == 0)
+        start_pass (self);
+}
+
+static void
+end_apply (BlHighlighter *self)
+{
+    if (self->apply_id != 0)
+    {
+        g_source_remove (self->apply_id);
+        self->apply_id = 0;
+    }
+
+    g_clear_object (&self->applying);
+    g_array_set_size (self->apply_edits, 0);
+    g_array_set_size (self->apply_todo, 0);
+}
+
+static void
+complete_apply (BlHighlighter *self)
+{
+    BlParseJob *job = g_task_get_task_data (self->applying);
+
+    // A full pass leaves the span model describing every style tag
+    // in the buffer, so later passes can diff against it
+    if (!job->incremental)
+        self->spans_known = TRUE;
+
+    self->stats.last_parse_time = job->parse_time;
+    self->stats.last_apply_time = self->apply_time;
+    self->stats.last_spans = job->spans->len;
+
+    end_apply (self);
+    finish_pass (self);
+}
+
+static gboolean
+cb_apply_idle (BlHighlighter *self)
+{
+    if (!apply_remaining (self))
+        return G_SOURCE_CONTINUE;
+
+    self->apply_id = 0;
+    complete_apply (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+begin_apply (BlHighlighter  *self,
+             GTask          *task)
+{
+    BlParseJob *job = g_task_get_task_data (task);
+
+    if (!job->incremental)
+    {
+        // Move the blocks past any lines added or removed while the
+        // parser was running. Their offsets are caught up by the edits
+        // already recorded for the apply phase.
+        for (guint i = 0; i < self->inflight_lines->len; i++)
+        {
+            BlLineEdit *edit = &g_array_index (self->inflight_lines, BlLineEdit, i);
+
+            for (guint j = 0; j < job->blocks->len; j++)
+            {
+                BlBlock *block = &g_array_index (job->blocks, BlBlock, j);
+
+                if (edit->added > 0)
+                    shift_range (&block->start_line, &block->end_line, edit->first, edit->added);
+                else
+                    collapse_range (&block->start_line, &block->end_line, edit->first, edit->last);
+            }
+        }
+
+        g_array_set_size (self->inflight_lines, 0);
+        g_array_set_size (self->blocks, 0);
+    }
+
+    replace_blocks (self, job->start_line, job->end_line, job->blocks);
+
+    self->applying = g_object_ref (task);
+    self->apply_time = 0;
+
+    BlRange all = { job->start_offset, job->end_offset };
+    g_array_append_val (self->apply_todo, all);
+    self->apply_cursor = job->start_offset;
+
+    // Attached views tag whatever they have on screen first, through
+    // `bl_highlighter_apply_range`
+    g_signal_emit (self, signals[PARSED], 0);
+
+    // Small regions are finished in one go. Anything else continues
+    // from an idle so the viewport can be drawn in between.
+    if (job->end_offset - job->start_offset <= APPLY_CHUNK_SIZE && apply_remaining (self))
+    {
+        complete_apply (self);
+        return;
+    }
+
+    self->apply_id = g_idle_add ((GSourceFunc) cb_apply_idle, self);
+}
+
+static void
+parse_done (BlHighlighter  *self,
+            GAsyncResult   *result,
+            gpointer        null_ptr)
+{
+    GTask *task = G_TASK (result);
+    BlParseJob *job = g_task_get_task_data (task);
+    GError *error = NULL;
+    gboolean parsed = g_task_propagate_boolean (task, &error);
+
+    g_clear_object (&self->cancellable);
+    self->inflight_full = FALSE;
+
+    // The document was disposed while the parser was running
+    if (self->buffer == NULL)
+    {
+        self->running = FALSE;
+        g_clear_error (&error);
+        return;
+    }
+
+    if (error == NULL)
+    {
+        self->stats.parse_bytes = job->arena_stats.bytes;
+        self->stats.parse_allocations = job->arena_stats.allocations;
+        self->stats.parse_system_allocations = job->arena_stats.system_allocations;
+    }
+
+    // A full parse is never cancelled by edits, since under constant
+    // typing it would never finish. Its result is still applied, and the
+    // edits made meanwhile are dirty for the next pass.
+    if (error == NULL && (job->generation == self->generation || !job->incremental))
+    {
+        if (parsed)
+        {
+            // Stays running until every chunk has been applied
+            begin_apply (self, task);
+            return;
+        }
+
+        self->needs_full = TRUE;
+    }
+    else
+    {
+        // The result is stale. Whatever it covered still needs
+        // highlighting against the current contents.
+        BL_TRACE ("highlight-dropped",
+                  BL_TRACE_INT ("BL_GENERATION", job->generation));
+
+        if (job->incremental)
+            mark_dirty (self, self->inflight_start, self->inflight_end);
+        else
+            self->needs_full = TRUE;
+    }
+
+    g_array_set_size (self->apply_edits, 0);
+    g_array_set_size (self->inflight_lines, 0);
+
+    g_clear_error (&error);
+    finish_pass (self);
+}
+
+static void
+start_pass (BlHighlighter *self)
+{
+    GtkTextBuffer *buffer = self->buffer;
+
+    // Only one parse runs at a time. Anything that changes meanwhile
+    // is picked up when it finishes.
+    if (self->running || self->deferred || self->disabled || buffer == NULL)
+        return;
+
+    if (!self->dirty && !self->needs_full)
+        return;
+
+    gint start_line;
+    gint end_line;
+    gboolean incremental = get_dirty_region (self, buffer, &start_line, &end_line);
+
+    if (!incremental)
+    {
+        // Edits that change the block structure (and the initial
+        // highlight) fall back to parsing the whole document
+        start_line = 0;
+        end_line = gtk_text_buffer_get_line_count (buffer) - 1;
+    }
+
+    GtkTextIter start;
+    GtkTextIter end;
+    get_region_iters (buffer, start_line, end_line, &start, &end);
+
+    BlParseJob *job = g_new0 (BlParseJob, 1);
+    job->text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+    job->start_line = start_line;
+    job->end_line = end_line;
+    job->start_offset = gtk_text_iter_get_offset (&start);
+    job->end_offset = gtk_text_iter_get_offset (&end);
+    job->generation = self->generation;
+    job->incremental = incremental;
+    job->arena = self->arena;
+
+    BL_TRACE ("highlight-start",
+              BL_TRACE_INT ("BL_START_LINE", start_line),
+              BL_TRACE_INT ("BL_END_LINE", end_line),
+              BL_TRACE_INT ("BL_INCREMENTAL", incremental),
+              BL_TRACE_INT ("BL_GENERATION", self->generation));
+
+    if (BL_IS_DOCUMENT (buffer))
+    {
+        job->lines = g_array_new (FALSE, FALSE, sizeof (BlLineStart));
+        bl_line_index_copy_range (bl_document_get_line_index (BL_DOCUMENT (buffer)),
+                                  start_line, end_line, job->lines);
+    }
+
+    self->dirty = FALSE;
+    self->needs_full = FALSE;
+    self->inflight_start = start_line;
+    self->inflight_end = end_line;
+    self->inflight_full = !incremental;
+    self->running = TRUE;
+    self->cancellable = g_cancellable_new ();
+
+    GTask *task = g_task_new (self, self->cancellable,
+                              (GAsyncReadyCallback) parse_done, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) parse_job_free);
+    g_task_run_in_thread (task, (GTaskThreadFunc) parse_thread);
+    g_object_unref (task);
+}
+
+static void schedule_timeout (BlHighlighter *self);
+
+static void
+run_scheduled_pass (BlHighlighter *self)
+{
+    guint absorbed = self->pending_changes;
+    self->pending_changes = 0;
+
+    self->stats.passes++;
+    self->stats.changes += absorbed;
+    self->stats.last_absorbed = absorbed;
+    self->stats.max_absorbed = MAX (self->stats.max_absorbed, absorbed);
+
+    BL_TRACE ("highlight-scheduled",
+              BL_TRACE_INT ("BL_PASS", self->stats.passes),
+              BL_TRACE_INT ("BL_ABSORBED", absorbed),
+              BL_TRACE_INT ("BL_MAX_ABSORBED", self->stats.max_absorbed));
+
+    start_pass (self);
+}
+
+// A burst is flushed once typing pauses for the debounce period, or
+// once it has been going for longer than the latency ceiling
+static gboolean
+burst_is_due (BlHighlighter  *self,
+              gint64          now)
+{
+    return (now - self->last_change) >= (gint64)self->debounce * 1000 ||
+           (now - self->burst_start) >= (gint64)self->max_latency * 1000;
+}
+
+static gboolean
+cb_highlight_tick (GtkWidget      *widget,
+                   GdkFrameClock  *frame_clock,
+                   BlHighlighter  *self)
+{
+    if (!burst_is_due (self, gdk_frame_clock_get_frame_time (frame_clock)))
+        return G_SOURCE_CONTINUE;
+
+    self->tick_id = 0;
+    run_scheduled_pass (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+cb_highlight_timeout (BlHighlighter *self)
+{
+    self->timeout_id = 0;
+
+    if (burst_is_due (self, g_get_monotonic_time ()))
+        run_scheduled_pass (self);
+    else
+        schedule_timeout (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_timeout (BlHighlighter *self)
+{
+    // Wake up when whichever of the two limits comes first expires
+    gint64 now = g_get_monotonic_time ();
+    gint64 until_debounce = (gint64)self->debounce * 1000 - (now - self->last_change);
+    gint64 until_ceiling = (gint64)self->max_latency * 1000 - (now - self->burst_start);
+    gint64 wait = MAX (MIN (until_debounce, until_ceiling), 1000);
+
+    self->timeout_id = g_timeout_add ((guint)(wait / 1000),
+                                      (GSourceFunc) cb_highlight_timeout,
+                                      self);
+}
+
+static void
+schedule_pass (BlHighlighter *self)
+{
+    if (self->tick_id != 0 || self->timeout_id != 0)
+        return;
+
+    // Follow the frame clock of a view that is on screen so a pass
+    // never lands in the middle of a frame. Without one, use a timer.
+    for (GList *elem = self->views; elem != NULL; elem = elem->next)
+    {
+        if (gtk_widget_get_realized (elem->data))
+        {
+            self->tick_widget = elem->data;
+            self->tick_id = gtk_widget_add_tick_callback (self->tick_widget,
+                                                          (GtkTickCallback) cb_highlight_tick,
+                                                          self, NULL);
+            return;
+        }
+    }
+
+    schedule_timeout (self);
+}
+
+static void
+cancel_scheduled_pass (BlHighlighter *self)
+{
+    if (self->tick_id != 0)
+    {
+        gtk_widget_remove_tick_callback (self->tick_widget, self->tick_id);
+        self->tick_id = 0;
+        self->tick_widget = NULL;
+    }
+
+    if (self->timeout_id != 0)
+    {
+        g_source_remove (self->timeout_id);
+        self->timeout_id = 0;
+    }
+}
+
+static void
+release_clock (BlHighlighter *self,
+               GtkWidget     *widget)
+{
+    // The frame clock is going away. Move any pending burst onto a
+    // timer; the next burst will pick up another view's clock.
+    if (self->tick_id != 0 && self->tick_widget == widget)
+    {
+        gtk_widget_remove_tick_callback (self->tick_widget, self->tick_id);
+        self->tick_id = 0;
+        self->tick_widget = NULL;
+        schedule_timeout (self);
+    }
+}
+
+static void
+cb_view_unrealize (GtkWidget     *widget,
+                   BlHighlighter *self)
+{
+    release_clock (self, widget);
+}
+
+static void
+highlight_buffer (GtkTextBuffer *buffer, BlHighlighter *self)
+{
+    // Sanity checks
+    g_assert(BL_IS_HIGHLIGHTER (self));
+
+    // Any result computed before this change is now stale
+    self->generation++;
+
+    if (self->cancellable != NULL && !self->inflight_full)
+        g_cancellable_cancel (self->cancellable);
+
+    // The owner will ask for a pass once it is done with the buffer
+    if (self->deferred || self->disabled)
+        return;
+
+    // Collapse bursts of changes (typing, pasting, undo) into one pass
+    gint64 now = g_get_monotonic_time ();
+
+    if (self->pending_changes == 0)
+        self->burst_start = now;
+
+    self->pending_changes++;
+    self->last_change = now;
+
+    schedule_pass (self);
+}
+
+void
+bl_highlighter_set_delay (BlHighlighter *self,
+                          guint          debounce,
+                          guint          max_latency)
+{
+    self->debounce = debounce;
+    self->max_latency = MAX (max_latency, debounce);
+}
+
+void
+bl_highlighter_set_budget (BlHighlighter *self,
+                           gdouble        budget)
+{
+    // Always make some progress, however small the budget
+    self->budget = MAX (budget, 0.1);
+}
+
+const BlHighlightStats *
+bl_highlighter_get_stats (BlHighlighter *self)
+{
+    return &self->stats;
+}
+
+void
+bl_highlighter_set_deferred (BlHighlighter *self,
+                             gboolean       deferred)
+{
+    if (self->deferred == deferred)
+        return;
+
+    self->deferred = deferred;
+
+    if (deferred)
+    {
+        cancel_scheduled_pass (self);
+        self->pending_changes = 0;
+        return;
+    }
+
+    // Whatever happened in the meantime is treated as a new document
+    self->needs_full = TRUE;
+    start_pass (self);
+}
+
+// Turns highlighting off, for documents too large to parse or tag in
+// reasonable time, and strips whatever styling was already applied.
+// Turning it back on highlights the whole document from scratch.
+void
+bl_highlighter_set_enabled (BlHighlighter *self,
+                            gboolean       enabled)
+{
+    if (self->disabled == !enabled)
+        return;
+
+    self->disabled = !enabled;
+    self->needs_full = TRUE;
+
+    if (enabled)
+    {
+        start_pass (self);
+        return;
+    }
+
+    // Drop any parse in flight and stop tagging part way through
+    self->generation++;
+
+    if (self->cancellable != NULL)
+        g_cancellable_cancel (self->cancellable);
+
+    cancel_scheduled_pass (self);
+    self->pending_changes = 0;
+
+    if (self->applying != NULL)
+    {
+        end_apply (self);
+        self->running = FALSE;
+    }
+
+    if (self->buffer != NULL)
+    {
+        GtkTextIter start;
+        GtkTextIter end;
+        gtk_text_buffer_get_bounds (self->buffer, &start, &end);
+
+        for (gint i = 0; i < BL_STYLE_NONE; i++)
+            gtk_text_buffer_remove_tag (self->buffer, self->style_tags[i], &start, &end);
+    }
+
+    g_array_set_size (self->blocks, 0);
+    g_array_set_size (self->spans, 0);
+    self->spans_max = 0;
+    self->spans_known = TRUE;
+    self->dirty = FALSE;
+}
+
+gboolean
+bl_highlighter_is_enabled (BlHighlighter *self)
+{
+    return !self->disabled;
+}
+
+gboolean
+bl_highlighter_is_busy (BlHighlighter *self)
+{
+    // Edits are still tracked while disabled, but nothing comes of them
+    if (self->disabled)
+        return self->running;
+
+    return self->running || self->dirty || self->needs_full ||
+           self->tick_id != 0 || self->timeout_id != 0;
+}
+
+
+void
+bl_highlighter_apply_range (BlHighlighter *self,
+                            GtkTextIter   *start,
+                            GtkTextIter   *end)
+{
+    // Buffer offsets only line up with the parse result until the
+    // buffer is next edited, so this is for "parsed" handlers only
+    if (self->applying == NULL || self->apply_edits->len > 0)
+        return;
+
+    BlParseJob *job = g_task_get_task_data (self->applying);
+
+    apply_todo_range (self, job,
+                      gtk_text_iter_get_offset (start),
+                      gtk_text_iter_get_offset (end));
+}
+
+void
+bl_highlighter_attach_view (BlHighlighter *self,
+                            GtkTextView   *view)
+{
+    g_return_if_fail (BL_IS_HIGHLIGHTER (self));
+    g_return_if_fail (gtk_text_view_get_buffer (view) == self->buffer);
+
+    if (g_list_find (self->views, view) != NULL)
+        return;
+
+    self->views = g_list_append (self->views, view);
+
+    g_signal_connect (view, "unrealize",
+                      G_CALLBACK (cb_view_unrealize), self);
+}
+
+void
+bl_highlighter_detach_view (BlHighlighter *self,
+                            GtkTextView   *view)
+{
+    g_return_if_fail (BL_IS_HIGHLIGHTER (self));
+
+    if (g_list_find (self->views, view) == NULL)
+        return;
+
+    release_clock (self, GTK_WIDGET (view));
+    g_signal_handlers_disconnect_by_func (view, cb_view_unrealize, self);
+
+    self->views = g_list_remove (self->views, view);
+}
+
+BlHighlighter *
+bl_highlighter_new (GtkTextBuffer *buffer)
+{
+    g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+    BlHighlighter *self = g_object_new (BL_TYPE_HIGHLIGHTER, NULL);
+    GtkTextTagTable *tag_table = gtk_text_buffer_get_tag_table (buffer);
+
+    // The tags themselves are created by the owner of the buffer
+    self->buffer = buffer;
+    self->user_style_tag = gtk_text_tag_table_lookup (tag_table, "user-style");
+    g_assert (self->user_style_tag != NULL);
+
+    for (gint i = 0; i < BL_STYLE_NONE; i++)
+    {
+        self->style_tags[i] = gtk_text_tag_table_lookup (tag_table, style_tag_names[i]);
+        g_assert (self->style_tags[i] != NULL);
+    }
+
+    // Track edited lines so only the affected blocks are re-parsed
+    g_signal_connect(G_OBJECT(buffer), "insert-text",
+                     G_CALLBACK(cb_insert_text), self);
+    g_signal_connect(G_OBJECT(buffer), "delete-range",
+                     G_CALLBACK(cb_delete_range), self);
+
+    // Style new text immediately while the parser catches up
+    g_signal_connect_after(G_OBJECT(buffer), "insert-text",
+                           G_CALLBACK(cb_insert_text_after), self);
+
+    // Re-highlight on changed event
+    g_signal_connect(G_OBJECT(buffer), "changed",
+                     G_CALLBACK(highlight_buffer), self);
+
+    // Highlight whatever is already there straight away
+    GtkTextIter start;
+    GtkTextIter end;
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+    gtk_text_buffer_apply_tag (buffer, self->user_style_tag, &start, &end);
+
+    self->needs_full = TRUE;
+    start_pass (self);
+
+    return self;
+}
+
+static void
+bl_highlighter_dispose (GObject *object)
+{
+    BlHighlighter *self = BL_HIGHLIGHTER (object);
+
+    while (self->views != NULL)
+        bl_highlighter_detach_view (self, self->views->data);
+
+    if (self->buffer != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->buffer, self);
+        self->buffer = NULL;
+    }
+
+    if (self->cancellable != NULL)
+        g_cancellable_cancel (self->cancellable);
+
+    cancel_scheduled_pass (self);
+    end_apply (self);
+
+    G_OBJECT_CLASS (bl_highlighter_parent_class)->dispose (object);
+}
+
+static void
+bl_highlighter_finalize (GObject *object)
+{
+    BlHighlighter *self = BL_HIGHLIGHTER (object);
+
+    g_array_free (self->blocks, TRUE);
+    g_array_free (self->apply_edits, TRUE);
+    g_array_free (self->inflight_lines, TRUE);
+    g_array_free (self->apply_todo, TRUE);
+    g_array_free (self->spans, TRUE);
+    bl_arena_free (self->arena);
+
+    G_OBJECT_CLASS (bl_highlighter_parent_class)->finalize (object);
+}
+
+static void
+bl_highlighter_class_init (BlHighlighterClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = bl_highlighter_dispose;
+    object_class->finalize = bl_highlighter_finalize;
+
+    signals[PARSED] =
+        g_signal_newv ("parsed",
+                 G_TYPE_FROM_CLASS (object_class),
+                 G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                 NULL /* closure */,
+                 NULL /* accumulator */,
+                 NULL /* accumulator data */,
+                 NULL /* C marshaller */,
+                 G_TYPE_NONE /* return_type */,
+                 0     /* n_params */,
+                 NULL  /* param_types */);
+}
+
+static void
+bl_highlighter_init (BlHighlighter *self)
+{
+    self->blocks = g_array_new (FALSE, FALSE, sizeof (BlBlock));
+    self->apply_edits = g_array_new (FALSE, FALSE, sizeof (BlEdit));
+    self->inflight_lines = g_array_new (FALSE, FALSE, sizeof (BlLineEdit));
+    self->apply_todo = g_array_new (FALSE, FALSE, sizeof (BlRange));
+    self->spans = g_array_new (FALSE, FALSE, sizeof (BlSpan));
+    self->arena = bl_arena_new (ARENA_CHUNK_SIZE);
+
+    self->debounce = BL_HIGHLIGHTER_DEFAULT_DEBOUNCE;
+    self->max_latency = BL_HIGHLIGHTER_DEFAULT_MAX_LATENCY;
+    self->budget = BL_HIGHLIGHTER_DEFAULT_BUDGET;
+}
@@ -0,0 +1,98 @@
+/* bl-highlighter.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define BL_TYPE_HIGHLIGHTER (bl_highlighter_get_type())
+G_DECLARE_FINAL_TYPE (BlHighlighter, bl_highlighter, BL, HIGHLIGHTER, GObject)
+
+// Default scheduler timings in milliseconds. The editor overrides
+// these from GSettings.
+#define BL_HIGHLIGHTER_DEFAULT_DEBOUNCE 40
+#define BL_HIGHLIGHTER_DEFAULT_MAX_LATENCY 150
+#define BL_HIGHLIGHTER_DEFAULT_BUDGET 4.0
+
+// Counters for the highlight scheduler. `last_absorbed` and
+// `max_absorbed` are the number of buffer changes folded into
+// the most recent pass and the largest pass so far. The `parse_`
+// counters describe the parser's memory use in the most recent
+// pass; `parse_system_allocations` stays at zero in steady state.
+// The `last_` timings are in microseconds: the parse on the worker
+// thread and the tagging on the main thread, for the most recent
+// pass that was applied, along with the number of spans it tagged.
+typedef struct
+{
+    guint passes;
+    guint changes;
+    guint last_absorbed;
+    guint max_absorbed;
+    gsize parse_bytes;
+    guint parse_allocations;
+    guint parse_system_allocations;
+    gint64 last_parse_time;
+    gint64 last_apply_time;
+    guint last_spans;
+} BlHighlightStats;
+
+// Parses and tags a buffer on behalf of every view showing it. The
+// buffer must already contain the tags named in `bl-highlighter.c`.
+BlHighlighter *           bl_highlighter_new          (GtkTextBuffer *buffer);
+
+// Views that are attached lend their frame clock to the scheduler
+// and are given the chance to tag their viewport first whenever a
+// result arrives (see the "parsed" signal)
+void                      bl_highlighter_attach_view  (BlHighlighter *self,
+                                                       GtkTextView   *view);
+void                      bl_highlighter_detach_view  (BlHighlighter *self,
+                                                       GtkTextView   *view);
+
+// Tags the given range ahead of the rest. Only valid while handling
+// the "parsed" signal.
+void                      bl_highlighter_apply_range  (BlHighlighter *self,
+                                                       GtkTextIter   *start,
+                                                       GtkTextIter   *end);
+
+void                      bl_highlighter_set_delay    (BlHighlighter *self,
+                                                       guint          debounce,
+                                                       guint          max_latency);
+void                      bl_highlighter_set_budget   (BlHighlighter *self,
+                                                       gdouble        budget);
+const BlHighlightStats *  bl_highlighter_get_stats    (BlHighlighter *self);
+
+// While deferred, edits are tracked but nothing is parsed. Used to
+// keep the highlighter out of the way while a file is streamed in;
+// a full pass runs as soon as it is resumed.
+void                      bl_highlighter_set_deferred (BlHighlighter *self,
+                                                       gboolean       deferred);
+
+// Disabled highlighters strip their tags and ignore edits until they
+// are enabled again, which highlights the whole document afresh
+void                      bl_highlighter_set_enabled  (BlHighlighter *self,
+                                                       gboolean       enabled);
+gboolean                  bl_highlighter_is_enabled   (BlHighlighter *self);
+
+// Whether a pass is waiting, parsing or still being applied
+gboolean                  bl_highlighter_is_busy      (BlHighlighter *self);
+
+G_END_DECLS
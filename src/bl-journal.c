@@ -0,0 +1,661 @@
+/* bl-journal.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#define JOURNAL_MAGIC "BLUEDIT-JOURNAL 1\n"
+#define JOURNAL_SUFFIX ".journal"
+
+// Longest a record may wait in memory before it is on disk
+#define FLUSH_INTERVAL 1000
+
+typedef struct
+{
+    guint64 sequence;
+    gsize offset;
+} JournalMark;
+
+struct _BlJournal
+{
+    gint ref_count;
+
+    // The file is only written by the worker, with `lock` held
+    GMutex lock;
+    gchar *path;
+    gboolean discarded;
+
+    // Everything since the base, header first. Marks give the start
+    // of each record, so a rebase can cut the log at a sequence.
+    GString *log;
+    GArray *marks;
+    gsize written;
+    gboolean rewrite;
+    gboolean on_disk;
+    guint epoch;
+
+    // Writing
+    gboolean flushing;
+    guint flush_id;
+};
+
+struct _BlJournalRecovery
+{
+    gchar *path;
+    gchar *uri;
+    gint base_chars;
+    guint base_hash;
+
+    gchar *contents;
+    gsize length;
+    gsize records_start;
+};
+
+typedef struct
+{
+    BlJournal *journal;
+    GBytes *data;
+    gboolean rewrite;
+    gboolean remove;
+    guint epoch;
+} FlushJob;
+
+static gchar *
+get_journal_dir (void)
+{
+    // GLib only learnt about XDG_STATE_HOME in 2.72
+    const gchar *state = g_getenv ("XDG_STATE_HOME");
+
+    if (state != NULL && g_path_is_absolute (state))
+        return g_build_filename (state, "bluedit", "journal", NULL);
+
+    return g_build_filename (g_get_home_dir (), ".local", "state", "bluedit", "journal", NULL);
+}
+
+static void
+write_header (GString     *log,
+              const gchar *uri,
+              gint         base_chars,
+              guint        base_hash)
+{
+    g_string_append (log, JOURNAL_MAGIC);
+    g_string_append_printf (log, "uri %s\n", uri != NULL ? uri : "");
+    g_string_append_printf (log, "base %d %u\n", base_chars, base_hash);
+}
+
+static BlJournal *
+bl_journal_ref (BlJournal *self)
+{
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+static void
+bl_journal_unref (BlJournal *self)
+{
+    if (!g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    g_mutex_clear (&self->lock);
+    g_string_free (self->log, TRUE);
+    g_array_free (self->marks, TRUE);
+    g_free (self->path);
+    g_free (self);
+}
+
+BlJournal *
+bl_journal_new (const gchar *uri,
+                gint         base_chars,
+                guint        base_hash)
+{
+    BlJournal *self = g_new0 (BlJournal, 1);
+    self->ref_count = 1;
+    g_mutex_init (&self->lock);
+
+    gchar *dir = get_journal_dir ();
+    gchar *uuid = g_uuid_string_random ();
+    gchar *name = g_strconcat (uuid, JOURNAL_SUFFIX, NULL);
+    self->path = g_build_filename (dir, name, NULL);
+    g_free (name);
+    g_free (uuid);
+    g_free (dir);
+
+    self->log = g_string_new (NULL);
+    self->marks = g_array_new (FALSE, FALSE, sizeof (JournalMark));
+    write_header (self->log, uri, base_chars, base_hash);
+    self->rewrite = TRUE;
+
+    return self;
+}
+
+static gboolean
+set_error_from_errno (GError      **error,
+                      const gchar  *path)
+{
+    int saved_errno = errno;
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "%s: %s", path, g_strerror (saved_errno));
+    return FALSE;
+}
+
+// Appends to the journal, or replaces it through a temporary file so
+// a crash part way through leaves the old one intact. Either way the
+// data is synced before this returns.
+static gboolean
+write_synced (const gchar  *path,
+              GBytes       *data,
+              gboolean      append,
+              GError      **error)
+{
+    gchar *dir = g_path_get_dirname (path);
+    g_mkdir_with_parents (dir, 0700);
+    g_free (dir);
+
+    gchar *target = append ? g_strdup (path) : g_strconcat (path, ".tmp", NULL);
+    gint fd = g_open (target, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0600);
+
+    if (fd < 0)
+    {
+        set_error_from_errno (error, target);
+        g_free (target);
+        return FALSE;
+    }
+
+    gsize length;
+    const gchar *bytes = g_bytes_get_data (data, &length);
+    gboolean ok = TRUE;
+
+    while (length > 0 && ok)
+    {
+        gssize count = write (fd, bytes, length);
+
+        if (count < 0 && errno == EINTR)
+            continue;
+
+        if (count < 0)
+        {
+            ok = set_error_from_errno (error, target);
+            break;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    if (ok && fsync (fd) != 0)
+        ok = set_error_from_errno (error, target);
+
+    close (fd);
+
+    if (ok && !append && g_rename (target, path) != 0)
+        ok = set_error_from_errno (error, path);
+
+    g_free (target);
+    return ok;
+}
+
+static void
+flush_job_free (FlushJob *job)
+{
+    bl_journal_unref (job->journal);
+    g_clear_pointer (&job->data, g_bytes_unref);
+    g_free (job);
+}
+
+static void
+flush_thread (GTask        *task,
+              gpointer      source_object,
+              FlushJob     *job,
+              GCancellable *cancellable)
+{
+    BlJournal *self = job->journal;
+    GError *error = NULL;
+    gboolean ok = TRUE;
+
+    g_mutex_lock (&self->lock);
+
+    if (self->discarded)
+        ok = TRUE;
+    else if (job->remove)
+        g_unlink (self->path);
+    else
+        ok = write_synced (self->path, job->data, !job->rewrite, &error);
+
+    g_mutex_unlock (&self->lock);
+
+    if (ok)
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+}
+
+static void schedule_flush (BlJournal *self);
+
+static gboolean
+needs_flush (BlJournal *self)
+{
+    // A journal without edits is no use to anyone, so it is removed
+    if (self->marks->len == 0)
+        return self->on_disk;
+
+    return self->rewrite || self->written < self->log->len;
+}
+
+static void
+flush_done (GObject      *source_object,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+    FlushJob *job = g_task_get_task_data (G_TASK (result));
+    BlJournal *self = job->journal;
+    GError *error = NULL;
+
+    self->flushing = FALSE;
+
+    if (self->discarded)
+        return;
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+        g_warning ("Could not write journal: %s", error->message);
+        g_error_free (error);
+
+        // Unless the log was replaced meanwhile, start over in full
+        if (job->epoch == self->epoch)
+            self->rewrite = TRUE;
+    }
+
+    schedule_flush (self);
+}
+
+static void
+start_flush (BlJournal *self)
+{
+    // Picked up again once the write in progress is done
+    if (self->flushing || !needs_flush (self))
+        return;
+
+    FlushJob *job = g_new0 (FlushJob, 1);
+    job->journal = bl_journal_ref (self);
+    job->rewrite = self->rewrite;
+    job->epoch = self->epoch;
+
+    if (self->marks->len == 0)
+    {
+        // The header goes out again with the next edit
+        job->remove = TRUE;
+        self->on_disk = FALSE;
+        self->rewrite = TRUE;
+        self->written = 0;
+    }
+    else
+    {
+        if (self->rewrite)
+            job->data = g_bytes_new (self->log->str, self->log->len);
+        else
+            job->data = g_bytes_new (self->log->str + self->written, self->log->len - self->written);
+
+        self->on_disk = TRUE;
+        self->rewrite = FALSE;
+        self->written = self->log->len;
+    }
+
+    self->flushing = TRUE;
+
+    GTask *task = g_task_new (NULL, NULL, flush_done, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) flush_job_free);
+    g_task_run_in_thread (task, (GTaskThreadFunc) flush_thread);
+    g_object_unref (task);
+}
+
+static gboolean
+cb_flush_timeout (BlJournal *self)
+{
+    self->flush_id = 0;
+    start_flush (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_flush (BlJournal *self)
+{
+    if (self->flush_id != 0 || self->flushing || !needs_flush (self))
+        return;
+
+    self->flush_id = g_timeout_add (FLUSH_INTERVAL, (GSourceFunc) cb_flush_timeout, self);
+}
+
+static void
+add_mark (BlJournal *self,
+          guint64    sequence)
+{
+    JournalMark mark = { sequence, self->log->len };
+    g_array_append_val (self->marks, mark);
+}
+
+void
+bl_journal_insert (BlJournal   *self,
+                   guint64      sequence,
+                   gint         offset,
+                   const gchar *text,
+                   gsize        length)
+{
+    add_mark (self, sequence);
+    g_string_append_printf (self->log, "i %" G_GUINT64_FORMAT " %d %" G_GSIZE_FORMAT "\n",
+                            sequence, offset, length);
+    g_string_append_len (self->log, text, length);
+    g_string_append_c (self->log, '\n');
+
+    schedule_flush (self);
+}
+
+void
+bl_journal_delete (BlJournal *self,
+                   guint64    sequence,
+                   gint       start,
+                   gint       end)
+{
+    add_mark (self, sequence);
+    g_string_append_printf (self->log, "d %" G_GUINT64_FORMAT " %d %d\n",
+                            sequence, start, end);
+
+    schedule_flush (self);
+}
+
+void
+bl_journal_rebase (BlJournal   *self,
+                   guint64      sequence,
+                   const gchar *uri,
+                   gint         base_chars,
+                   guint        base_hash)
+{
+    guint kept = 0;
+
+    while (kept < self->marks->len &&
+           g_array_index (self->marks, JournalMark, kept).sequence <= sequence)
+        kept++;
+
+    gsize tail = kept < self->marks->len
+        ? g_array_index (self->marks, JournalMark, kept).offset
+        : self->log->len;
+
+    GString *log = g_string_new (NULL);
+    write_header (log, uri, base_chars, base_hash);
+    gsize header_length = log->len;
+    g_string_append_len (log, self->log->str + tail, self->log->len - tail);
+
+    g_array_remove_range (self->marks, 0, kept);
+
+    for (guint i = 0; i < self->marks->len; i++)
+    {
+        JournalMark *mark = &g_array_index (self->marks, JournalMark, i);
+        mark->offset = mark->offset - tail + header_length;
+    }
+
+    g_string_free (self->log, TRUE);
+    self->log = log;
+    self->written = 0;
+    self->rewrite = TRUE;
+    self->epoch++;
+
+    // Straight away, rather than leave a stale journal on disk
+    if (self->flush_id != 0)
+    {
+        g_source_remove (self->flush_id);
+        self->flush_id = 0;
+    }
+
+    start_flush (self);
+}
+
+void
+bl_journal_discard (BlJournal *self)
+{
+    if (self->flush_id != 0)
+    {
+        g_source_remove (self->flush_id);
+        self->flush_id = 0;
+    }
+
+    // Any write still in flight sees this and does nothing
+    g_mutex_lock (&self->lock);
+    self->discarded = TRUE;
+    g_unlink (self->path);
+    g_mutex_unlock (&self->lock);
+
+    bl_journal_unref (self);
+}
+
+static gboolean
+read_line (const gchar  **cursor,
+           const gchar   *end,
+           const gchar   *prefix,
+           gchar        **value)
+{
+    const gchar *eol = memchr (*cursor, '\n', end - *cursor);
+    gsize prefix_length = strlen (prefix);
+
+    if (eol == NULL || (gsize)(eol - *cursor) < prefix_length ||
+        strncmp (*cursor, prefix, prefix_length) != 0)
+        return FALSE;
+
+    *value = g_strndup (*cursor + prefix_length, eol - *cursor - prefix_length);
+    *cursor = eol + 1;
+    return TRUE;
+}
+
+static BlJournalRecovery *
+read_recovery (const gchar *path)
+{
+    gchar *contents;
+    gsize length;
+
+    if (!g_file_get_contents (path, &contents, &length, NULL))
+        return NULL;
+
+    const gchar *cursor = contents + MIN (length, strlen (JOURNAL_MAGIC));
+    const gchar *end = contents + length;
+    gchar *uri = NULL;
+    gchar *base = NULL;
+
+    // Nothing after the header means there is nothing to recover
+    if (!g_str_has_prefix (contents, JOURNAL_MAGIC) ||
+        !read_line (&cursor, end, "uri ", &uri) ||
+        !read_line (&cursor, end, "base ", &base) ||
+        cursor == end)
+    {
+        g_free (uri);
+        g_free (base);
+        g_free (contents);
+        return NULL;
+    }
+
+    BlJournalRecovery *self = g_new0 (BlJournalRecovery, 1);
+    self->path = g_strdup (path);
+    self->contents = contents;
+    self->length = length;
+    self->records_start = cursor - contents;
+
+    if (*uri != '\0')
+        self->uri = g_steal_pointer (&uri);
+
+    gchar *hash;
+    self->base_chars = (gint)g_ascii_strtoll (base, &hash, 10);
+    self->base_hash = (guint)g_ascii_strtoull (hash, NULL, 10);
+
+    g_free (uri);
+    g_free (base);
+    return self;
+}
+
+GList *
+bl_journal_find_recoveries (void)
+{
+    gchar *dir_path = get_journal_dir ();
+    GDir *dir = g_dir_open (dir_path, 0, NULL);
+    GList *recoveries = NULL;
+
+    if (dir == NULL)
+    {
+        g_free (dir_path);
+        return NULL;
+    }
+
+    const gchar *name;
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        if (!g_str_has_suffix (name, JOURNAL_SUFFIX))
+            continue;
+
+        gchar *path = g_build_filename (dir_path, name, NULL);
+        BlJournalRecovery *recovery = read_recovery (path);
+
+        if (recovery != NULL)
+            recoveries = g_list_prepend (recoveries, recovery);
+        else
+            g_unlink (path);
+
+        g_free (path);
+    }
+
+    g_dir_close (dir);
+    g_free (dir_path);
+    return recoveries;
+}
+
+const gchar *
+bl_journal_recovery_get_uri (BlJournalRecovery *self)
+{
+    return self->uri;
+}
+
+const gchar *
+bl_journal_recovery_get_path (BlJournalRecovery *self)
+{
+    return self->path;
+}
+
+gboolean
+bl_journal_recovery_apply (BlJournalRecovery  *self,
+                           GtkTextBuffer      *buffer,
+                           gint                base_chars,
+                           guint               base_hash,
+                           GError            **error)
+{
+    // Replaying over anything else would scramble it. Degraded
+    // documents are not hashed, so only their length can be checked.
+    if (base_chars != self->base_chars ||
+        (base_hash != 0 && self->base_hash != 0 && base_hash != self->base_hash))
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "The file has changed since the journal was written");
+        return FALSE;
+    }
+
+    const gchar *cursor = self->contents + self->records_start;
+    const gchar *end = self->contents + self->length;
+    guint replayed = 0;
+
+    gtk_text_buffer_begin_user_action (buffer);
+
+    while (cursor < end)
+    {
+        const gchar *eol = memchr (cursor, '\n', end - cursor);
+
+        if (eol == NULL)
+            break;
+
+        gchar *line = g_strndup (cursor, eol - cursor);
+        gchar type;
+        guint64 sequence;
+        guint64 first;
+        guint64 second;
+        gint fields = sscanf (line, "%c %" G_GINT64_MODIFIER "u %" G_GINT64_MODIFIER "u %" G_GINT64_MODIFIER "u",
+                              &type, &sequence, &first, &second);
+        g_free (line);
+
+        if (fields != 4)
+            break;
+
+        gint n_chars = gtk_text_buffer_get_char_count (buffer);
+        GtkTextIter start;
+        GtkTextIter stop;
+
+        if (type == 'i')
+        {
+            const gchar *text = eol + 1;
+
+            // Cut short, or not what this journal would have written
+            if (first > (guint64)n_chars || second >= (guint64)(end - text) ||
+                text[second] != '\n' || !g_utf8_validate (text, second, NULL))
+                break;
+
+            gtk_text_buffer_get_iter_at_offset (buffer, &start, first);
+            gtk_text_buffer_insert (buffer, &start, text, second);
+            cursor = text + second + 1;
+        }
+        else if (type == 'd')
+        {
+            if (first > second || second > (guint64)n_chars)
+                break;
+
+            gtk_text_buffer_get_iter_at_offset (buffer, &start, first);
+            gtk_text_buffer_get_iter_at_offset (buffer, &stop, second);
+            gtk_text_buffer_delete (buffer, &start, &stop);
+            cursor = eol + 1;
+        }
+        else
+        {
+            break;
+        }
+
+        replayed++;
+    }
+
+    gtk_text_buffer_end_user_action (buffer);
+
+    if (cursor < end)
+        g_warning ("Journal %s ends in a damaged record, replayed %u edits before it",
+                   self->path, replayed);
+
+    return TRUE;
+}
+
+void
+bl_journal_recovery_free (BlJournalRecovery *self)
+{
+    g_free (self->path);
+    g_free (self->uri);
+    g_free (self->contents);
+    g_free (self);
+}
+
+void
+bl_journal_recovery_discard (BlJournalRecovery *self)
+{
+    g_unlink (self->path);
+    bl_journal_recovery_free (self);
+}
@@ -0,0 +1,88 @@
+/* bl-journal.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+// Append-only log of the edits made to a document since it was last
+// saved, kept under $XDG_STATE_HOME so a crash does not lose them.
+// Records are buffered and written (and synced) in batches at most a
+// second apart, so the cost follows the amount typed rather than the
+// size of the document.
+//
+// Offsets are in characters. Each record carries the document's edit
+// sequence number, so a finished save can drop what it covered.
+typedef struct _BlJournal BlJournal;
+
+// `uri` is NULL for untitled documents. The base is the saved state
+// the edits apply to, as a character count and content hash.
+BlJournal *   bl_journal_new     (const gchar *uri,
+                                  gint         base_chars,
+                                  guint        base_hash);
+
+// Stops recording and removes the journal from disk
+void          bl_journal_discard (BlJournal   *self);
+
+void          bl_journal_insert  (BlJournal   *self,
+                                  guint64      sequence,
+                                  gint         offset,
+                                  const gchar *text,
+                                  gsize        length);
+void          bl_journal_delete  (BlJournal   *self,
+                                  guint64      sequence,
+                                  gint         start,
+                                  gint         end);
+
+// Moves the base to a newly saved state, dropping every record up to
+// and including `sequence`
+void          bl_journal_rebase  (BlJournal   *self,
+                                  guint64      sequence,
+                                  const gchar *uri,
+                                  gint         base_chars,
+                                  guint        base_hash);
+
+// A journal left behind by a previous run
+typedef struct _BlJournalRecovery BlJournalRecovery;
+
+// Every journal found on disk. Those that are unreadable or hold no
+// edits are removed.
+GList *       bl_journal_find_recoveries    (void);
+
+const gchar * bl_journal_recovery_get_uri   (BlJournalRecovery  *self);
+const gchar * bl_journal_recovery_get_path  (BlJournalRecovery  *self);
+
+// Replays the edits over `buffer`, which must hold the base the
+// journal was written against. A record cut short by the crash ends
+// the replay.
+gboolean      bl_journal_recovery_apply     (BlJournalRecovery  *self,
+                                             GtkTextBuffer      *buffer,
+                                             gint                base_chars,
+                                             guint               base_hash,
+                                             GError            **error);
+
+void          bl_journal_recovery_free      (BlJournalRecovery  *self);
+
+// Removes the journal from disk and frees it
+void          bl_journal_recovery_discard   (BlJournalRecovery  *self);
+
+G_END_DECLS
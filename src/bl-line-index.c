@@ -0,0 +1,272 @@
+/* bl-line-index.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-line-index.h"
+
+#include <string.h>
+
+#define NO_PENDING G_MAXUINT
+
+struct _BlLineIndex
+{
+    GArray *lines;
+
+    // Every line from `pending_line` onwards is still to be moved by
+    // the pending deltas. Edits on the same line (i.e. typing) only
+    // grow the deltas, so they never touch the rest of the table.
+    guint pending_line;
+    gssize pending_bytes;
+    gint pending_chars;
+};
+
+BlLineIndex *
+bl_line_index_new (void)
+{
+    BlLineIndex *self = g_new0 (BlLineIndex, 1);
+    self->lines = g_array_new (FALSE, FALSE, sizeof (BlLineStart));
+    bl_line_index_reset (self, "", 0);
+    return self;
+}
+
+void
+bl_line_index_free (BlLineIndex *self)
+{
+    g_array_free (self->lines, TRUE);
+    g_free (self);
+}
+
+static BlLineStart
+get_entry (BlLineIndex *self,
+           guint        line)
+{
+    BlLineStart entry = g_array_index (self->lines, BlLineStart, line);
+
+    if (line >= self->pending_line)
+    {
+        entry.byte += self->pending_bytes;
+        entry.chr += self->pending_chars;
+    }
+
+    return entry;
+}
+
+static void
+flush_pending (BlLineIndex *self)
+{
+    if (self->pending_line == NO_PENDING)
+        return;
+
+    for (guint i = self->pending_line; i < self->lines->len; i++)
+    {
+        BlLineStart *entry = &g_array_index (self->lines, BlLineStart, i);
+        entry->byte += self->pending_bytes;
+        entry->chr += self->pending_chars;
+    }
+
+    self->pending_line = NO_PENDING;
+    self->pending_bytes = 0;
+    self->pending_chars = 0;
+}
+
+// Appends the start of every line following a newline in `text`,
+// where `text` itself begins at `base`. Returns the character count.
+static gint
+scan_lines (GArray      *out,
+            BlLineStart  base,
+            const gchar *text,
+            gsize        length)
+{
+    const gchar *end = text + length;
+    gint chars = 0;
+
+    for (const gchar *c = text; c < end; c = g_utf8_next_char (c))
+    {
+        chars++;
+
+        if (*c == '\n')
+        {
+            BlLineStart start;
+            start.byte = base.byte + (c + 1 - text);
+            start.chr = base.chr + chars;
+            g_array_append_val (out, start);
+        }
+    }
+
+    return chars;
+}
+
+void
+bl_line_index_reset (BlLineIndex *self,
+                     const gchar *text,
+                     gssize       length)
+{
+    if (length < 0)
+        length = strlen (text);
+
+    BlLineStart first = { 0, 0 };
+
+    g_array_set_size (self->lines, 0);
+    g_array_append_val (self->lines, first);
+    scan_lines (self->lines, first, text, length);
+
+    self->pending_line = NO_PENDING;
+    self->pending_bytes = 0;
+    self->pending_chars = 0;
+}
+
+void
+bl_line_index_insert (BlLineIndex *self,
+                      gint         line,
+                      gsize        byte_column,
+                      gint         char_column,
+                      const gchar *text,
+                      gssize       length)
+{
+    g_return_if_fail (line >= 0 && (guint)line < self->lines->len);
+
+    if (length < 0)
+        length = strlen (text);
+
+    // Deltas can only be merged if they start at the same place
+    if (self->pending_line != NO_PENDING && self->pending_line != (guint)line + 1)
+        flush_pending (self);
+
+    BlLineStart base = get_entry (self, line);
+    base.byte += byte_column;
+    base.chr += char_column;
+
+    GArray *added = g_array_new (FALSE, FALSE, sizeof (BlLineStart));
+    gint chars = scan_lines (added, base, text, length);
+
+    // The new lines are exact. Everything after them is behind by
+    // whatever was pending plus this insertion.
+    g_array_insert_vals (self->lines, line + 1, added->data, added->len);
+
+    self->pending_line = line + 1 + added->len;
+    self->pending_bytes += length;
+    self->pending_chars += chars;
+
+    g_array_free (added, TRUE);
+}
+
+void
+bl_line_index_delete (BlLineIndex *self,
+                      gint         start_line,
+                      gsize        start_byte_column,
+                      gint         start_char_column,
+                      gint         end_line,
+                      gsize        end_byte_column,
+                      gint         end_char_column)
+{
+    g_return_if_fail (start_line >= 0 && start_line <= end_line);
+    g_return_if_fail ((guint)end_line < self->lines->len);
+
+    if (self->pending_line != NO_PENDING && self->pending_line != (guint)end_line + 1)
+        flush_pending (self);
+
+    BlLineStart start = get_entry (self, start_line);
+    BlLineStart end = get_entry (self, end_line);
+
+    gssize bytes = (end.byte + end_byte_column) - (start.byte + start_byte_column);
+    gint chars = (end.chr + end_char_column) - (start.chr + start_char_column);
+
+    // The deleted lines all sit before `pending_line`
+    if (end_line > start_line)
+        g_array_remove_range (self->lines, start_line + 1, end_line - start_line);
+
+    self->pending_line = start_line + 1;
+    self->pending_bytes -= bytes;
+    self->pending_chars -= chars;
+}
+
+guint
+bl_line_index_get_n_lines (BlLineIndex *self)
+{
+    return self->lines->len;
+}
+
+BlLineStart
+bl_line_index_get_line_start (BlLineIndex *self,
+                              gint         line)
+{
+    line = CLAMP (line, 0, (gint)self->lines->len - 1);
+    return get_entry (self, line);
+}
+
+gint
+bl_line_index_get_line_at_offset (BlLineIndex *self,
+                                  gint         offset)
+{
+    // Last line starting at or before `offset`
+    guint low = 0;
+    guint high = self->lines->len;
+
+    while (high - low > 1)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (get_entry (self, mid).chr <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+gint
+bl_line_index_get_line_at_byte (BlLineIndex *self,
+                                gsize        byte)
+{
+    guint low = 0;
+    guint high = self->lines->len;
+
+    while (high - low > 1)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (get_entry (self, mid).byte <= byte)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+void
+bl_line_index_copy_range (BlLineIndex *self,
+                          gint         first,
+                          gint         last,
+                          GArray      *out)
+{
+    first = CLAMP (first, 0, (gint)self->lines->len - 1);
+    last = CLAMP (last, first, (gint)self->lines->len - 1);
+
+    BlLineStart base = get_entry (self, first);
+
+    for (gint i = first; i <= last; i++)
+    {
+        BlLineStart entry = get_entry (self, i);
+        entry.byte -= base.byte;
+        entry.chr -= base.chr;
+        g_array_append_val (out, entry);
+    }
+}
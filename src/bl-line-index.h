@@ -0,0 +1,81 @@
+/* bl-line-index.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Start of a line, both as a byte offset (what cmark reports) and
+// as a character offset (what GtkTextBuffer wants)
+typedef struct
+{
+    gsize byte;
+    gint chr;
+} BlLineStart;
+
+// Table of line starts for a piece of text. It is kept up to date
+// from edits rather than rescanning, so the start of any line is a
+// lookup and the line containing any offset is a binary search.
+typedef struct _BlLineIndex BlLineIndex;
+
+BlLineIndex *  bl_line_index_new                 (void);
+void           bl_line_index_free                (BlLineIndex *self);
+
+// Rebuilds the table from scratch by scanning `text`
+void           bl_line_index_reset               (BlLineIndex *self,
+                                                  const gchar *text,
+                                                  gssize       length);
+
+// Records `text` being inserted at the given line and column (in
+// bytes and characters from the start of that line)
+void           bl_line_index_insert              (BlLineIndex *self,
+                                                  gint         line,
+                                                  gsize        byte_column,
+                                                  gint         char_column,
+                                                  const gchar *text,
+                                                  gssize       length);
+
+// Records the text between the two positions being deleted
+void           bl_line_index_delete              (BlLineIndex *self,
+                                                  gint         start_line,
+                                                  gsize        start_byte_column,
+                                                  gint         start_char_column,
+                                                  gint         end_line,
+                                                  gsize        end_byte_column,
+                                                  gint         end_char_column);
+
+guint          bl_line_index_get_n_lines         (BlLineIndex *self);
+BlLineStart    bl_line_index_get_line_start      (BlLineIndex *self,
+                                                  gint         line);
+gint           bl_line_index_get_line_at_offset  (BlLineIndex *self,
+                                                  gint         offset);
+gint           bl_line_index_get_line_at_byte    (BlLineIndex *self,
+                                                  gsize        byte);
+
+// Copies the starts of lines [first, last] into `out`, rebased so the
+// first line starts at zero. Used to hand a region to another thread.
+void           bl_line_index_copy_range          (BlLineIndex *self,
+                                                  gint         first,
+                                                  gint         last,
+                                                  GArray      *out);
+
+G_END_DECLS
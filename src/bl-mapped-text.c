@@ -0,0 +1,156 @@
+/* bl-mapped-text.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include "bl-mapped-text.h"
+
+#include <string.h>
+
+struct _BlMappedText
+{
+    GMappedFile *file;
+    const gchar *data;
+    gsize length;
+
+    // Start of every STRIDEth line found so far
+    GArray *checkpoints;
+
+    // Lines whose start is known, and where scanning carries on from
+    guint scanned_lines;
+    gsize scanned_bytes;
+    gboolean complete;
+};
+
+BlMappedText *
+bl_mapped_text_new (GMappedFile *file)
+{
+    BlMappedText *self = g_new0 (BlMappedText, 1);
+    self->file = g_mapped_file_ref (file);
+    self->data = g_mapped_file_get_contents (file);
+    self->length = g_mapped_file_get_length (file);
+    self->checkpoints = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+    gsize first = 0;
+    g_array_append_val (self->checkpoints, first);
+    self->scanned_lines = 1;
+    self->scanned_bytes = 0;
+
+    return self;
+}
+
+void
+bl_mapped_text_free (BlMappedText *self)
+{
+    g_array_free (self->checkpoints, TRUE);
+    g_mapped_file_unref (self->file);
+    g_free (self);
+}
+
+gsize
+bl_mapped_text_get_length (BlMappedText *self)
+{
+    return self->length;
+}
+
+GBytes *
+bl_mapped_text_get_bytes (BlMappedText *self)
+{
+    return g_mapped_file_get_bytes (self->file);
+}
+
+// Finds line starts until `line` is known or the file runs out
+static void
+scan_to_line (BlMappedText *self,
+              guint         line)
+{
+    while (!self->complete && self->scanned_lines <= line)
+    {
+        const gchar *newline = memchr (self->data + self->scanned_bytes, '\n',
+                                       self->length - self->scanned_bytes);
+
+        if (newline == NULL)
+        {
+            self->complete = TRUE;
+            break;
+        }
+
+        self->scanned_bytes = newline + 1 - self->data;
+
+        if (self->scanned_lines % BL_MAPPED_TEXT_STRIDE == 0)
+            g_array_append_val (self->checkpoints, self->scanned_bytes);
+
+        self->scanned_lines++;
+    }
+}
+
+guint
+bl_mapped_text_get_n_lines (BlMappedText *self)
+{
+    if (self->complete || self->scanned_bytes == 0)
+        return self->scanned_lines;
+
+    // Assume the rest of the file looks like what has been seen
+    gdouble per_byte = (gdouble)self->scanned_lines / self->scanned_bytes;
+    return MAX (self->scanned_lines + 1, (guint)(per_byte * self->length));
+}
+
+gboolean
+bl_mapped_text_is_complete (BlMappedText *self)
+{
+    return self->complete;
+}
+
+gsize
+bl_mapped_text_get_line_start (BlMappedText *self,
+                               guint         line)
+{
+    scan_to_line (self, line);
+    line = MIN (line, self->scanned_lines - 1);
+
+    // Walk forward from the nearest checkpoint
+    guint checkpoint = line / BL_MAPPED_TEXT_STRIDE;
+    gsize offset = g_array_index (self->checkpoints, gsize, checkpoint);
+
+    for (guint i = checkpoint * BL_MAPPED_TEXT_STRIDE; i < line; i++)
+    {
+        const gchar *newline = memchr (self->data + offset, '\n', self->length - offset);
+        offset = newline + 1 - self->data;
+    }
+
+    return offset;
+}
+
+gchar *
+bl_mapped_text_get_lines (BlMappedText *self,
+                          guint         first,
+                          guint         n_lines)
+{
+    gsize start = bl_mapped_text_get_line_start (self, first);
+    gsize end = self->length;
+
+    // Stop at the start of the line after the range, if there is one
+    scan_to_line (self, first + n_lines);
+
+    if (first + n_lines < self->scanned_lines)
+        end = bl_mapped_text_get_line_start (self, first + n_lines);
+
+    // Logs and exports are not always clean
+    return g_utf8_make_valid (self->data + start, end - start);
+}
@@ -0,0 +1,57 @@
+/* bl-mapped-text.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Read-only view of a memory-mapped file, for documents too large to
+// load into a GtkTextBuffer. Lines are found lazily: the file is only
+// scanned as far as the furthest line asked for, and only every
+// `BL_MAPPED_TEXT_STRIDE`th line start is remembered.
+typedef struct _BlMappedText BlMappedText;
+
+#define BL_MAPPED_TEXT_STRIDE 64
+
+// Takes its own reference to `file`
+BlMappedText *  bl_mapped_text_new              (GMappedFile  *file);
+void            bl_mapped_text_free             (BlMappedText *self);
+
+gsize           bl_mapped_text_get_length       (BlMappedText *self);
+GBytes *        bl_mapped_text_get_bytes        (BlMappedText *self);
+
+// Number of lines, or an estimate from the part scanned so far if
+// the scan has not reached the end of the file
+guint           bl_mapped_text_get_n_lines      (BlMappedText *self);
+gboolean        bl_mapped_text_is_complete      (BlMappedText *self);
+
+// Byte offset of the start of `line`, clamped to the last line
+gsize           bl_mapped_text_get_line_start   (BlMappedText *self,
+                                                 guint         line);
+
+// Copies lines [first, first + n_lines) as valid UTF-8
+gchar *         bl_mapped_text_get_lines        (BlMappedText *self,
+                                                 guint         first,
+                                                 guint         n_lines);
+
+G_END_DECLS
@@ -19,7 +19,7 @@
  */
 
 #include "bl-markdown-view.h"
-#include <cmark.h>
+#include "bl-document.h"
 
 struct _BlMarkdownView
 {
@@ -27,77 +27,23 @@ struct _BlMarkdownView
     GtkTextTag *user_style_tag;
     GVariant *font;
     gdouble spacing;
+
+    // Parsing and tagging are shared by every view of a document
+    BlHighlighter *highlighter;
+    guint debounce;
+    guint max_latency;
+    gdouble budget;
 };
 
 G_DEFINE_TYPE(BlMarkdownView, bl_markdown_view, GTK_TYPE_TEXT_VIEW);
 
-static void
-apply_heading_tag(GtkTextBuffer *buffer,
-                  int           level,
-                  GtkTextIter   *start,
-                  GtkTextIter   *end)
-{
-    if (level == 1) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading1", start, end);
-    }
-    else if (level == 2) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading2", start, end);
-    }
-    else if (level == 3) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading3", start, end);
-    }
-    else if (level == 4) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading4", start, end);
-    }
-    else if (level == 5) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading5", start, end);
-    }
-    else if (level == 6) {
-        gtk_text_buffer_apply_tag_by_name (buffer, "heading6", start, end);
-    }
-}
-
-static void
-apply_tag(GtkTextBuffer   *buffer,
-          cmark_node      *node,
-          GtkTextIter     *start,
-          GtkTextIter     *end)
-{
-    switch (cmark_node_get_type(node))
-    {
-        // All Headings (1-6)
-        case CMARK_NODE_HEADING:
-        {
-            int level = cmark_node_get_heading_level(node);
-            apply_heading_tag(buffer, level, start, end);
-            break;
-        }
-
-        // Bold
-        case CMARK_NODE_STRONG:
-        {
-            gtk_text_buffer_apply_tag_by_name (buffer, "bold", start, end);
-            break;
-        }
-
-        // Italic
-        case CMARK_NODE_EMPH:
-        {
-            gtk_text_buffer_apply_tag_by_name (buffer, "italic", start, end);
-            break;
-        }
-
-        // Do nothing (for completeness)
-        default:
-        {
-            break;
-        }
-    }
-}
-
 static void
 update_style (BlMarkdownView *self)
 {
+    // Plain buffers have nothing to style
+    if (self->user_style_tag == NULL)
+        return;
+
     if (self->font)
     {
         g_debug ("Updating Font");
@@ -145,94 +91,63 @@ bl_markdown_view_set_line_spacing (BlMarkdownView *self, gdouble line_spacing)
     update_style (self);
 }
 
-static void
-highlight_buffer (GtkTextBuffer* buffer, BlMarkdownView* self)
+void
+bl_markdown_view_set_highlight_delay (BlMarkdownView *self,
+                                      guint           debounce,
+                                      guint           max_latency)
 {
-    // Sanity checks
-    g_assert(BL_IS_MARKDOWN_VIEW (self));
+    self->debounce = debounce;
+    self->max_latency = max_latency;
 
-    // Log it
-    g_debug("Highlighting Buffer");
+    if (self->highlighter != NULL)
+        bl_highlighter_set_delay (self->highlighter, debounce, max_latency);
+}
 
-    // Adapted from https://github.com/ali-rantakari/peg-markdown-highlight/blob/master/example_gtk2/gtkexample.c
-    // Modified for gtk3 and cmark by Matthew Jakeman
+void
+bl_markdown_view_set_highlight_budget (BlMarkdownView *self,
+                                       gdouble         budget)
+{
+    self->budget = budget;
 
-    // Get start and end iterators for text buffer
+    if (self->highlighter != NULL)
+        bl_highlighter_set_budget (self->highlighter, budget);
+}
+
+const BlHighlightStats *
+bl_markdown_view_get_highlight_stats (BlMarkdownView *self)
+{
+    if (self->highlighter == NULL)
+        return NULL;
+
+    return bl_highlighter_get_stats (self->highlighter);
+}
+
+static void
+cb_parsed (BlHighlighter  *highlighter,
+           BlMarkdownView *self)
+{
+    // Tag whatever is on screen before the rest of the document
+    GdkRectangle rect;
     GtkTextIter start;
     GtkTextIter end;
-    gtk_text_buffer_get_start_iter(buffer, &start);
-    gtk_text_buffer_get_end_iter(buffer, &end);
-
-    // Get text from GtkTextBuffer
-    gchar* text;
-    text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
-
-    // Get length
-    int length = strlen(text);
-
-    // Remove existing tags
-    gtk_text_buffer_remove_all_tags(buffer, &start, &end);
-
-    // Markdown Parsing
-    cmark_node *document = cmark_parse_document((char *)text, length,
-                                                 CMARK_OPT_DEFAULT | CMARK_OPT_SOURCEPOS);
-
-    g_debug("%s", cmark_render_html(document, CMARK_OPT_DEFAULT));
-
-    // Cmark Iterator loop
-    cmark_event_type ev_type;
-    cmark_iter *iter = cmark_iter_new(document);
-
-    while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
-        if (ev_type == CMARK_EVENT_ENTER) {
-            cmark_node *cur = cmark_iter_get_node(iter);
-
-            // Get cmark positioning
-            const char* name = cmark_node_get_type_string(cur);
-            int start_line = cmark_node_get_start_line (cur);
-            int start_col = cmark_node_get_start_column (cur);
-            int end_line = cmark_node_get_end_line (cur);
-            int end_col = cmark_node_get_end_column (cur);
-            g_debug("%s - Start (%d, %d) to End (%d, %d)", name, start_line, start_col, end_line, end_col);
-
-            // GtkTextIter for start and end positions of nodes
-            GtkTextIter node_start;
-            GtkTextIter node_end;
-
-            // Hacky code to work around cmark's strangeness
-            // TODO: Migrate to a different library in the future
-            // Or submit a patch to cmark?
-
-            start_col = start_col == 0 ? 0 : start_col - 1;
-            end_col = end_col == 0 ? 0 : end_col;
-            start_line = start_line == 0 ? 0 : start_line - 1;
-            end_line = end_line == 0 ? 0 : end_line - 1;
-
-            // Get GtkTextBuffer offsets for each TextIter
-            gtk_text_buffer_get_iter_at_line_index(buffer, &node_start,
-                                                   start_line, start_col);
-            gtk_text_buffer_get_iter_at_line_index(buffer, &node_end,
-                                                   end_line, end_col);
-
-#if 0
-            // Get gtk positioning
-            int gtk_start = gtk_text_iter_get_line (&node_start);
-            int gtk_end = gtk_text_iter_get_line (&node_end);
-            int gtk_start_col = gtk_text_iter_get_line_index (&node_start);
-            int gtk_end_col = gtk_text_iter_get_line_index (&node_end);
-            g_debug("gtk - Start (%d, %d) to End (%d, %d)\n", gtk_start, gtk_start_col, gtk_end, gtk_end_col);
-#endif
-
-            // Apply tag
-            apply_tag (buffer, cur, &node_start, &node_end);
-
-        }
-    }
+    gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (self), &rect);
+    gtk_text_view_get_iter_at_location (GTK_TEXT_VIEW (self), &start, rect.x, rect.y);
+    gtk_text_view_get_iter_at_location (GTK_TEXT_VIEW (self), &end,
+                                        rect.x + rect.width, rect.y + rect.height);
+    gtk_text_iter_forward_line (&end);
+
+    bl_highlighter_apply_range (highlighter, &start, &end);
+}
 
-    // Update font tag
-    gtk_text_buffer_apply_tag (buffer, self->user_style_tag, &start, &end);
+static void
+detach_highlighter (BlMarkdownView *self)
+{
+    if (self->highlighter == NULL)
+        return;
 
-    g_debug("\n\n");
+    g_signal_handlers_disconnect_by_data (self->highlighter, self);
+    bl_highlighter_detach_view (self->highlighter, GTK_TEXT_VIEW (self));
+    g_clear_object (&self->highlighter);
 }
 
 static void
@@ -243,78 +158,26 @@ initialise_buffer (BlMarkdownView* self)
 
     GtkTextBuffer* buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(self));
 
-    // Create tags
+    // Tags are created by the document
     GtkTextTagTable *tag_table = gtk_text_buffer_get_tag_table (buffer);
-
-    // TODO: Find a better way of telling if the buffer has been initialised
-    // We should probably move this into BlDocument itself to handle multiple
-    // file types outside of just markdown.
-    if (gtk_text_tag_table_lookup (tag_table, "heading1") == NULL)
-    {
-        // PSA: `create_tag` needs to be NULL terminated, otherwise
-        // everything breaks, in a very painful way.
-
-        // Tag: Heading 1
-        gtk_text_buffer_create_tag(buffer, "heading1",
-                                   "scale", (double)2,
-                                   NULL);
-        // Tag: Heading 2
-        gtk_text_buffer_create_tag(buffer, "heading2",
-                                   "foreground", "#d70022",
-                                   "scale", (double)1.5,
-                                   NULL);
-
-        // Tag: Heading 3
-        gtk_text_buffer_create_tag(buffer, "heading3",
-                                   "foreground", "#0a84ff",
-                                   "scale", (double)1.4,
-                                   NULL);
-
-        // Tag: Heading 4
-        gtk_text_buffer_create_tag(buffer, "heading4",
-                                   "foreground", "#ff9400",
-                                   "scale", (double)1.3,
-                                   NULL);
-
-        // Tag: Heading 5
-        gtk_text_buffer_create_tag(buffer, "heading5",
-                                   "foreground", "#9400ff",
-                                   "scale", (double)1.2,
-                                   NULL);
-
-        // Tag: Heading 6
-        gtk_text_buffer_create_tag(buffer, "heading6",
-                                   "foreground", "#363959",
-                                   "weight", PANGO_WEIGHT_BOLD,
-                                   NULL);
-
-        // Tag: Bold
-        gtk_text_buffer_create_tag(buffer, "bold",
-                                   "weight", PANGO_WEIGHT_BOLD,
-                                   NULL);
-
-        // Tag: Italic
-        gtk_text_buffer_create_tag(buffer, "italic",
-                                   "style", PANGO_STYLE_ITALIC,
-                                   NULL);
-
-        // Tag: Widget Font Styling
-        self->user_style_tag =
-            gtk_text_buffer_create_tag (buffer, "user-style",
-                                        NULL);
-
-        gtk_text_tag_set_priority (self->user_style_tag, 0);
-    }
-
     self->user_style_tag = gtk_text_tag_table_lookup (tag_table, "user-style");
 
     update_style (self);
 
-    highlight_buffer(buffer, self);
+    detach_highlighter (self);
 
-    // Re-highlight on changed event
-    g_signal_connect(G_OBJECT(buffer), "changed",
-                     G_CALLBACK(highlight_buffer), self);
+    if (!BL_IS_DOCUMENT (buffer))
+        return;
+
+    // Parsing happens once per document. We only lend it our frame
+    // clock and tag our viewport first when a result comes in.
+    self->highlighter = g_object_ref (bl_document_get_highlighter (BL_DOCUMENT (buffer)));
+    bl_highlighter_attach_view (self->highlighter, GTK_TEXT_VIEW (self));
+    bl_highlighter_set_delay (self->highlighter, self->debounce, self->max_latency);
+    bl_highlighter_set_budget (self->highlighter, self->budget);
+
+    g_signal_connect (self->highlighter, "parsed",
+                      G_CALLBACK (cb_parsed), self);
 }
 
 void bl_markdown_view_set_buffer (BlMarkdownView* self, GtkTextBuffer* buffer)
@@ -323,10 +186,22 @@ void bl_markdown_view_set_buffer (BlMarkdownView* self, GtkTextBuffer* buffer)
     initialise_buffer (self);
 }
 
+static void
+bl_markdown_view_dispose (GObject *object)
+{
+    BlMarkdownView *self = BL_MARKDOWN_VIEW (object);
+
+    detach_highlighter (self);
+
+    G_OBJECT_CLASS (bl_markdown_view_parent_class)->dispose (object);
+}
+
 static void
 bl_markdown_view_class_init (BlMarkdownViewClass* klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+    object_class->dispose = bl_markdown_view_dispose;
 }
 
 static void
@@ -334,6 +209,10 @@ bl_markdown_view_init (BlMarkdownView* self)
 {
     GtkStyleContext *context = gtk_widget_get_style_context (GTK_WIDGET (self));
     gtk_style_context_add_class (context, "text-view");
+
+    self->debounce = BL_HIGHLIGHTER_DEFAULT_DEBOUNCE;
+    self->max_latency = BL_HIGHLIGHTER_DEFAULT_MAX_LATENCY;
+    self->budget = BL_HIGHLIGHTER_DEFAULT_BUDGET;
     initialise_buffer (self);
 
     // Default Value
@@ -20,6 +20,8 @@
 
 #include <gtk/gtk.h>
 
+#include "bl-highlighter.h"
+
 G_BEGIN_DECLS
 
 #define BL_TYPE_MARKDOWN_VIEW (bl_markdown_view_get_type())
@@ -28,4 +30,7 @@ G_DECLARE_FINAL_TYPE(BlMarkdownView, bl_markdown_view, BL, MARKDOWN_VIEW, GtkTex
 void bl_markdown_view_set_buffer (BlMarkdownView* self, GtkTextBuffer* buffer);
 void bl_markdown_view_set_font (BlMarkdownView *self, const gchar *font_name);
 void bl_markdown_view_set_line_spacing (BlMarkdownView *self, gdouble line_spacing);
+void bl_markdown_view_set_highlight_delay (BlMarkdownView *self, guint debounce, guint max_latency);
+void bl_markdown_view_set_highlight_budget (BlMarkdownView *self, gdouble budget);
+const BlHighlightStats *bl_markdown_view_get_highlight_stats (BlMarkdownView *self);
 G_END_DECLS
@@ -0,0 +1,512 @@
+/* bl-piece-table.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include "bl-piece-table.h"
+
+#include <string.h>
+
+// Upper bound on the length of a piece. Splitting a piece means
+// counting the newlines in part of it, so this bounds the cost of
+// every edit. Inserted text is stored in blocks of the same size.
+#define MAX_PIECE_LENGTH 65536
+
+typedef struct _BlPiece BlPiece;
+
+struct _BlPiece
+{
+    const gchar *data;
+    gsize length;
+    guint newlines;
+
+    // Treap
+    guint32 priority;
+    BlPiece *left;
+    BlPiece *right;
+    gsize subtree_length;
+    guint subtree_newlines;
+};
+
+struct _BlPieceTable
+{
+    gint ref_count;
+    GBytes *original;
+
+    // Inserted text. Blocks are never moved or freed while the table
+    // is alive, so pieces can point straight into them.
+    GPtrArray *add_blocks;
+    gsize add_used;
+
+    BlPiece *root;
+    guint n_pieces;
+    guint32 seed;
+};
+
+static guint
+count_newlines (const gchar *data,
+                gsize        length)
+{
+    const gchar *end = data + length;
+    guint newlines = 0;
+
+    while ((data = memchr (data, '\n', end - data)) != NULL)
+    {
+        newlines++;
+        data++;
+    }
+
+    return newlines;
+}
+
+static guint32
+next_priority (BlPieceTable *self)
+{
+    // xorshift32
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    return self->seed;
+}
+
+static BlPiece *
+piece_new (BlPieceTable *self,
+           const gchar  *data,
+           gsize         length,
+           guint         newlines,
+           guint32       priority)
+{
+    BlPiece *piece = g_new0 (BlPiece, 1);
+    piece->data = data;
+    piece->length = length;
+    piece->newlines = newlines;
+    piece->priority = priority;
+    piece->subtree_length = length;
+    piece->subtree_newlines = newlines;
+
+    self->n_pieces++;
+    return piece;
+}
+
+static void
+piece_free_tree (BlPieceTable *self,
+                 BlPiece      *piece)
+{
+    if (piece == NULL)
+        return;
+
+    piece_free_tree (self, piece->left);
+    piece_free_tree (self, piece->right);
+    g_free (piece);
+
+    self->n_pieces--;
+}
+
+static inline gsize
+subtree_length (BlPiece *piece)
+{
+    return piece ? piece->subtree_length : 0;
+}
+
+static inline guint
+subtree_newlines (BlPiece *piece)
+{
+    return piece ? piece->subtree_newlines : 0;
+}
+
+static inline void
+update (BlPiece *piece)
+{
+    piece->subtree_length = subtree_length (piece->left) + piece->length + subtree_length (piece->right);
+    piece->subtree_newlines = subtree_newlines (piece->left) + piece->newlines + subtree_newlines (piece->right);
+}
+
+// Joins two treaps, every piece of `left` coming before `right`
+static BlPiece *
+merge (BlPiece *left,
+       BlPiece *right)
+{
+    if (left == NULL)
+        return right;
+
+    if (right == NULL)
+        return left;
+
+    if (left->priority > right->priority)
+    {
+        left->right = merge (left->right, right);
+        update (left);
+        return left;
+    }
+
+    right->left = merge (left, right->left);
+    update (right);
+    return right;
+}
+
+// Splits a treap into the text before `offset` and the text from it
+// onwards, cutting a piece in two if it straddles the offset
+static void
+split (BlPieceTable  *self,
+       BlPiece       *piece,
+       gsize          offset,
+       BlPiece      **left,
+       BlPiece      **right)
+{
+    if (piece == NULL)
+    {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+
+    gsize left_length = subtree_length (piece->left);
+
+    if (offset <= left_length)
+    {
+        split (self, piece->left, offset, left, &piece->left);
+        update (piece);
+        *right = piece;
+        return;
+    }
+
+    if (offset >= left_length + piece->length)
+    {
+        split (self, piece->right, offset - left_length - piece->length, &piece->right, right);
+        update (piece);
+        *left = piece;
+        return;
+    }
+
+    // Only count the newlines in the shorter half
+    gsize cut = offset - left_length;
+    gsize rest = piece->length - cut;
+    guint tail_newlines = cut < rest
+        ? piece->newlines - count_newlines (piece->data, cut)
+        : count_newlines (piece->data + cut, rest);
+
+    // Sharing the priority keeps the heap order with the right subtree
+    BlPiece *tail = piece_new (self, piece->data + cut, rest, tail_newlines, piece->priority);
+    tail->right = piece->right;
+    update (tail);
+
+    piece->length = cut;
+    piece->newlines -= tail_newlines;
+    piece->right = NULL;
+    update (piece);
+
+    *left = piece;
+    *right = tail;
+}
+
+// Grows the last piece of a treap if `data` follows on directly from
+// it, which is the case when typing
+static gboolean
+extend_last (BlPiece     *piece,
+             const gchar *data,
+             gsize        length,
+             guint        newlines)
+{
+    if (piece == NULL)
+        return FALSE;
+
+    if (piece->right != NULL)
+    {
+        if (!extend_last (piece->right, data, length, newlines))
+            return FALSE;
+
+        update (piece);
+        return TRUE;
+    }
+
+    if (piece->data + piece->length != data)
+        return FALSE;
+
+    piece->length += length;
+    piece->newlines += newlines;
+    update (piece);
+    return TRUE;
+}
+
+BlPieceTable *
+bl_piece_table_new (GBytes *original)
+{
+    BlPieceTable *self = g_new0 (BlPieceTable, 1);
+    self->ref_count = 1;
+    self->original = g_bytes_ref (original);
+    self->add_blocks = g_ptr_array_new_with_free_func (g_free);
+    self->add_used = MAX_PIECE_LENGTH;
+    self->seed = 2463534242;
+
+    gsize length;
+    const gchar *data = g_bytes_get_data (original, &length);
+
+    for (gsize offset = 0; offset < length; offset += MAX_PIECE_LENGTH)
+    {
+        gsize piece_length = MIN (MAX_PIECE_LENGTH, length - offset);
+        BlPiece *piece = piece_new (self, data + offset, piece_length,
+                                    count_newlines (data + offset, piece_length),
+                                    next_priority (self));
+        self->root = merge (self->root, piece);
+    }
+
+    return self;
+}
+
+BlPieceTable *
+bl_piece_table_ref (BlPieceTable *self)
+{
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+bl_piece_table_unref (BlPieceTable *self)
+{
+    if (!g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    piece_free_tree (self, self->root);
+    g_ptr_array_free (self->add_blocks, TRUE);
+    g_bytes_unref (self->original);
+    g_free (self);
+}
+
+gsize
+bl_piece_table_get_length (BlPieceTable *self)
+{
+    return subtree_length (self->root);
+}
+
+guint
+bl_piece_table_get_n_lines (BlPieceTable *self)
+{
+    return subtree_newlines (self->root) + 1;
+}
+
+guint
+bl_piece_table_get_n_pieces (BlPieceTable *self)
+{
+    return self->n_pieces;
+}
+
+void
+bl_piece_table_insert (BlPieceTable *self,
+                       gsize         offset,
+                       const gchar  *text,
+                       gsize         length)
+{
+    g_return_if_fail (offset <= bl_piece_table_get_length (self));
+
+    BlPiece *left;
+    BlPiece *right;
+    split (self, self->root, offset, &left, &right);
+
+    while (length > 0)
+    {
+        if (self->add_used == MAX_PIECE_LENGTH)
+        {
+            g_ptr_array_add (self->add_blocks, g_malloc (MAX_PIECE_LENGTH));
+            self->add_used = 0;
+        }
+
+        gchar *block = g_ptr_array_index (self->add_blocks, self->add_blocks->len - 1);
+        gchar *dest = block + self->add_used;
+        gsize chunk = MIN (length, MAX_PIECE_LENGTH - self->add_used);
+
+        memcpy (dest, text, chunk);
+        self->add_used += chunk;
+
+        guint newlines = count_newlines (dest, chunk);
+
+        if (!extend_last (left, dest, chunk, newlines))
+            left = merge (left, piece_new (self, dest, chunk, newlines, next_priority (self)));
+
+        text += chunk;
+        length -= chunk;
+    }
+
+    self->root = merge (left, right);
+}
+
+void
+bl_piece_table_delete (BlPieceTable *self,
+                       gsize         offset,
+                       gsize         length)
+{
+    g_return_if_fail (offset + length <= bl_piece_table_get_length (self));
+
+    BlPiece *left;
+    BlPiece *middle;
+    BlPiece *right;
+    split (self, self->root, offset, &left, &right);
+    split (self, right, length, &middle, &right);
+
+    // The text itself stays where it is, for any spans still in use
+    piece_free_tree (self, middle);
+    self->root = merge (left, right);
+}
+
+gsize
+bl_piece_table_get_line_start (BlPieceTable *self,
+                               guint         line)
+{
+    // Line `n` starts after the `n`th newline
+    guint remaining = MIN (line, subtree_newlines (self->root));
+    gsize offset = 0;
+    BlPiece *piece = self->root;
+
+    if (remaining == 0)
+        return 0;
+
+    while (piece != NULL)
+    {
+        guint left_newlines = subtree_newlines (piece->left);
+
+        if (remaining <= left_newlines)
+        {
+            piece = piece->left;
+            continue;
+        }
+
+        remaining -= left_newlines;
+        offset += subtree_length (piece->left);
+
+        if (remaining <= piece->newlines)
+        {
+            const gchar *c = piece->data;
+
+            while (TRUE)
+            {
+                c = memchr (c, '\n', piece->data + piece->length - c);
+
+                if (--remaining == 0)
+                    return offset + (c - piece->data) + 1;
+
+                c++;
+            }
+        }
+
+        remaining -= piece->newlines;
+        offset += piece->length;
+        piece = piece->right;
+    }
+
+    g_assert_not_reached ();
+}
+
+guint
+bl_piece_table_get_line_at_offset (BlPieceTable *self,
+                                   gsize         offset)
+{
+    guint line = 0;
+    BlPiece *piece = self->root;
+
+    while (piece != NULL)
+    {
+        gsize left_length = subtree_length (piece->left);
+
+        if (offset < left_length)
+        {
+            piece = piece->left;
+            continue;
+        }
+
+        line += subtree_newlines (piece->left);
+        offset -= left_length;
+
+        if (offset < piece->length)
+            return line + count_newlines (piece->data, offset);
+
+        line += piece->newlines;
+        offset -= piece->length;
+        piece = piece->right;
+    }
+
+    return line;
+}
+
+// Copies the part of a subtree between `start` and `end`, relative
+// to its first byte, visiting only the pieces that overlap it
+static void
+copy_range (BlPiece  *piece,
+            gsize     start,
+            gsize     end,
+            gchar   **out)
+{
+    if (piece == NULL || start >= end)
+        return;
+
+    gsize piece_start = subtree_length (piece->left);
+    gsize piece_end = piece_start + piece->length;
+
+    if (start < piece_start)
+        copy_range (piece->left, start, MIN (end, piece_start), out);
+
+    if (start < piece_end && end > piece_start)
+    {
+        gsize from = MAX (start, piece_start) - piece_start;
+        gsize to = MIN (end, piece_end) - piece_start;
+        memcpy (*out, piece->data + from, to - from);
+        *out += to - from;
+    }
+
+    if (end > piece_end)
+        copy_range (piece->right, MAX (start, piece_end) - piece_end, end - piece_end, out);
+}
+
+gchar *
+bl_piece_table_get_text (BlPieceTable *self,
+                         gsize         offset,
+                         gsize         length)
+{
+    gsize total = bl_piece_table_get_length (self);
+    offset = MIN (offset, total);
+    length = MIN (length, total - offset);
+
+    gchar *text = g_malloc (length + 1);
+    gchar *out = text;
+    copy_range (self->root, offset, offset + length, &out);
+    *out = '\0';
+
+    return text;
+}
+
+static void
+collect_spans (BlPiece *piece,
+               GArray  *spans)
+{
+    if (piece == NULL)
+        return;
+
+    collect_spans (piece->left, spans);
+
+    BlPieceSpan span = { piece->data, piece->length };
+    g_array_append_val (spans, span);
+
+    collect_spans (piece->right, spans);
+}
+
+GArray *
+bl_piece_table_get_spans (BlPieceTable *self)
+{
+    GArray *spans = g_array_sized_new (FALSE, FALSE, sizeof (BlPieceSpan), self->n_pieces);
+    collect_spans (self->root, spans);
+    return spans;
+}
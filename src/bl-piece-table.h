@@ -0,0 +1,77 @@
+/* bl-piece-table.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Text stored as a sequence of pieces over an original buffer (usually
+// a mapped file, which is never copied) and an append-only buffer for
+// everything inserted since. Pieces are kept in an implicit treap
+// ordered by position, so inserting, deleting and finding an offset or
+// line are all logarithmic in the number of pieces.
+//
+// All offsets are in bytes. The table does not check that edits fall
+// on character boundaries.
+typedef struct _BlPieceTable BlPieceTable;
+
+// A run of contiguous text, as handed out by `bl_piece_table_get_spans`
+typedef struct
+{
+    const gchar *data;
+    gsize length;
+} BlPieceSpan;
+
+BlPieceTable *  bl_piece_table_new                (GBytes       *original);
+BlPieceTable *  bl_piece_table_ref                (BlPieceTable *self);
+void            bl_piece_table_unref              (BlPieceTable *self);
+
+gsize           bl_piece_table_get_length         (BlPieceTable *self);
+guint           bl_piece_table_get_n_lines        (BlPieceTable *self);
+guint           bl_piece_table_get_n_pieces       (BlPieceTable *self);
+
+void            bl_piece_table_insert             (BlPieceTable *self,
+                                                   gsize         offset,
+                                                   const gchar  *text,
+                                                   gsize         length);
+void            bl_piece_table_delete             (BlPieceTable *self,
+                                                   gsize         offset,
+                                                   gsize         length);
+
+// Byte offset of the start of `line`, clamped to the last line
+gsize           bl_piece_table_get_line_start     (BlPieceTable *self,
+                                                   guint         line);
+guint           bl_piece_table_get_line_at_offset (BlPieceTable *self,
+                                                   gsize         offset);
+
+// Copies `length` bytes from `offset` into a new nul-terminated string
+gchar *         bl_piece_table_get_text           (BlPieceTable *self,
+                                                   gsize         offset,
+                                                   gsize         length);
+
+// The whole text as an array of BlPieceSpan, in order. The spans stay
+// valid, whatever is edited afterwards, for as long as a reference to
+// the table is held, so they can be written out from another thread.
+GArray *        bl_piece_table_get_spans          (BlPieceTable *self);
+
+G_END_DECLS
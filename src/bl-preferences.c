@@ -242,12 +242,16 @@ setup_editor_page (BlPreferences *self, GSettings *gsettings)
 
     HdyActionRow *font = action_row_with_font_btn (self, gsettings, "Default Font", "default-font");
     HdyActionRow *spacing = action_row_with_spin_btn (self, gsettings, "Line Spacing", "line-spacing", 0, 2, 0.1);
+    HdyActionRow *budget = action_row_with_spin_btn (self, gsettings, "Highlight Budget (ms)", "highlight-budget", 1, 16, 1);
     HdyActionRow *wrap = action_row_with_switch (self, gsettings, "Word Wrap", "word-wrap");
+    HdyActionRow *undo = action_row_with_spin_btn (self, gsettings, "Undo Memory (MB)", "undo-memory", 0, 1024, 16);
 
     // Add to Appearance Category
     gtk_container_add (GTK_CONTAINER (group1), GTK_WIDGET (font));
     gtk_container_add (GTK_CONTAINER (group1), GTK_WIDGET (spacing));
+    gtk_container_add (GTK_CONTAINER (group1), GTK_WIDGET (budget));
     gtk_container_add (GTK_CONTAINER (group1), GTK_WIDGET (wrap));
+    gtk_container_add (GTK_CONTAINER (group1), GTK_WIDGET (undo));
 
     // # System Category
     HdyPreferencesGroup *group2 = hdy_preferences_group_new ();
@@ -259,11 +263,26 @@ setup_editor_page (BlPreferences *self, GSettings *gsettings)
     gtk_container_add (GTK_CONTAINER (group2), GTK_WIDGET (ssd));
 
 
+    // # Large Files Category
+    HdyPreferencesGroup *group3 = hdy_preferences_group_new ();
+    hdy_preferences_group_set_title (group3, "Large Files");
+    hdy_preferences_group_set_description (group3, "How files too large to edit comfortably are opened.");
+
+    HdyActionRow *mapped = action_row_with_spin_btn (self, gsettings, "Open Read-Only Above (MB)", "mapped-threshold", 0, 4096, 16);
+    HdyActionRow *degrade_size = action_row_with_spin_btn (self, gsettings, "Simplify Above (MB)", "degrade-size", 0, 4096, 1);
+    HdyActionRow *degrade_line = action_row_with_spin_btn (self, gsettings, "Simplify Lines Longer Than", "degrade-line-length", 0, 1000000, 1000);
+
+    gtk_container_add (GTK_CONTAINER (group3), GTK_WIDGET (mapped));
+    gtk_container_add (GTK_CONTAINER (group3), GTK_WIDGET (degrade_size));
+    gtk_container_add (GTK_CONTAINER (group3), GTK_WIDGET (degrade_line));
+
+
     // # Themes Category
     // TODO;
 
     // # Add All Categories to Page
     gtk_container_add (GTK_CONTAINER (page), GTK_WIDGET (group1));
+    gtk_container_add (GTK_CONTAINER (page), GTK_WIDGET (group3));
     gtk_container_add (GTK_CONTAINER (page), GTK_WIDGET (group2));
 
     gtk_container_add (GTK_CONTAINER (self), GTK_WIDGET (page));
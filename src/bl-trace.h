@@ -0,0 +1,58 @@
+/* bl-trace.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "bluedit-config.h"
+
+// Tracepoints for hot paths. With `-Dtracing=disabled` they compile
+// to nothing and their arguments are never evaluated. Otherwise each
+// one is a structured log record: the event name is the message and
+// values are attached as raw fields, so nothing is formatted.
+//
+//   BL_TRACE ("highlight-pass",
+//             BL_TRACE_INT ("BL_START_LINE", start),
+//             BL_TRACE_STR ("BL_KIND", "full"));
+
+#if BLUEDIT_TRACING
+
+#define BL_TRACE_DOMAIN "bluedit-trace"
+
+#define BL_TRACE_INT(key, value) { (key), &(gint){ (value) }, sizeof (gint) }
+#define BL_TRACE_STR(key, value) { (key), (value), -1 }
+
+#define BL_TRACE(event, ...)                                            \
+    G_STMT_START {                                                      \
+        const GLogField bl_trace_fields[] = {                           \
+            { "MESSAGE", (event), -1 },                                 \
+            { "GLIB_DOMAIN", BL_TRACE_DOMAIN, -1 },                     \
+            __VA_ARGS__                                                 \
+        };                                                              \
+        g_log_structured_array (G_LOG_LEVEL_DEBUG, bl_trace_fields,     \
+                                G_N_ELEMENTS (bl_trace_fields));        \
+    } G_STMT_END
+
+#else
+
+#define BL_TRACE(event, ...) G_STMT_START { } G_STMT_END
+
+#endif
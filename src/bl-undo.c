@@ -0,0 +1,520 @@
+/* bl-undo.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bl-undo.h"
+
+#define NO_POSITION G_MAXUINT64
+
+enum
+{
+    OP_INSERT,
+    OP_DELETE
+};
+
+typedef struct
+{
+    guint8 type;
+    gint offset;
+    gint chars;
+
+    // Bytes of text from `text` onwards in the text log
+    gsize text;
+    gsize length;
+} UndoOp;
+
+// Operations [first_op, end_op) of the operation log, and the memory
+// they take up along with the group itself
+typedef struct
+{
+    guint64 id;
+    gsize first_op;
+    gsize end_op;
+    gsize size;
+} UndoGroup;
+
+struct _BlUndo
+{
+    // Operations and the text they carry. Indices into both logs are
+    // counted from the start of the history, so they stay put when
+    // the dropped front of a log is compacted away.
+    GArray *ops;
+    gsize ops_base;
+    GByteArray *text;
+    gsize text_base;
+
+    // Groups from `first_group` onwards are live. The first `n_applied`
+    // of those are in the buffer and the rest can be redone.
+    GArray *groups;
+    guint first_group;
+    guint n_applied;
+
+    // The position of a state is the id of the last group applied, or
+    // `floor` if there is none: the id of the last group dropped.
+    guint64 next_id;
+    guint64 floor;
+    guint64 saved;
+
+    gsize size;
+    gsize limit;
+
+    // Grouping. An open group takes further keystrokes landing at
+    // `next_offset`, until a word ends.
+    gboolean in_action;
+    guint64 action_group;
+    gboolean open;
+    guint8 open_type;
+    gint next_offset;
+    gunichar last_char;
+};
+
+BlUndo *
+bl_undo_new (gsize limit)
+{
+    BlUndo *self = g_new0 (BlUndo, 1);
+    self->ops = g_array_new (FALSE, FALSE, sizeof (UndoOp));
+    self->text = g_byte_array_new ();
+    self->groups = g_array_new (FALSE, FALSE, sizeof (UndoGroup));
+    self->next_id = 1;
+    self->limit = limit;
+
+    // An empty document has nothing to save
+    self->saved = self->floor;
+    return self;
+}
+
+void
+bl_undo_free (BlUndo *self)
+{
+    g_array_free (self->ops, TRUE);
+    g_byte_array_free (self->text, TRUE);
+    g_array_free (self->groups, TRUE);
+    g_free (self);
+}
+
+static guint
+n_live (BlUndo *self)
+{
+    return self->groups->len - self->first_group;
+}
+
+static UndoGroup *
+get_group (BlUndo *self,
+           guint   index)
+{
+    return &g_array_index (self->groups, UndoGroup, self->first_group + index);
+}
+
+static UndoOp *
+get_op (BlUndo *self,
+        gsize   index)
+{
+    return &g_array_index (self->ops, UndoOp, index - self->ops_base);
+}
+
+static const gchar *
+get_text (BlUndo *self,
+          UndoOp *op)
+{
+    return (const gchar *) self->text->data + (op->text - self->text_base);
+}
+
+static guint64
+get_position (BlUndo *self)
+{
+    if (self->n_applied == 0)
+        return self->floor;
+
+    return get_group (self, self->n_applied - 1)->id;
+}
+
+// Releases the dropped front of each log once it outweighs the rest,
+// so every byte is moved a bounded number of times
+static void
+compact (BlUndo *self)
+{
+    if (n_live (self) == 0)
+    {
+        g_array_set_size (self->groups, 0);
+        g_array_set_size (self->ops, 0);
+        g_byte_array_set_size (self->text, 0);
+        self->first_group = 0;
+        self->ops_base = 0;
+        self->text_base = 0;
+        return;
+    }
+
+    if (self->first_group > self->groups->len / 2)
+    {
+        g_array_remove_range (self->groups, 0, self->first_group);
+        self->first_group = 0;
+    }
+
+    gsize first_op = get_group (self, 0)->first_op;
+    gsize dead_text = get_op (self, first_op)->text - self->text_base;
+    gsize dead_ops = first_op - self->ops_base;
+
+    if (dead_text > self->text->len / 2)
+    {
+        g_byte_array_remove_range (self->text, 0, dead_text);
+        self->text_base += dead_text;
+    }
+
+    if (dead_ops > self->ops->len / 2)
+    {
+        g_array_remove_range (self->ops, 0, dead_ops);
+        self->ops_base += dead_ops;
+    }
+}
+
+// Forgets the groups that could be redone
+static void
+drop_redo (BlUndo *self)
+{
+    if (self->n_applied == n_live (self))
+        return;
+
+    UndoGroup *first = get_group (self, self->n_applied);
+    UndoOp *op = get_op (self, first->first_op);
+
+    g_byte_array_set_size (self->text, op->text - self->text_base);
+    g_array_set_size (self->ops, first->first_op - self->ops_base);
+
+    for (guint i = self->n_applied; i < n_live (self); i++)
+        self->size -= get_group (self, i)->size;
+
+    g_array_set_size (self->groups, self->first_group + self->n_applied);
+
+    // Only those groups led to states past the current one
+    if (self->saved > get_position (self))
+        self->saved = NO_POSITION;
+
+    compact (self);
+}
+
+static void
+drop_oldest (BlUndo *self)
+{
+    g_assert (self->n_applied > 0);
+
+    UndoGroup *group = get_group (self, 0);
+    self->floor = group->id;
+    self->size -= group->size;
+
+    if (self->action_group == group->id)
+        self->action_group = 0;
+
+    self->first_group++;
+    self->n_applied--;
+
+    if (self->n_applied == 0)
+        self->open = FALSE;
+
+    compact (self);
+}
+
+static void
+enforce_limit (BlUndo *self)
+{
+    if (self->limit == 0)
+        return;
+
+    while (self->size > self->limit && n_live (self) > 0)
+    {
+        if (self->n_applied > 0)
+            drop_oldest (self);
+        else
+            drop_redo (self);
+    }
+}
+
+void
+bl_undo_set_limit (BlUndo *self,
+                   gsize   limit)
+{
+    self->limit = limit;
+    enforce_limit (self);
+}
+
+void
+bl_undo_clear (BlUndo *self)
+{
+    self->first_group = self->groups->len;
+    self->n_applied = 0;
+    self->size = 0;
+    compact (self);
+
+    self->floor = self->next_id++;
+    self->saved = NO_POSITION;
+    self->action_group = 0;
+    self->open = FALSE;
+}
+
+void
+bl_undo_begin_action (BlUndo *self)
+{
+    self->in_action = TRUE;
+    self->action_group = 0;
+}
+
+void
+bl_undo_end_action (BlUndo *self)
+{
+    self->in_action = FALSE;
+    self->action_group = 0;
+}
+
+// Whether a single character typed or deleted at `offset` carries on
+// the word in the open group
+static gboolean
+continues_group (BlUndo   *self,
+                 guint8    type,
+                 gint      offset,
+                 gunichar  c)
+{
+    if (!self->open || self->open_type != type)
+        return FALSE;
+
+    // Typing moves forwards, while deleting either backspaces towards
+    // the start or deletes forwards from the same place
+    if (type == OP_INSERT && offset != self->next_offset)
+        return FALSE;
+
+    if (type == OP_DELETE && offset != self->next_offset && offset + 1 != self->next_offset)
+        return FALSE;
+
+    // A word ends where whitespace gives way to anything else
+    return !g_unichar_isspace (self->last_char) || g_unichar_isspace (c);
+}
+
+static void
+record (BlUndo      *self,
+        guint8       type,
+        gint         offset,
+        const gchar *text,
+        gsize        length)
+{
+    if (length == 0)
+        return;
+
+    drop_redo (self);
+
+    gint chars = g_utf8_strlen (text, length);
+    gunichar c = g_utf8_get_char (text);
+    gboolean keystroke = chars == 1 && c != '\n';
+    gboolean first_in_action = self->action_group == 0;
+    UndoGroup *group = NULL;
+
+    if (self->n_applied > 0)
+    {
+        UndoGroup *top = get_group (self, self->n_applied - 1);
+
+        // Everything in a user action is undone at once
+        if (self->in_action && self->action_group == top->id)
+            group = top;
+        else if (keystroke && continues_group (self, type, offset, c))
+            group = top;
+    }
+
+    if (group == NULL)
+    {
+        UndoGroup added;
+        added.id = self->next_id++;
+        added.first_op = self->ops_base + self->ops->len;
+        added.end_op = added.first_op;
+        added.size = sizeof (UndoGroup);
+
+        g_array_append_val (self->groups, added);
+        self->n_applied++;
+        self->size += added.size;
+        group = get_group (self, self->n_applied - 1);
+    }
+
+    if (self->in_action)
+        self->action_group = group->id;
+
+    UndoOp op;
+    op.type = type;
+    op.offset = offset;
+    op.chars = chars;
+    op.text = self->text_base + self->text->len;
+    op.length = length;
+
+    g_array_append_val (self->ops, op);
+    g_byte_array_append (self->text, (const guint8 *) text, length);
+    group->end_op++;
+    group->size += sizeof (UndoOp) + length;
+    self->size += sizeof (UndoOp) + length;
+
+    // Pastes and other multi-part actions are never added to
+    self->open = keystroke && (!self->in_action || first_in_action);
+    self->open_type = type;
+    self->next_offset = type == OP_INSERT ? offset + 1 : offset;
+    self->last_char = c;
+
+    enforce_limit (self);
+}
+
+void
+bl_undo_insert (BlUndo      *self,
+                gint         offset,
+                const gchar *text,
+                gsize        length)
+{
+    record (self, OP_INSERT, offset, text, length);
+}
+
+void
+bl_undo_delete (BlUndo      *self,
+                gint         offset,
+                const gchar *text,
+                gsize        length)
+{
+    record (self, OP_DELETE, offset, text, length);
+}
+
+gboolean
+bl_undo_can_undo (BlUndo *self)
+{
+    return self->n_applied > 0;
+}
+
+gboolean
+bl_undo_can_redo (BlUndo *self)
+{
+    return self->n_applied < n_live (self);
+}
+
+gboolean
+bl_undo_undo (BlUndo        *self,
+              GtkTextBuffer *buffer)
+{
+    if (self->n_applied == 0)
+        return FALSE;
+
+    // Moved first, so anything watching the buffer already sees the
+    // position being returned to
+    UndoGroup group = *get_group (self, --self->n_applied);
+    self->open = FALSE;
+
+    for (gsize i = group.end_op; i > group.first_op; i--)
+    {
+        UndoOp *op = get_op (self, i - 1);
+        GtkTextIter start;
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, op->offset);
+
+        if (op->type == OP_INSERT)
+        {
+            GtkTextIter end;
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, op->offset + op->chars);
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+        else
+        {
+            gtk_text_buffer_insert (buffer, &start, get_text (self, op), op->length);
+        }
+
+        gtk_text_buffer_place_cursor (buffer, &start);
+    }
+
+    return TRUE;
+}
+
+gboolean
+bl_undo_redo (BlUndo        *self,
+              GtkTextBuffer *buffer)
+{
+    if (self->n_applied == n_live (self))
+        return FALSE;
+
+    UndoGroup group = *get_group (self, self->n_applied++);
+    self->open = FALSE;
+
+    for (gsize i = group.first_op; i < group.end_op; i++)
+    {
+        UndoOp *op = get_op (self, i);
+        GtkTextIter start;
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, op->offset);
+
+        if (op->type == OP_INSERT)
+        {
+            gtk_text_buffer_insert (buffer, &start, get_text (self, op), op->length);
+        }
+        else
+        {
+            GtkTextIter end;
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, op->offset + op->chars);
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+
+        gtk_text_buffer_place_cursor (buffer, &start);
+    }
+
+    return TRUE;
+}
+
+guint64
+bl_undo_checkpoint (BlUndo *self)
+{
+    // Typing on would change the state without moving the position
+    self->open = FALSE;
+    return get_position (self);
+}
+
+// Whether `position` is the current state or one the history can
+// move to. Live ids only ever increase, so they can be searched.
+static gboolean
+is_reachable (BlUndo  *self,
+              guint64  position)
+{
+    if (position == self->floor)
+        return TRUE;
+
+    guint low = 0;
+    guint high = n_live (self);
+
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+        guint64 id = get_group (self, mid)->id;
+
+        if (id == position)
+            return TRUE;
+
+        if (id < position)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return FALSE;
+}
+
+void
+bl_undo_set_saved (BlUndo  *self,
+                   guint64  position)
+{
+    self->saved = is_reachable (self, position) ? position : NO_POSITION;
+}
+
+gboolean
+bl_undo_is_saved (BlUndo *self)
+{
+    return self->saved == get_position (self);
+}
@@ -0,0 +1,80 @@
+/* bl-undo.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+// Undo history for a text buffer. Edits are grouped the way they
+// would be undone: consecutive keystrokes merge into one group per
+// word, and everything inside a user action forms a single group.
+// Operations and their text are packed into flat logs, and once the
+// history is over its memory limit the oldest groups are dropped.
+//
+// Every state the history can return to has a position, so a state
+// recorded as saved is recognised when edits are undone back to it.
+typedef struct _BlUndo BlUndo;
+
+// `limit` is in bytes, or zero for none
+BlUndo *   bl_undo_new           (gsize          limit);
+void       bl_undo_free          (BlUndo        *self);
+void       bl_undo_set_limit     (BlUndo        *self,
+                                  gsize          limit);
+
+// Forgets every group. The current state becomes the oldest one.
+void       bl_undo_clear         (BlUndo        *self);
+
+void       bl_undo_begin_action  (BlUndo        *self);
+void       bl_undo_end_action    (BlUndo        *self);
+
+// Records an edit about to be made, at a character offset. `text` is
+// what is inserted, or what is about to be deleted.
+void       bl_undo_insert        (BlUndo        *self,
+                                  gint           offset,
+                                  const gchar   *text,
+                                  gsize          length);
+void       bl_undo_delete        (BlUndo        *self,
+                                  gint           offset,
+                                  const gchar   *text,
+                                  gsize          length);
+
+gboolean   bl_undo_can_undo      (BlUndo        *self);
+gboolean   bl_undo_can_redo      (BlUndo        *self);
+
+// Reverts or reapplies one group on `buffer`. The caller must not
+// record the edits this makes.
+gboolean   bl_undo_undo          (BlUndo        *self,
+                                  GtkTextBuffer *buffer);
+gboolean   bl_undo_redo          (BlUndo        *self,
+                                  GtkTextBuffer *buffer);
+
+// Ends the current group so later typing starts a new one, and
+// returns the position of the current state
+guint64    bl_undo_checkpoint    (BlUndo        *self);
+
+// Records the state at `position` as the one on disk. Positions the
+// history can no longer reach are ignored.
+void       bl_undo_set_saved     (BlUndo        *self,
+                                  guint64        position);
+gboolean   bl_undo_is_saved      (BlUndo        *self);
+
+G_END_DECLS
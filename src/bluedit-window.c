@@ -21,6 +21,7 @@
 #include "bluedit-config.h"
 #include "bluedit-window.h"
 #include "bl-multi-editor.h"
+#include "bl-document-registry.h"
 #include "views/bl-editor.h"
 #include "views/bl-view.h"
 #include "bl-preferences.h"
@@ -35,9 +36,14 @@ struct _BlueditWindow
     GtkApplicationWindow  parent_instance;
 
     GList* open_documents;
+    BlDocumentRegistry *registry;
     BlMultiEditor* multi_editor;
+    GSettings *settings;
 
+    // One row per open document, found through `rows`
     GtkTreeView* tree;
+    GtkListStore *store;
+    GHashTable *rows;
 
     /* Template widgets */
     GtkHeaderBar*       header_bar;
@@ -61,6 +67,20 @@ enum
 static guint signals[LAST_SIGNAL];
 
 
+static void
+bluedit_window_finalize (GObject *object)
+{
+    BlueditWindow *self = BLUEDIT_WINDOW (object);
+
+    bl_document_registry_free (self->registry);
+    g_list_free (self->open_documents);
+    g_hash_table_destroy (self->rows);
+    g_object_unref (self->store);
+    g_object_unref (self->settings);
+
+    G_OBJECT_CLASS (bluedit_window_parent_class)->finalize (object);
+}
+
 static void
 bluedit_window_class_init (BlueditWindowClass *klass)
 {
@@ -75,6 +95,7 @@ bluedit_window_class_init (BlueditWindowClass *klass)
     gtk_widget_class_bind_template_child (widget_class, BlueditWindow, popover);
 
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    object_class->finalize = bluedit_window_finalize;
 
     signals[DOC_ADDED] =
         g_signal_newv ("doc-added",
@@ -113,10 +134,67 @@ bluedit_window_class_init (BlueditWindowClass *klass)
                  NULL  /* param_types */);
 }
 
+static void
+update_row (BlueditWindow *window,
+            BlDocument    *document)
+{
+    GtkTreeIter *iter = g_hash_table_lookup (window->rows, document);
+
+    if (iter == NULL)
+        return;
+
+    // This will either be the file name,
+    // or "Untitled Document' depending on
+    // whether the file actually exists.
+    gchar *basename = bl_document_get_basename (document);
+    gtk_list_store_set (window->store, iter, 0, basename, -1);
+    g_free (basename);
+}
+
+static void
+add_row (BlueditWindow *window,
+         BlDocument    *document)
+{
+    // List store iters stay valid for as long as their row exists
+    GtkTreeIter *iter = g_new (GtkTreeIter, 1);
+    gtk_list_store_insert_with_values (window->store, iter, -1,
+                                       1, document,
+                                       -1);
+    g_hash_table_insert (window->rows, document, iter);
+    update_row (window, document);
+}
+
+static void
+remove_row (BlueditWindow *window,
+            BlDocument    *document)
+{
+    GtkTreeIter *iter = g_hash_table_lookup (window->rows, document);
+
+    if (iter == NULL)
+        return;
+
+    gtk_list_store_remove (window->store, iter);
+    g_hash_table_remove (window->rows, document);
+}
+
+static void
+cb_document_saved (BlDocument    *document,
+                   BlueditWindow *window)
+{
+    // Saving As renames the document, and any save gives the file
+    // a new inode
+    bl_document_registry_add (window->registry, document);
+    update_row (window, document);
+}
+
 BlDocument *bluedit_window_new_document (BlueditWindow *window)
 {
     BlDocument *document = bl_document_new_untitled ();
-    window->open_documents = g_list_append(window->open_documents, document);
+    window->open_documents = g_list_prepend(window->open_documents, document);
+    add_row (window, document);
+
+    g_signal_connect (document, "saved",
+                      G_CALLBACK (cb_document_saved), window);
 
     // Log it
     g_debug("Opened Document");
@@ -139,37 +217,26 @@ BlDocument* bluedit_window_open_document (BlueditWindow* window, BlDocument* doc
         return FALSE;
     }
 
-    // Get the list of open documents
-    GList* open = bluedit_window_get_open_documents (window);
-
     // Now, see if the file is already open
-    GList* elem;
-    for (elem = open; elem != NULL; elem = elem->next)
-    {
-        if (bl_document_is_untitled (elem->data))
-            continue;
-
-        // This is the file corresponding to the iterator
-        GFile* existing_file = bl_document_get_file (elem->data);
+    BlDocument *existing = bl_document_registry_lookup (window->registry, file);
 
-        g_debug("Current file: %s", g_file_get_path(file));
-        g_debug("Existing file: %s", g_file_get_path(existing_file));
-
-        // Compare file paths
-        if (strcmp(g_file_get_path(file), g_file_get_path(existing_file)) == 0)
-        {
-            // Log
-            g_debug("File already open");
-            // TODO: Move to front?
-            // Alternatively, reveal in Project Explorer
+    if (existing != NULL)
+    {
+        // Log
+        g_debug("File already open");
+        // TODO: Move to front?
+        // Alternatively, reveal in Project Explorer
 
-            // Return the already loaded document
-            return elem->data;
-        }
+        // Return the already loaded document
+        return existing;
     }
 
     // Everything is fine, add to list
-    window->open_documents = g_list_append(window->open_documents, document);
+    window->open_documents = g_list_prepend(window->open_documents, document);
+    bl_document_registry_add (window->registry, document);
+    add_row (window, document);
+    g_signal_connect (document, "saved",
+                      G_CALLBACK (cb_document_saved), window);
 
     // Log it
     g_debug("Opened Document");
@@ -181,6 +248,15 @@ BlDocument* bluedit_window_open_document (BlueditWindow* window, BlDocument* doc
     return document;
 }
 
+static void
+cb_document_loaded (BlDocument    *document,
+                    BlueditWindow *window)
+{
+    // A failed or cancelled load leaves nothing worth keeping open
+    if (bl_document_get_load_error (document) != NULL)
+        bluedit_window_close_document (window, document);
+}
+
 // This function returns NULL if the document has already been loaded
 // or if it is invalid
 BlDocument* bluedit_window_open_document_from_file (BlueditWindow* window, GFile* file)
@@ -188,12 +264,33 @@ BlDocument* bluedit_window_open_document_from_file (BlueditWindow* window, GFile
     g_assert(BLUEDIT_IS_WINDOW(window));
     g_assert(G_IS_FILE(file));
 
-    // Create document from file
-    BlDocument* document = bl_document_new_from_file(file);
+    // Already open, so there is no need to start loading it again
+    BlDocument *existing = bl_document_registry_lookup (window->registry, file);
+
+    if (existing != NULL)
+        return existing;
+
+    // Very large files are opened read-only straight from disk
+    gdouble threshold = g_settings_get_double (window->settings, "mapped-threshold");
+
+    // Create document from file. It is loaded in the background.
+    BlDocument* document = bl_document_new_from_file(file, (gsize)(threshold * 1024 * 1024));
 
     // Load document
-    return bluedit_window_open_document(window, document);
+    BlDocument *opened = bluedit_window_open_document(window, document);
+
+    // Already open elsewhere
+    if (opened != document)
+    {
+        bl_document_cancel_load (document);
+        g_object_unref (document);
+        return opened;
+    }
 
+    g_signal_connect (document, "loaded",
+                      G_CALLBACK (cb_document_loaded), window);
+
+    return document;
 }
 
 void bluedit_window_close_document (BlueditWindow* window, BlDocument* document)
@@ -205,7 +302,12 @@ void bluedit_window_close_document (BlueditWindow* window, BlDocument* document)
         g_critical ("Unsaved file closed!");
     }
 
+    // Closing is not a crash, so nothing is recovered next time
+    bl_document_discard_journal (document);
+
     window->open_documents = g_list_remove(window->open_documents, document);
+    bl_document_registry_remove (window->registry, document);
+    remove_row (window, document);
 
     g_debug("Closed File");
 
@@ -216,6 +318,81 @@ void bluedit_window_close_document (BlueditWindow* window, BlDocument* document)
     g_signal_emit (window, signals[DOC_CLOSED], 0);
 }
 
+static void
+recover_document (BlDocument        *document,
+                  BlJournalRecovery *recovery)
+{
+    GError *error = NULL;
+
+    // Nowhere to replay the edits if the file has gone, so the journal
+    // is left for next time
+    if (bl_document_get_load_error (document) != NULL)
+    {
+        g_warning ("Could not recover unsaved changes: %s",
+                   bl_document_get_load_error (document)->message);
+        bl_journal_recovery_free (recovery);
+        return;
+    }
+
+    // Otherwise the document keeps the journal, and its editor shows why
+    if (!bl_document_recover (document, recovery, &error))
+    {
+        g_warning ("Could not recover unsaved changes: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+cb_recovery_loaded (BlDocument        *document,
+                    BlJournalRecovery *recovery)
+{
+    g_signal_handlers_disconnect_by_func (document, cb_recovery_loaded, recovery);
+    recover_document (document, recovery);
+}
+
+// Reopens documents left with unsaved changes by a crash, replaying
+// their journals over what is on disk. The journals of a running
+// instance are still live, so this only happens for the first window.
+static void
+recover_documents (BlueditWindow *self)
+{
+    static gboolean recovered = FALSE;
+
+    if (recovered)
+        return;
+
+    recovered = TRUE;
+
+    GList *recoveries = bl_journal_find_recoveries ();
+
+    for (GList *elem = recoveries; elem != NULL; elem = elem->next)
+    {
+        BlJournalRecovery *recovery = elem->data;
+        const gchar *uri = bl_journal_recovery_get_uri (recovery);
+
+        if (uri == NULL)
+        {
+            recover_document (bluedit_window_new_document (self), recovery);
+            continue;
+        }
+
+        GFile *file = g_file_new_for_uri (uri);
+        BlDocument *document = bluedit_window_open_document_from_file (self, file);
+        g_object_unref (file);
+
+        // The edits need the saved file underneath them
+        bl_document_ensure_loaded (document);
+
+        if (bl_document_is_loading (document))
+            g_signal_connect (document, "loaded",
+                              G_CALLBACK (cb_recovery_loaded), recovery);
+        else
+            recover_document (document, recovery);
+    }
+
+    g_list_free (recoveries);
+}
+
 static void
 action_open_document (BlueditWindow *self)
 {
@@ -227,15 +404,20 @@ action_open_document (BlueditWindow *self)
                                            GTK_WINDOW(self), action,
                                            "Open", "Cancel");
 
+    // Documents are only read once they are shown, so opening
+    // many at once is cheap
+    gtk_file_chooser_set_select_multiple (GTK_FILE_CHOOSER (dialogue), TRUE);
+
     result = gtk_native_dialog_run (dialogue);
     if (result == GTK_RESPONSE_ACCEPT)
     {
-        char *path;
         GtkFileChooser *chooser = GTK_FILE_CHOOSER(dialogue);
-        path = gtk_file_chooser_get_filename(chooser);
-        GFile *file = g_file_new_for_path (path);
-        bluedit_window_open_document_from_file (self, file);
-        g_free(path);
+        GSList *files = gtk_file_chooser_get_files (chooser);
+
+        for (GSList *elem = files; elem != NULL; elem = elem->next)
+            bluedit_window_open_document_from_file (self, G_FILE (elem->data));
+
+        g_slist_free_full (files, g_object_unref);
     }
 
     g_object_unref (dialogue);
@@ -283,42 +465,29 @@ GList* bluedit_window_get_open_documents (BlueditWindow* window)
     return window->open_documents;
 }
 
-void update_tree(BlueditWindow* window)
+// Returns GObject to fix nasty circular dependency
+GObject* bluedit_window_get_multi(BlueditWindow* self)
 {
-    g_debug("File added or removed");
-    GList* documents = bluedit_window_get_open_documents(window);
-    GtkTreeIter iter;
-    GtkListStore* store = gtk_list_store_new(2,
-                                             G_TYPE_STRING,
-                                             BL_TYPE_DOCUMENT);
-
-    // Iterate
-    GList* elem;
-    for (elem = documents; elem != NULL; elem = elem->next)
-    {
-        BlDocument* doc = elem->data;
-
-        // This will either be the file name,
-        // or "Untitled Document' depending on
-        // whether the file actually exists.
-        gchar* basename = bl_document_get_basename (doc);
-
-        g_debug("%s", basename);
-
-        gtk_list_store_append (store, &iter);
-        gtk_list_store_set (store, &iter,
-                            0, basename,
-                            1, doc,
-                            -1);
-    }
+    return G_OBJECT(self->multi_editor);
+}
 
-    gtk_tree_view_set_model(window->tree, GTK_TREE_MODEL(store));
+// Unsaved changes are only recovered after a crash, not once the
+// user has chosen to discard them
+static void
+discard_journals (BlueditWindow *self)
+{
+    for (GList *elem = self->open_documents; elem != NULL; elem = elem->next)
+        bl_document_discard_journal (BL_DOCUMENT (elem->data));
 }
 
-// Returns GObject to fix nasty circular dependency
-GObject* bluedit_window_get_multi(BlueditWindow* self)
+static void
+cb_close_after_save (BlDocument    *doc,
+                     BlueditWindow *self)
 {
-    return G_OBJECT(self->multi_editor);
+    // Only this attempt is retried. If the user then cancels the close,
+    // later saves must not bring it back.
+    g_signal_handlers_disconnect_by_func (doc, cb_close_after_save, self);
+    gtk_window_close (GTK_WINDOW (self));
 }
 
 static gboolean
@@ -331,6 +500,19 @@ cb_close_window (GtkWidget *widget,
     GList *docs = bluedit_window_get_open_documents (self);
     GList *unsaved = NULL;
 
+    // Let any save in progress finish first, then try again
+    for (GList *elem = docs; elem != NULL; elem = elem->next)
+    {
+        if (bl_document_is_saving (BL_DOCUMENT (elem->data)))
+        {
+            // Repeated close attempts share a single retry
+            g_signal_handlers_disconnect_by_func (elem->data, cb_close_after_save, self);
+            g_signal_connect_object (elem->data, "saved",
+                                     G_CALLBACK (cb_close_after_save), self, 0);
+            return TRUE;
+        }
+    }
+
     for (GList *elem = docs; elem != NULL; elem = elem->next)
     {
         if (bl_document_unsaved_changes (BL_DOCUMENT (elem->data)))
@@ -361,6 +543,7 @@ cb_close_window (GtkWidget *widget,
             gtk_message_dialog_format_secondary_markup (GTK_MESSAGE_DIALOG (dialogue),
                                                       "The file <b>%s</b> has not been saved. Would you like to save this file before closing?",
                                                       filename);
+            g_free (filename);
         }
         else
         {
@@ -388,6 +571,7 @@ cb_close_window (GtkWidget *widget,
 
                 GtkWidget *check_box = gtk_check_button_new_with_label (filename);
                 gtk_list_box_insert (GTK_LIST_BOX (list_box), check_box, -1);
+                g_free (filename);
             }
 
             gtk_container_add (GTK_CONTAINER (content_area), content_box);
@@ -411,6 +595,7 @@ cb_close_window (GtkWidget *widget,
                 break;
 
             case GTK_RESPONSE_CLOSE:
+                discard_journals (self);
                 return FALSE;
                 break;
 
@@ -422,6 +607,7 @@ cb_close_window (GtkWidget *widget,
     }
 
     // Close the window
+    discard_journals (self);
     return FALSE;
 }
 
@@ -457,6 +643,7 @@ void cb_focus_changed(BlMultiEditor* multi, BlueditWindow* self)
     BlDocument* doc = bl_multi_get_active_document (multi);
     gchar* basename = bl_document_get_basename(doc);
     gtk_header_bar_set_subtitle (self->header_bar, basename);
+    g_free (basename);
 }
 
 // Set the active BlDocument as the drag data
@@ -495,6 +682,7 @@ static void cb_drag_data_get (GtkTreeView      *view,
             // to rich text (e.g. with pandoc).
             gchar *contents = bl_document_get_contents (doc);
             gtk_selection_data_set_text (data, contents, -1);
+            g_free (contents);
             break;
         }
         case BL_TARGET_URI:
@@ -507,6 +695,7 @@ static void cb_drag_data_get (GtkTreeView      *view,
             gchar *uri = bl_document_get_uri (doc);
             gchar *uris[] = { uri, NULL };
             gtk_selection_data_set_uris (data, uris);
+            g_free (uri);
             break;
         }
         case BL_TARGET_DOC:
@@ -561,6 +750,40 @@ cb_accel_open (GtkAccelGroup   *group,
     return FALSE;
 }
 
+static gboolean
+cb_accel_undo (GtkAccelGroup   *group,
+               GObject         *acceleratable,
+               guint            keyval,
+               GdkModifierType  modifier)
+{
+    // Ctrl + Z has been pressed
+    BlueditWindow *window = BLUEDIT_WINDOW (acceleratable);
+    BlMultiEditor *multi = BL_MULTI_EDITOR (bluedit_window_get_multi (window));
+    BlDocument *doc = bl_multi_get_active_document (multi);
+
+    if (doc != NULL)
+        bl_document_undo (doc);
+
+    return TRUE;
+}
+
+static gboolean
+cb_accel_redo (GtkAccelGroup   *group,
+               GObject         *acceleratable,
+               guint            keyval,
+               GdkModifierType  modifier)
+{
+    // Ctrl + Shift + Z has been pressed
+    BlueditWindow *window = BLUEDIT_WINDOW (acceleratable);
+    BlMultiEditor *multi = BL_MULTI_EDITOR (bluedit_window_get_multi (window));
+    BlDocument *doc = bl_multi_get_active_document (multi);
+
+    if (doc != NULL)
+        bl_document_redo (doc);
+
+    return TRUE;
+}
+
 static void
 setup_accelerators (BlueditWindow *self)
 {
@@ -570,12 +793,18 @@ setup_accelerators (BlueditWindow *self)
     GClosure *save_closure = g_cclosure_new ((GCallback)cb_accel_save, NULL, NULL);
     GClosure *new_closure = g_cclosure_new ((GCallback)cb_accel_new, NULL, NULL);
     GClosure *open_closure = g_cclosure_new ((GCallback)cb_accel_open, NULL, NULL);
+    GClosure *undo_closure = g_cclosure_new ((GCallback)cb_accel_undo, NULL, NULL);
+    GClosure *redo_closure = g_cclosure_new ((GCallback)cb_accel_redo, NULL, NULL);
     gtk_accel_group_connect (group, gdk_keyval_from_name ("S"),
                              GDK_CONTROL_MASK, 0, save_closure);
     gtk_accel_group_connect (group, gdk_keyval_from_name ("N"),
                              GDK_CONTROL_MASK, 0, new_closure);
     gtk_accel_group_connect (group, gdk_keyval_from_name ("O"),
                              GDK_CONTROL_MASK, 0, open_closure);
+    gtk_accel_group_connect (group, gdk_keyval_from_name ("Z"),
+                             GDK_CONTROL_MASK, 0, undo_closure);
+    gtk_accel_group_connect (group, gdk_keyval_from_name ("Z"),
+                             GDK_CONTROL_MASK | GDK_SHIFT_MASK, 0, redo_closure);
     gtk_window_add_accel_group (GTK_WINDOW (self), group);
 
 }
@@ -617,6 +846,10 @@ bluedit_window_init (BlueditWindow *self)
 
     // Init open_documents GList
     self->open_documents = NULL;
+    self->registry = bl_document_registry_new ();
+    self->settings = g_settings_new ("com.mattjakeman.bluedit");
+    self->store = gtk_list_store_new (2, G_TYPE_STRING, BL_TYPE_DOCUMENT);
+    self->rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 
     // Manager singleton for splitscreen editing
     // This does not implement the actual split screen
@@ -636,8 +869,7 @@ bluedit_window_init (BlueditWindow *self)
     GtkWidget* paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
     gtk_box_pack_end(GTK_BOX(vbox), paned, TRUE, TRUE, 0);
 
-    GSettings *gsettings = g_settings_new ("com.mattjakeman.bluedit");
-    gboolean use_csd = !g_variant_get_boolean (g_settings_get_value (gsettings, "ssd"));
+    gboolean use_csd = !g_settings_get_boolean (self->settings, "ssd");
 
     GtkWidget *open_btn;
     GtkWidget *save_btn;
@@ -690,7 +922,7 @@ bluedit_window_init (BlueditWindow *self)
     // TODO: This box only has one thing in it
     GtkWidget* sidebar = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
 
-    GtkWidget* tree = gtk_tree_view_new();
+    GtkWidget* tree = gtk_tree_view_new_with_model (GTK_TREE_MODEL (self->store));
     gtk_box_pack_start(GTK_BOX(sidebar), tree, TRUE, TRUE, 0);
     self->tree = GTK_TREE_VIEW(tree);
 
@@ -728,10 +960,6 @@ bluedit_window_init (BlueditWindow *self)
     // Enable drag and drop signals
     g_signal_connect(G_OBJECT(tree), "drag-data-get", G_CALLBACK(cb_drag_data_get), NULL);
 
-    // Window file management signals
-    g_signal_connect(G_OBJECT(self), "doc-added", G_CALLBACK(update_tree), NULL);
-    g_signal_connect(G_OBJECT(self), "doc-closed", G_CALLBACK(update_tree), NULL);
-
     // Convenience wrapper around SplWorkspace from libsplit
     // This is fairly self contained and contains basically all of
     // the UI related code. See 'bl-workspace.c' for more.
@@ -757,4 +985,6 @@ bluedit_window_init (BlueditWindow *self)
     gtk_container_add(GTK_CONTAINER(self), vbox);
 
     gtk_widget_show_all(GTK_WIDGET(self));
+
+    recover_documents (self);
 }
@@ -31,6 +31,27 @@ struct _BlEditor
     BlMultiEditor *multi;
     GtkOverlay *overlay;
     GtkLabel *save_status;
+    GtkWidget *load_box;
+    GtkProgressBar *load_progress;
+
+    // Mapped Files
+    GtkScrolledWindow *scrolled_window;
+    GtkWidget *map_box;
+    GtkWidget *map_scrollbar;
+    GtkAdjustment *map_adjustment;
+
+    // Degraded Mode
+    GtkWidget *degraded_bar;
+    gboolean wrap;
+    gsize degrade_size;
+    guint degrade_line_length;
+
+    // Undo History
+    gsize undo_limit;
+
+    // Crash Recovery
+    GtkWidget *recovery_bar;
+    GtkLabel *recovery_label;
 
     // Current Document
     BlDocument *document;
@@ -39,6 +60,14 @@ struct _BlEditor
 
 G_DEFINE_TYPE (BlEditor, bl_editor, BL_TYPE_VIEW)
 
+// Lines of a mapped file held in the buffer at once, and roughly how
+// many of them fit on screen
+#define MAP_WINDOW_LINES 256
+#define MAP_PAGE_LINES 40
+
+// Top of the screen in the window of a mapped file
+#define MAP_TOP_MARK "bl-map-top"
+
 enum
 {
     VIEW_CLOSE,
@@ -86,7 +115,8 @@ update_save_label (BlDocument *doc,
     gboolean result = bl_document_unsaved_changes (doc);
     editor->saved = !result;
 
-    if (editor->saved)
+    // Text arriving from disk is not an unsaved change
+    if (editor->saved || (doc != NULL && bl_document_is_loading (doc)))
         gtk_widget_hide (GTK_WIDGET (editor->save_status));
     else
         gtk_widget_show (GTK_WIDGET (editor->save_status));
@@ -128,13 +158,10 @@ void bl_editor_save_file_as (BlEditor *editor)
 {
     BlDocument *doc = editor->document;
 
-    if (doc == NULL)
+    // Nothing to write until it is loaded, or while it is read-only
+    if (doc == NULL || bl_document_is_loading (doc) || bl_document_is_read_only (doc))
         return;
 
-    gboolean untitled = FALSE;
-    if (bl_document_is_untitled (doc))
-        untitled = TRUE;
-
     GtkWidget *dialogue;
     GtkFileChooser *chooser;
     GtkFileChooserAction action = GTK_FILE_CHOOSER_ACTION_SAVE;
@@ -155,20 +182,11 @@ void bl_editor_save_file_as (BlEditor *editor)
         char *filename;
         filename = gtk_file_chooser_get_filename (chooser);
 
+        // The document moves over to the new file once it has
+        // been written (see `cb_saved`)
         GFile *file = g_file_new_for_path (filename);
-        gchar* contents = bl_document_get_contents(doc);
-        gint len = strlen(contents);
-        g_file_replace_contents (file, contents, len, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, NULL);
-
-        BlueditWindow *window = BLUEDIT_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET (editor)));
-
-        // If untitled, close old file
-        if (untitled)
-            bluedit_window_close_document (window, editor->document);
-
-        // Then load new file
-        BlDocument *new_doc = bluedit_window_open_document_from_file (window, file);
-        bl_editor_load_file (editor, new_doc);
+        bl_document_save (doc, file);
+        g_object_unref (file);
 
         g_free (filename);
     }
@@ -221,6 +239,20 @@ create_transition (GtkWidget *widget,
     g_timeout_add (10, (GSourceFunc)update_transition, timeout);
 }
 
+// Briefly shows a message over the top of the editor
+static void
+show_message (BlEditor    *editor,
+              const gchar *message)
+{
+    GtkWidget *label = gtk_label_new (message);
+    gtk_widget_set_valign (label, GTK_ALIGN_START);
+    helper_set_widget_css_class (label, "save-label");
+    gtk_overlay_add_overlay (editor->overlay, label);
+    gtk_widget_show (label);
+
+    create_transition (label, 1, 0.5);
+}
+
 // Saves the file currently loaded in
 // the editor. If no file is set, it will
 // save as.
@@ -228,7 +260,8 @@ void bl_editor_save_file (BlEditor *editor)
 {
     BlDocument *doc = editor->document;
 
-    if (doc == NULL)
+    // Nothing to write until it is loaded, or while it is read-only
+    if (doc == NULL || bl_document_is_loading (doc) || bl_document_is_read_only (doc))
         return;
 
     GFile* file = bl_document_get_file (doc);
@@ -240,23 +273,323 @@ void bl_editor_save_file (BlEditor *editor)
         return;
     }
 
-    gchar* contents = bl_document_get_contents(doc);
-    gint len = strlen(contents);
-    g_file_replace_contents (file, contents, len, NULL, TRUE, G_FILE_CREATE_NONE, NULL, NULL, NULL);
+    // Written in the background. The save status is updated
+    // when it finishes.
+    bl_document_save (doc, NULL);
+}
 
-    // Update save status
-    editor->saved = TRUE;
-    bl_document_update_save_hash (doc);
-    gtk_widget_hide (GTK_WIDGET (editor->save_status));
+// Moves the window of a mapped document to start at `first`. The cursor
+// stays on the same line of the file if that is still in the window, and
+// otherwise waits at whichever end of it is nearest.
+static void
+move_map_window (BlEditor *self,
+                 guint     first)
+{
+    BlDocument *doc = self->document;
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
 
-    // Show Overlay
-    GtkWidget *label = gtk_label_new("File Saved");
-    gtk_widget_set_valign (label, GTK_ALIGN_START);
-    helper_set_widget_css_class (label, "save-label");
-    gtk_overlay_add_overlay (editor->overlay, label);
-    gtk_widget_show (label);
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+    gint cursor_line = bl_document_get_window_start (doc) + gtk_text_iter_get_line (&iter);
+    gint cursor_column = gtk_text_iter_get_line_offset (&iter);
 
-    create_transition (label, 1, 0.5);
+    bl_document_set_window (doc, first, MAP_WINDOW_LINES);
+    first = bl_document_get_window_start (doc);
+
+    // The line count firms up as more of the file is scanned
+    gtk_adjustment_set_upper (self->map_adjustment, bl_document_get_mapped_lines (doc));
+
+    gint line = CLAMP (cursor_line - (gint)first, 0,
+                       gtk_text_buffer_get_line_count (buffer) - 1);
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
+
+    GtkTextIter line_end = iter;
+    if (!gtk_text_iter_ends_line (&line_end))
+        gtk_text_iter_forward_to_line_end (&line_end);
+
+    gtk_text_iter_set_line_offset (&iter, MIN (cursor_column, gtk_text_iter_get_line_offset (&line_end)));
+    gtk_text_buffer_place_cursor (buffer, &iter);
+}
+
+static void
+cb_map_scrolled (GtkAdjustment *adjustment,
+                 BlEditor      *self)
+{
+    BlDocument *doc = self->document;
+
+    if (doc == NULL || !bl_document_is_mapped (doc))
+        return;
+
+    guint top = (guint)gtk_adjustment_get_value (adjustment);
+    guint first = bl_document_get_window_start (doc);
+
+    // Move the window once the screen would run off either end of it
+    if (top < first || top + MAP_PAGE_LINES > first + MAP_WINDOW_LINES)
+    {
+        move_map_window (self, top > MAP_WINDOW_LINES / 4 ? top - MAP_WINDOW_LINES / 4 : 0);
+        first = bl_document_get_window_start (doc);
+    }
+
+    // Scroll the view without touching the cursor, which may be
+    // where the user is typing
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, top > first ? top - first : 0);
+
+    GtkTextMark *mark = gtk_text_buffer_get_mark (buffer, MAP_TOP_MARK);
+
+    if (mark == NULL)
+        mark = gtk_text_buffer_create_mark (buffer, MAP_TOP_MARK, &iter, TRUE);
+    else
+        gtk_text_buffer_move_mark (buffer, mark, &iter);
+
+    gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (self->text_view), mark,
+                                  0, TRUE, 0, 0);
+}
+
+static void
+cb_map_move_cursor (GtkTextView     *text_view,
+                    GtkMovementStep  step,
+                    gint             count,
+                    gboolean         extend_selection,
+                    BlEditor        *self)
+{
+    BlDocument *doc = self->document;
+
+    if (doc == NULL || !bl_document_is_mapped (doc))
+        return;
+
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
+    GtkTextIter iter;
+    gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+
+    guint first = bl_document_get_window_start (doc);
+    gint line = gtk_text_iter_get_line (&iter);
+    gint last = gtk_text_buffer_get_line_count (buffer) - 1;
+
+    // The cursor has reached an end of the window with more of the file
+    // beyond it. Centre the window on it so it can keep going.
+    if (!(line == 0 && first > 0) &&
+        !(line == last && first + last + 1 < bl_document_get_mapped_lines (doc)))
+        return;
+
+    guint cursor_line = first + line;
+    move_map_window (self, cursor_line > MAP_WINDOW_LINES / 2 ? cursor_line - MAP_WINDOW_LINES / 2 : 0);
+    gtk_adjustment_set_value (self->map_adjustment,
+                              cursor_line > MAP_PAGE_LINES / 2 ? cursor_line - MAP_PAGE_LINES / 2 : 0);
+    gtk_text_view_scroll_mark_onscreen (text_view, gtk_text_buffer_get_insert (buffer));
+}
+
+static gboolean
+cb_map_scroll_event (GtkWidget      *widget,
+                     GdkEventScroll *event,
+                     BlEditor       *self)
+{
+    if (self->document == NULL || !bl_document_is_mapped (self->document))
+        return GDK_EVENT_PROPAGATE;
+
+    gdouble delta;
+
+    switch (event->direction)
+    {
+        case GDK_SCROLL_UP:
+            delta = -3;
+            break;
+
+        case GDK_SCROLL_DOWN:
+            delta = 3;
+            break;
+
+        case GDK_SCROLL_SMOOTH:
+            delta = event->delta_y * 3;
+            break;
+
+        default:
+            return GDK_EVENT_PROPAGATE;
+    }
+
+    gdouble value = gtk_adjustment_get_value (self->map_adjustment);
+    gtk_adjustment_set_value (self->map_adjustment, value + delta);
+
+    return GDK_EVENT_STOP;
+}
+
+static void update_load_state (BlEditor *self);
+
+static void
+cb_make_editable (GtkButton *btn, BlEditor *self)
+{
+    if (self->document == NULL || !bl_document_is_read_only (self->document))
+        return;
+
+    bl_document_make_editable (self->document);
+    update_load_state (self);
+}
+
+static void
+update_map_state (BlEditor *self)
+{
+    gboolean mapped = self->document != NULL && bl_document_is_mapped (self->document);
+    gboolean read_only = mapped && bl_document_is_read_only (self->document);
+
+    // Only part of a mapped file is in the buffer, so our own scrollbar
+    // stands in for the scrolled window's
+    gtk_widget_set_visible (self->map_box, read_only);
+    gtk_widget_set_visible (self->map_scrollbar, mapped);
+    gtk_scrolled_window_set_policy (self->scrolled_window, GTK_POLICY_AUTOMATIC,
+                                    mapped ? GTK_POLICY_EXTERNAL : GTK_POLICY_AUTOMATIC);
+
+    if (!mapped)
+        return;
+
+    guint n_lines = bl_document_get_mapped_lines (self->document);
+
+    g_signal_handlers_block_by_func (self->map_adjustment, cb_map_scrolled, self);
+    gtk_adjustment_configure (self->map_adjustment,
+                              bl_document_get_window_start (self->document),
+                              0, n_lines, 3, MAP_PAGE_LINES,
+                              MIN (MAP_PAGE_LINES, n_lines));
+    g_signal_handlers_unblock_by_func (self->map_adjustment, cb_map_scrolled, self);
+}
+
+static void
+update_load_state (BlEditor *self)
+{
+    gboolean loading = self->document != NULL && bl_document_is_loading (self->document);
+    gboolean read_only = self->document != NULL && bl_document_is_read_only (self->document);
+
+    // The buffer only takes text from the loader until it is done
+    gtk_widget_set_visible (self->load_box, loading);
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (self->text_view), !loading && !read_only);
+    update_map_state (self);
+
+    if (!loading)
+        return;
+
+    gdouble progress = bl_document_get_load_progress (self->document);
+
+    if (progress < 0)
+        gtk_progress_bar_pulse (self->load_progress);
+    else
+        gtk_progress_bar_set_fraction (self->load_progress, progress);
+}
+
+static void
+update_degraded_state (BlEditor *self)
+{
+    gboolean degraded = self->document != NULL && bl_document_is_degraded (self->document);
+
+    // Wrapping a very long line is as slow as highlighting it
+    gtk_widget_set_visible (self->degraded_bar, degraded);
+    gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (self->text_view),
+                                 self->wrap && !degraded ? GTK_WRAP_WORD : GTK_WRAP_NONE);
+}
+
+static void
+cb_degraded_changed (BlDocument *doc,
+                     BlEditor   *editor)
+{
+    update_degraded_state (editor);
+}
+
+static void
+cb_degraded_response (GtkInfoBar *bar,
+                      gint        response,
+                      BlEditor   *self)
+{
+    if (response == GTK_RESPONSE_ACCEPT && self->document != NULL)
+        bl_document_override_degraded (self->document);
+}
+
+static void
+update_recovery_state (BlEditor *self)
+{
+    const GError *error = self->document != NULL
+        ? bl_document_get_recovery_error (self->document)
+        : NULL;
+
+    if (error != NULL)
+    {
+        gchar *message = g_strdup_printf ("Unsaved changes from a previous session could not be recovered: %s. "
+                                          "They are kept in %s.",
+                                          error->message,
+                                          bl_document_get_recovery_path (self->document));
+        gtk_label_set_text (self->recovery_label, message);
+        g_free (message);
+    }
+
+    gtk_widget_set_visible (self->recovery_bar, error != NULL);
+}
+
+static void
+cb_recovery_changed (BlDocument *doc,
+                     BlEditor   *editor)
+{
+    update_recovery_state (editor);
+}
+
+static void
+cb_recovery_response (GtkInfoBar *bar,
+                      gint        response,
+                      BlEditor   *self)
+{
+    if (response == GTK_RESPONSE_REJECT && self->document != NULL)
+        bl_document_discard_recovery (self->document);
+}
+
+static void
+cb_load_progress (BlDocument *doc,
+                  BlEditor   *editor)
+{
+    update_load_state (editor);
+}
+
+static void
+cb_loaded (BlDocument *doc,
+           BlEditor   *editor)
+{
+    update_load_state (editor);
+    update_save_label (doc, editor);
+
+    const GError *error = bl_document_get_load_error (doc);
+
+    // The window closes the document if it could not be loaded
+    if (error != NULL && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        show_message (editor, error->message);
+}
+
+static void
+update_heading (BlEditor *self)
+{
+    gchar *basename = bl_document_get_basename (self->document);
+    gtk_label_set_text (self->file_label, basename);
+    g_free (basename);
+}
+
+static void
+cb_saved (BlDocument *doc,
+          BlEditor   *editor)
+{
+    const GError *error = bl_document_get_save_error (doc);
+
+    update_save_label (doc, editor);
+
+    if (error != NULL)
+    {
+        show_message (editor, error->message);
+        return;
+    }
+
+    // Save As gives the document a new name
+    update_heading (editor);
+    show_message (editor, "File Saved");
+}
+
+static void
+cb_cancel_load (GtkButton *btn, BlEditor *self)
+{
+    if (self->document != NULL)
+        bl_document_cancel_load (self->document);
 }
 
 // Close the active editor, unset self->document
@@ -268,9 +601,15 @@ void bl_editor_close_file (BlEditor *self)
     gtk_stack_set_visible_child_name (self->stack, "open-prompt");
     gtk_label_set_text (self->file_label, "No Open Files");
     bl_view_remove_decoration_style (BL_VIEW (self), "active-editor");
+    if (self->document != NULL)
+        g_signal_handlers_disconnect_by_data (self->document, self);
+
     self->document = NULL;
     self->saved = TRUE;
     update_save_label (NULL, self);
+    update_load_state (self);
+    update_degraded_state (self);
+    update_recovery_state (self);
 }
 
 static void
@@ -294,6 +633,10 @@ void bl_editor_load_file(BlEditor* self, BlDocument* document)
         gtk_stack_set_visible_child_name (self->stack, "edit-mode");
     }
 
+    // Stop following the previous document
+    if (self->document != NULL)
+        g_signal_handlers_disconnect_by_data (self->document, self);
+
     BlMarkdownView* view = self->text_view;
     GtkTextBuffer *text = bl_document_get_buffer (document);
     g_return_if_fail (GTK_IS_TEXT_BUFFER (text));
@@ -304,9 +647,33 @@ void bl_editor_load_file(BlEditor* self, BlDocument* document)
     self->saved = TRUE;
     g_signal_connect (bl_document_get_buffer (document), "changed",
                       (GCallback)cb_changed, self);
+    update_save_label (document, self);
+
+    // Loading. Files are only read once they are shown.
+    bl_document_ensure_loaded (document);
+    g_signal_connect (document, "load-progress",
+                      G_CALLBACK (cb_load_progress), self);
+    g_signal_connect (document, "loaded",
+                      G_CALLBACK (cb_loaded), self);
+    update_load_state (self);
+
+    g_signal_connect (document, "saved",
+                      G_CALLBACK (cb_saved), self);
+
+    // Large Documents
+    g_signal_connect (document, "degraded-changed",
+                      G_CALLBACK (cb_degraded_changed), self);
+    bl_document_set_degrade_limits (document, self->degrade_size, self->degrade_line_length);
+    bl_document_set_undo_limit (document, self->undo_limit);
+    update_degraded_state (self);
+
+    // Crash Recovery
+    g_signal_connect (document, "recovery-changed",
+                      G_CALLBACK (cb_recovery_changed), self);
+    update_recovery_state (self);
 
     // Update Heading
-    gtk_label_set_text (self->file_label, bl_document_get_basename (document));
+    update_heading (self);
 
     // Grab focus
     gtk_widget_grab_focus(GTK_WIDGET(self->text_view));
@@ -337,6 +704,7 @@ static void cb_drag_data(BlEditor* self, GdkDragContext* context, gint x, gint y
         {
             GFile* file = g_file_new_for_uri (*i);
             BlDocument* doc = bluedit_window_open_document_from_file (BLUEDIT_WINDOW(window), file);
+            g_object_unref (file);
 
             if (first_file == TRUE)
             {
@@ -488,8 +856,25 @@ cb_refresh_properties (BlueditWindow *window,
     GSettings *gsettings = g_settings_new ("com.mattjakeman.bluedit");
 
     // Wrap
-    gboolean wrap = g_variant_get_boolean (g_settings_get_value (gsettings, "word-wrap"));
-    gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (self->text_view), wrap ? GTK_WRAP_WORD : GTK_WRAP_NONE);
+    self->wrap = g_variant_get_boolean (g_settings_get_value (gsettings, "word-wrap"));
+
+    // Degraded Mode
+    gdouble degrade_size = g_variant_get_double (g_settings_get_value (gsettings, "degrade-size"));
+    gdouble degrade_line_length = g_variant_get_double (g_settings_get_value (gsettings, "degrade-line-length"));
+    self->degrade_size = (gsize)(degrade_size * 1024 * 1024);
+    self->degrade_line_length = (guint)degrade_line_length;
+
+    if (self->document != NULL)
+        bl_document_set_degrade_limits (self->document, self->degrade_size, self->degrade_line_length);
+
+    update_degraded_state (self);
+
+    // Undo History
+    gdouble undo_memory = g_variant_get_double (g_settings_get_value (gsettings, "undo-memory"));
+    self->undo_limit = (gsize)(undo_memory * 1024 * 1024);
+
+    if (self->document != NULL)
+        bl_document_set_undo_limit (self->document, self->undo_limit);
 
     // Font
     const gchar* font_name = g_variant_get_string (g_settings_get_value (gsettings, "default-font"), NULL);
@@ -497,6 +882,14 @@ cb_refresh_properties (BlueditWindow *window,
 
     gdouble spacing = g_variant_get_double (g_settings_get_value (gsettings, "line-spacing"));
     bl_markdown_view_set_line_spacing (self->text_view, spacing);
+
+    // Highlight Scheduling
+    guint debounce = g_variant_get_uint32 (g_settings_get_value (gsettings, "highlight-debounce"));
+    guint max_latency = g_variant_get_uint32 (g_settings_get_value (gsettings, "highlight-max-latency"));
+    bl_markdown_view_set_highlight_delay (self->text_view, debounce, max_latency);
+
+    gdouble budget = g_variant_get_double (g_settings_get_value (gsettings, "highlight-budget"));
+    bl_markdown_view_set_highlight_budget (self->text_view, budget);
 }
 
 // Essentially 'continues' from bl_editor_init, but only after the
@@ -554,6 +947,10 @@ bl_editor_init (BlEditor* self)
 {
     // Set saved
     self->saved = TRUE;
+    self->wrap = TRUE;
+    self->degrade_size = BL_DOCUMENT_DEFAULT_DEGRADE_SIZE;
+    self->degrade_line_length = BL_DOCUMENT_DEFAULT_DEGRADE_LINE_LENGTH;
+    self->undo_limit = BL_DOCUMENT_DEFAULT_UNDO_LIMIT;
 
     // Stack
     GtkWidget* stack = gtk_stack_new();
@@ -579,14 +976,32 @@ bl_editor_init (BlEditor* self)
 
     // Scrolled window so we can have
     // scrollbars in the text view
+    GtkWidget *content_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_pack_start (GTK_BOX (box), content_box, TRUE, TRUE, 0);
+
     GtkWidget* scrolled_window = gtk_scrolled_window_new(NULL, NULL);
-    gtk_box_pack_start(GTK_BOX(box), scrolled_window, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(content_box), scrolled_window, TRUE, TRUE, 0);
+    self->scrolled_window = GTK_SCROLLED_WINDOW (scrolled_window);
+
+    // Scrollbar for mapped files, in lines of the whole file
+    self->map_adjustment = gtk_adjustment_new (0, 0, 1, 3, MAP_PAGE_LINES, 1);
+    self->map_scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, self->map_adjustment);
+    gtk_box_pack_start (GTK_BOX (content_box), self->map_scrollbar, FALSE, FALSE, 0);
+    g_signal_connect (G_OBJECT (self->map_adjustment), "value-changed",
+                      G_CALLBACK (cb_map_scrolled), self);
 
     // The text view for inside the scrolled window
     GtkWidget* text_view = g_object_new(BL_TYPE_MARKDOWN_VIEW, NULL);
     gtk_container_add(GTK_CONTAINER(scrolled_window), text_view);
     self->text_view = BL_MARKDOWN_VIEW(text_view);
     gtk_widget_show_all (stack);
+    gtk_widget_hide (self->map_scrollbar);
+
+    gtk_widget_add_events (text_view, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect (G_OBJECT (text_view), "scroll-event",
+                      G_CALLBACK (cb_map_scroll_event), self);
+    g_signal_connect_after (G_OBJECT (text_view), "move-cursor",
+                            G_CALLBACK (cb_map_move_cursor), self);
 
     // Set BlView header
     GtkWidget *header_widget = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
@@ -601,6 +1016,36 @@ bl_editor_init (BlEditor* self)
     gtk_box_pack_start (GTK_BOX (header_widget),
                         save_status, FALSE, FALSE, 0);
 
+    // Shown for files that are too large to load in full
+    GtkWidget *map_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start (GTK_BOX (header_widget), map_box, FALSE, FALSE, 6);
+
+    GtkWidget *map_label = gtk_label_new ("Read Only");
+    helper_set_widget_css_class (map_label, "dim-label");
+    gtk_box_pack_start (GTK_BOX (map_box), map_label, FALSE, FALSE, 0);
+
+    GtkWidget *edit_button = gtk_button_new_with_label ("Edit");
+    gtk_widget_set_tooltip_text (edit_button, "Allow the file to be edited");
+    helper_set_widget_css_class (edit_button, "flat");
+    gtk_box_pack_start (GTK_BOX (map_box), edit_button, FALSE, FALSE, 0);
+    g_signal_connect (G_OBJECT (edit_button), "clicked",
+                      G_CALLBACK (cb_make_editable), self);
+
+    // Loading progress, shown while a file is streamed in
+    GtkWidget *load_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start (GTK_BOX (header_widget), load_box, TRUE, TRUE, 6);
+
+    GtkWidget *load_progress = gtk_progress_bar_new ();
+    gtk_widget_set_valign (load_progress, GTK_ALIGN_CENTER);
+    gtk_box_pack_start (GTK_BOX (load_box), load_progress, TRUE, TRUE, 0);
+
+    GtkWidget *cancel_button = gtk_button_new_from_icon_name ("process-stop-symbolic", GTK_ICON_SIZE_BUTTON);
+    gtk_widget_set_tooltip_text (cancel_button, "Stop Loading");
+    helper_set_widget_css_class (cancel_button, "flat");
+    gtk_box_pack_start (GTK_BOX (load_box), cancel_button, FALSE, FALSE, 0);
+    g_signal_connect (G_OBJECT (cancel_button), "clicked",
+                      G_CALLBACK (cb_cancel_load), self);
+
     GtkWidget *prop_button = gtk_toggle_button_new ();
     GtkWidget *menu_icon = gtk_image_new_from_icon_name ("open-menu-symbolic", GTK_ICON_SIZE_BUTTON);
     gtk_button_set_image (GTK_BUTTON (prop_button), menu_icon);
@@ -619,8 +1064,47 @@ bl_editor_init (BlEditor* self)
 
     gtk_widget_show_all (header_widget);
     gtk_widget_hide (save_status);
+    gtk_widget_hide (load_box);
+    gtk_widget_hide (map_box);
+    self->map_box = map_box;
     self->file_label = GTK_LABEL (file_label);
     self->save_status = GTK_LABEL (save_status);
+    self->load_box = load_box;
+    self->load_progress = GTK_PROGRESS_BAR (load_progress);
+
+    // Shown while the document is too large for the usual features
+    GtkWidget *degraded_bar = gtk_info_bar_new_with_buttons ("Turn On Anyway", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_info_bar_set_message_type (GTK_INFO_BAR (degraded_bar), GTK_MESSAGE_INFO);
+
+    GtkWidget *degraded_label = gtk_label_new ("This document is very large, so highlighting and word wrap are off.");
+    gtk_label_set_line_wrap (GTK_LABEL (degraded_label), TRUE);
+    gtk_label_set_xalign (GTK_LABEL (degraded_label), 0);
+    gtk_container_add (GTK_CONTAINER (gtk_info_bar_get_content_area (GTK_INFO_BAR (degraded_bar))),
+                       degraded_label);
+    gtk_widget_show (degraded_label);
+
+    bl_view_set_banner (BL_VIEW (self), degraded_bar);
+    g_signal_connect (G_OBJECT (degraded_bar), "response",
+                      G_CALLBACK (cb_degraded_response), self);
+    self->degraded_bar = degraded_bar;
+
+    // Shown while edits from a crash are left unrecovered
+    GtkWidget *recovery_bar = gtk_info_bar_new_with_buttons ("Discard", GTK_RESPONSE_REJECT, NULL);
+    gtk_info_bar_set_message_type (GTK_INFO_BAR (recovery_bar), GTK_MESSAGE_WARNING);
+
+    GtkWidget *recovery_label = gtk_label_new (NULL);
+    gtk_label_set_line_wrap (GTK_LABEL (recovery_label), TRUE);
+    gtk_label_set_xalign (GTK_LABEL (recovery_label), 0);
+    gtk_label_set_selectable (GTK_LABEL (recovery_label), TRUE);
+    gtk_container_add (GTK_CONTAINER (gtk_info_bar_get_content_area (GTK_INFO_BAR (recovery_bar))),
+                       recovery_label);
+    gtk_widget_show (recovery_label);
+
+    bl_view_set_banner (BL_VIEW (self), recovery_bar);
+    g_signal_connect (G_OBJECT (recovery_bar), "response",
+                      G_CALLBACK (cb_recovery_response), self);
+    self->recovery_bar = recovery_bar;
+    self->recovery_label = GTK_LABEL (recovery_label);
 
     // Rest of the initialisation is in the function `cb_on_realise`
     // as we need the widget to have been realised to get the toplevel
@@ -80,6 +80,16 @@ void bl_view_set_decoration_end (BlView *self, GtkWidget *widget)
     gtk_widget_show_all (widget);
 }
 
+// Shows `widget` between the header and the contents. It is left to
+// the caller to show and hide it.
+void bl_view_set_banner (BlView *self, GtkWidget *widget)
+{
+    BlViewPrivate *priv = bl_view_get_instance_private (self);
+    gtk_box_pack_start (GTK_BOX (priv->main_box), widget, FALSE, FALSE, 0);
+    gtk_box_reorder_child (GTK_BOX (priv->main_box), widget, 1);
+    gtk_widget_set_no_show_all (widget, TRUE);
+}
+
 void bl_view_set_menu (BlView *self, GtkWidget *widget, gboolean expand)
 {
     BlViewPrivate *priv = bl_view_get_instance_private (self);
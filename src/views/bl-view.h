@@ -37,6 +37,7 @@ void bl_view_set_contents (BlView *self, GtkWidget *widget);
 void bl_view_set_menu (BlView *self, GtkWidget *widget, gboolean expand);
 void bl_view_set_decoration_start (BlView *self, GtkWidget *widget);
 void bl_view_set_decoration_end (BlView *self, GtkWidget *widget);
+void bl_view_set_banner (BlView *self, GtkWidget *widget);
 void bl_view_set_decoration_style (BlView *self, gchar *css_class);
 void bl_view_remove_decoration_style (BlView *self, gchar *css_class);
 
@@ -656,6 +656,10 @@ static void cb_gesture_drag_end (GtkGestureDrag *gesture,
 
     SplWorkspacePrivate *priv = spl_workspace_get_instance_private (self);
 
+    // Edges are rebuilt whenever areas are split or joined, so don't
+    // hold on to one past the end of the drag
+    priv->last_edge = NULL;
+
     if (priv->last_area == NULL)
         return;
 
@@ -677,7 +681,6 @@ static void cb_gesture_drag_end (GtkGestureDrag *gesture,
     }
 
     priv->last_area = NULL;
-    priv->last_edge = NULL;
 }
 
 static void
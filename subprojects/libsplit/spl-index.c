@@ -0,0 +1,346 @@
+/* spl-index.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "spl-index.h"
+
+#include <string.h>
+
+typedef struct
+{
+    gdouble top;
+    SplArea *area;
+} SlabEntry;
+
+typedef struct
+{
+    // Position of the line the edge lies on, and where along it the
+    // edge starts and ends
+    gdouble line;
+    gdouble start, end;
+    SplEdge *edge;
+} EdgeEntry;
+
+struct _SplIndex
+{
+    // Sorted x positions at which slabs start and end
+    GArray *xs;
+
+    // Slab i holds `entries[offsets[i]]` up to `entries[offsets[i + 1]]`
+    GArray *offsets;
+    GArray *entries;
+
+    // Edges, by line and then by start
+    GArray *vertical;
+    GArray *horizontal;
+};
+
+SplIndex *
+spl_index_new (void)
+{
+    SplIndex *self = g_new0 (SplIndex, 1);
+    self->xs = g_array_new (FALSE, FALSE, sizeof (gdouble));
+    self->offsets = g_array_new (FALSE, FALSE, sizeof (guint));
+    self->entries = g_array_new (FALSE, FALSE, sizeof (SlabEntry));
+    self->vertical = g_array_new (FALSE, FALSE, sizeof (EdgeEntry));
+    self->horizontal = g_array_new (FALSE, FALSE, sizeof (EdgeEntry));
+    return self;
+}
+
+void
+spl_index_free (SplIndex *self)
+{
+    g_array_free (self->xs, TRUE);
+    g_array_free (self->offsets, TRUE);
+    g_array_free (self->entries, TRUE);
+    g_array_free (self->vertical, TRUE);
+    g_array_free (self->horizontal, TRUE);
+    g_free (self);
+}
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+    gdouble d1 = *(const gdouble *) a;
+    gdouble d2 = *(const gdouble *) b;
+
+    if (d1 != d2)
+        return (d1 < d2) ? -1 : 1;
+
+    return 0;
+}
+
+static gint
+compare_area_tops (gconstpointer a,
+                   gconstpointer b)
+{
+    const SplArea *a1 = *(SplArea **) a;
+    const SplArea *a2 = *(SplArea **) b;
+
+    return compare_doubles (&a1->tl->y, &a2->tl->y);
+}
+
+static gint
+compare_edge_entries (gconstpointer a,
+                      gconstpointer b)
+{
+    const EdgeEntry *e1 = a;
+    const EdgeEntry *e2 = b;
+
+    if (e1->line != e2->line)
+        return (e1->line < e2->line) ? -1 : 1;
+
+    return compare_doubles (&e1->start, &e2->start);
+}
+
+// Number of elements of the sorted `values` at or before `value`
+static guint
+count_up_to (const gdouble *values,
+             guint          n_values,
+             gsize          stride,
+             gdouble        value)
+{
+    guint low = 0;
+    guint high = n_values;
+
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+        const gdouble *cmp = (const gdouble *) ((const guint8 *) values + mid * stride);
+
+        if (*cmp <= value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+static guint
+find_x (SplIndex *self,
+        gdouble   x)
+{
+    // Every x we look for is in the table
+    return count_up_to (&g_array_index (self->xs, gdouble, 0),
+                        self->xs->len, sizeof (gdouble), x) - 1;
+}
+
+static void
+rebuild_areas (SplIndex *self,
+               SplPool  *areas)
+{
+    GPtrArray *sorted = g_ptr_array_new ();
+
+    g_array_set_size (self->xs, 0);
+
+    for (guint i = 0; i < spl_pool_get_n_slots (areas); i++)
+    {
+        SplArea *area = spl_pool_get (areas, i);
+        if (area == NULL)
+            continue;
+
+        g_ptr_array_add (sorted, area);
+        g_array_append_val (self->xs, area->tl->x);
+        g_array_append_val (self->xs, area->tr->x);
+    }
+
+    g_array_sort (self->xs, compare_doubles);
+
+    // Keep each position once
+    guint n_xs = 0;
+
+    for (guint i = 0; i < self->xs->len; i++)
+    {
+        gdouble x = g_array_index (self->xs, gdouble, i);
+
+        if (n_xs == 0 || g_array_index (self->xs, gdouble, n_xs - 1) != x)
+            g_array_index (self->xs, gdouble, n_xs++) = x;
+    }
+
+    g_array_set_size (self->xs, n_xs);
+
+    guint n_slabs = (n_xs > 0) ? n_xs - 1 : 0;
+    g_array_set_size (self->offsets, n_slabs + 1);
+    memset (self->offsets->data, 0, (n_slabs + 1) * sizeof (guint));
+
+    // Count the areas crossing each slab, so they can all share one array
+    for (guint i = 0; i < sorted->len; i++)
+    {
+        SplArea *area = g_ptr_array_index (sorted, i);
+        guint last = find_x (self, area->tr->x);
+
+        for (guint slab = find_x (self, area->tl->x); slab < last; slab++)
+            g_array_index (self->offsets, guint, slab + 1)++;
+    }
+
+    for (guint slab = 0; slab < n_slabs; slab++)
+        g_array_index (self->offsets, guint, slab + 1) += g_array_index (self->offsets, guint, slab);
+
+    g_array_set_size (self->entries, g_array_index (self->offsets, guint, n_slabs));
+
+    // Filling the slabs from the top down leaves each one sorted
+    GArray *filled = g_array_new (FALSE, FALSE, sizeof (guint));
+    g_array_append_vals (filled, self->offsets->data, n_slabs);
+    g_ptr_array_sort (sorted, compare_area_tops);
+
+    for (guint i = 0; i < sorted->len; i++)
+    {
+        SplArea *area = g_ptr_array_index (sorted, i);
+        SlabEntry entry = { area->tl->y, area };
+        guint last = find_x (self, area->tr->x);
+
+        for (guint slab = find_x (self, area->tl->x); slab < last; slab++)
+            g_array_index (self->entries, SlabEntry, g_array_index (filled, guint, slab)++) = entry;
+    }
+
+    g_array_free (filled, TRUE);
+    g_ptr_array_free (sorted, TRUE);
+}
+
+static void
+rebuild_edges (SplIndex *self,
+               SplPool  *edges)
+{
+    g_array_set_size (self->vertical, 0);
+    g_array_set_size (self->horizontal, 0);
+
+    for (guint i = 0; i < spl_pool_get_n_slots (edges); i++)
+    {
+        SplEdge *edge = spl_pool_get (edges, i);
+        if (edge == NULL)
+            continue;
+
+        EdgeEntry entry;
+        entry.edge = edge;
+
+        if (spl_edge_get_orientation (edge) == SPL_VERTICAL)
+        {
+            entry.line = edge->v1->x;
+            entry.start = edge->v1->y;
+            entry.end = edge->v2->y;
+            g_array_append_val (self->vertical, entry);
+        }
+        else
+        {
+            entry.line = edge->v1->y;
+            entry.start = edge->v1->x;
+            entry.end = edge->v2->x;
+            g_array_append_val (self->horizontal, entry);
+        }
+    }
+
+    g_array_sort (self->vertical, compare_edge_entries);
+    g_array_sort (self->horizontal, compare_edge_entries);
+}
+
+void
+spl_index_rebuild (SplIndex *self,
+                   SplPool  *areas,
+                   SplPool  *edges)
+{
+    rebuild_areas (self, areas);
+    rebuild_edges (self, edges);
+}
+
+SplArea *
+spl_index_find_area (SplIndex *self,
+                     gdouble   x,
+                     gdouble   y)
+{
+    // Slab with the last start at or before x
+    guint slab = count_up_to (&g_array_index (self->xs, gdouble, 0),
+                              self->xs->len, sizeof (gdouble), x);
+
+    if (slab == 0 || slab >= self->xs->len)
+        return NULL;
+
+    slab--;
+
+    guint first = g_array_index (self->offsets, guint, slab);
+    guint last = g_array_index (self->offsets, guint, slab + 1);
+
+    // Area with the last top at or before y
+    SlabEntry *entries = &g_array_index (self->entries, SlabEntry, first);
+    guint count = count_up_to (&entries->top, last - first, sizeof (SlabEntry), y);
+
+    if (count == 0)
+        return NULL;
+
+    SplArea *area = entries[count - 1].area;
+
+    // The point may still be on the area's border, or below the screen
+    if (!spl_area_check_for_coords (area, x, y))
+        return NULL;
+
+    return area;
+}
+
+// Looks at each line within `safety` of `across`, and at the edge on
+// it starting last before `along`
+static void
+find_in_lines (GArray   *edges,
+               gdouble   across,
+               gdouble   along,
+               gdouble   safety,
+               SplEdge **closest,
+               gdouble  *distance)
+{
+    EdgeEntry *entries = &g_array_index (edges, EdgeEntry, 0);
+    guint i = count_up_to (&entries->line, edges->len, sizeof (EdgeEntry), across - safety);
+
+    while (i < edges->len && entries[i].line < across + safety)
+    {
+        gdouble line = entries[i].line;
+        guint end = count_up_to (&entries->line, edges->len, sizeof (EdgeEntry), line);
+
+        guint count = count_up_to (&entries[i].start, end - i, sizeof (EdgeEntry), along);
+
+        if (count > 0)
+        {
+            EdgeEntry *entry = &entries[i + count - 1];
+
+            if (along > entry->start &&
+                along < entry->end &&
+                ABS (line - across) < *distance)
+            {
+                *closest = entry->edge;
+                *distance = ABS (line - across);
+            }
+        }
+
+        i = end;
+    }
+}
+
+SplEdge *
+spl_index_find_edge (SplIndex *self,
+                     gdouble   x,
+                     gdouble   y,
+                     gdouble   safety)
+{
+    SplEdge *closest = NULL;
+    gdouble distance = safety;
+
+    find_in_lines (self->vertical, x, y, safety, &closest, &distance);
+    find_in_lines (self->horizontal, y, x, safety, &closest, &distance);
+
+    return closest;
+}
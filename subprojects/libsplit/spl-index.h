@@ -0,0 +1,54 @@
+/* spl-index.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "spl-tile-manager.h"
+#include "spl-pool.h"
+
+G_BEGIN_DECLS
+
+// Lookup tables for finding the area or edge under a point in O(log n).
+// The screen is cut into vertical slabs at the left and right side of
+// every area, and each slab lists the areas crossing it from top to
+// bottom. Edges are sorted by the line they lie on. The tables are a
+// snapshot of the layout, so they must be rebuilt after it changes.
+typedef struct _SplIndex SplIndex;
+
+SplIndex *  spl_index_new        (void);
+void        spl_index_free       (SplIndex *self);
+
+void        spl_index_rebuild    (SplIndex *self,
+                                  SplPool  *areas,
+                                  SplPool  *edges);
+
+// Same results as testing every area with `spl_area_check_for_coords`
+SplArea *   spl_index_find_area  (SplIndex *self,
+                                  gdouble   x,
+                                  gdouble   y);
+
+// The edge within `safety` of the point, or the closest if more than
+// one is, as there may be at a corner
+SplEdge *   spl_index_find_edge  (SplIndex *self,
+                                  gdouble   x,
+                                  gdouble   y,
+                                  gdouble   safety);
+
+G_END_DECLS
@@ -0,0 +1,164 @@
+/* spl-pool.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "spl-pool.h"
+
+#include <string.h>
+
+// Elements per slab
+#define SLAB_SIZE 64
+
+// Kept in front of every element, padded so the element itself is
+// aligned for doubles and pointers
+typedef struct
+{
+    guint index;
+    gboolean live;
+} SlotHeader;
+
+#define HEADER_SIZE ((sizeof (SlotHeader) + 7) & ~(gsize)7)
+
+struct _SplPool
+{
+    gsize slot_size;
+    GPtrArray *slabs;
+    guint n_slots;
+    guint n_live;
+
+    // Indices of released slots, reused last in first out
+    GArray *free_slots;
+};
+
+SplPool *
+spl_pool_new (gsize element_size)
+{
+    SplPool *self = g_new0 (SplPool, 1);
+    self->slot_size = HEADER_SIZE + ((element_size + 7) & ~(gsize)7);
+    self->slabs = g_ptr_array_new_with_free_func (g_free);
+    self->free_slots = g_array_new (FALSE, FALSE, sizeof (guint));
+    return self;
+}
+
+void
+spl_pool_free (SplPool *self)
+{
+    g_ptr_array_free (self->slabs, TRUE);
+    g_array_free (self->free_slots, TRUE);
+    g_free (self);
+}
+
+static SlotHeader *
+get_slot (SplPool *self,
+          guint    index)
+{
+    guint8 *slab = g_ptr_array_index (self->slabs, index / SLAB_SIZE);
+    return (SlotHeader *) (slab + (index % SLAB_SIZE) * self->slot_size);
+}
+
+static SlotHeader *
+get_header (gconstpointer element)
+{
+    return (SlotHeader *) ((guint8 *) element - HEADER_SIZE);
+}
+
+gpointer
+spl_pool_alloc (SplPool *self)
+{
+    guint index;
+
+    if (self->free_slots->len > 0)
+    {
+        index = g_array_index (self->free_slots, guint, self->free_slots->len - 1);
+        g_array_set_size (self->free_slots, self->free_slots->len - 1);
+    }
+    else
+    {
+        if (self->n_slots % SLAB_SIZE == 0)
+            g_ptr_array_add (self->slabs, g_malloc (SLAB_SIZE * self->slot_size));
+
+        index = self->n_slots++;
+    }
+
+    SlotHeader *header = get_slot (self, index);
+    memset (header, 0, self->slot_size);
+    header->index = index;
+    header->live = TRUE;
+    self->n_live++;
+
+    return (guint8 *) header + HEADER_SIZE;
+}
+
+void
+spl_pool_release (SplPool  *self,
+                  gpointer  element)
+{
+    g_return_if_fail (spl_pool_owns (self, element));
+
+    SlotHeader *header = get_header (element);
+    header->live = FALSE;
+    self->n_live--;
+    g_array_append_val (self->free_slots, header->index);
+}
+
+gboolean
+spl_pool_owns (SplPool       *self,
+               gconstpointer  element)
+{
+    if (element == NULL)
+        return FALSE;
+
+    // Elements of other pools have headers too, but the slot their
+    // index names here is somewhere else
+    const SlotHeader *header = get_header (element);
+
+    return header->index < self->n_slots &&
+           get_slot (self, header->index) == header &&
+           header->live;
+}
+
+guint
+spl_pool_get_index (SplPool       *self,
+                    gconstpointer  element)
+{
+    return get_header (element)->index;
+}
+
+gpointer
+spl_pool_get (SplPool *self,
+              guint    index)
+{
+    if (index >= self->n_slots)
+        return NULL;
+
+    SlotHeader *header = get_slot (self, index);
+    return header->live ? (guint8 *) header + HEADER_SIZE : NULL;
+}
+
+guint
+spl_pool_get_n_slots (SplPool *self)
+{
+    return self->n_slots;
+}
+
+guint
+spl_pool_get_n_live (SplPool *self)
+{
+    return self->n_live;
+}
@@ -0,0 +1,60 @@
+/* spl-pool.h
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This file is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Storage for fixed-size elements. Elements live side by side in slabs
+// that are never moved, so a pointer to one stays valid until it is
+// released, and each has an index for as long as it lives. Released
+// slots are reused before the pool grows.
+typedef struct _SplPool SplPool;
+
+SplPool *  spl_pool_new        (gsize          element_size);
+void       spl_pool_free       (SplPool       *self);
+
+// Returns a zeroed element
+gpointer   spl_pool_alloc      (SplPool       *self);
+void       spl_pool_release    (SplPool       *self,
+                                gpointer       element);
+
+// Whether `element` is live and belongs to this pool. Takes constant
+// time by reading the slot header in front of `element`, so `element`
+// must have come from a pool that has not been freed, though any pool
+// will do. Anything else is undefined behaviour. A pointer kept past its
+// release is caught only until the slot is handed out again, after
+// which it names the new element.
+gboolean   spl_pool_owns       (SplPool       *self,
+                                gconstpointer  element);
+
+guint      spl_pool_get_index  (SplPool       *self,
+                                gconstpointer  element);
+
+// The element at `index`, or NULL if that slot is free. Iterating up
+// to `spl_pool_get_n_slots` visits every live element in memory order.
+gpointer   spl_pool_get        (SplPool       *self,
+                                guint          index);
+guint      spl_pool_get_n_slots (SplPool      *self);
+guint      spl_pool_get_n_live (SplPool       *self);
+
+G_END_DECLS
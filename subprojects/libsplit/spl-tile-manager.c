@@ -20,24 +20,62 @@
 
 
 #include "spl-tile-manager.h"
+#include "spl-pool.h"
+#include "spl-index.h"
 
 struct _SplTileManager
 {
     GObject parent_instance;
 };
 
-typedef struct
+typedef struct _SplNode SplNode;
+
+// Node of the layout tree. Leaves hold an area. Every other node is
+// split in two along `direction` (as given to `spl_area_split`), with
+// `ratio` of it going to `first` and `edge` running between the two.
+struct _SplNode
 {
-    // Doubly linked-lists
+    SplNode *parent;
+    SplNode *first;
+    SplNode *second;
 
-    // SplVertex
-    GList* vertices;
+    guint direction;
+    gdouble ratio;
+    SplEdge *edge;
 
-    // SplEdge
-    GList* edges;
+    SplArea *area;
+
+    // Extent of the node, as last laid out
+    gdouble x0, y0, x1, y1;
+};
 
-    // SplArea
-    GList* areas;
+typedef struct
+{
+    // Pools of SplVertex, SplEdge and SplArea. Hit tests and moves
+    // walk each pool's slabs in order rather than chasing list links.
+    SplPool *vertices;
+    SplPool *edges;
+    SplPool *areas;
+
+    // Layout tree. Areas and edges find their node by their index in
+    // the pools above.
+    SplPool *nodes;
+    SplNode *root;
+    GPtrArray *area_nodes;
+    GPtrArray *edge_nodes;
+
+    // Edges around the screen, which belong to no node
+    SplEdge *borders[4];
+
+    // List of areas handed out by `spl_tile_manager_get_areas`, built
+    // again the first time it is asked for after a change
+    GList *area_list;
+    gboolean area_list_dirty;
+
+    // Hit testing tables, built again the first time they are used
+    // after the layout changes
+    SplIndex *index;
+    gboolean index_dirty;
 
     // Screen
     guint width;
@@ -81,8 +119,17 @@ spl_tile_manager_new ()
 static void
 spl_tile_manager_finalize (GObject *object)
 {
-    // SplTileManager *self = (SplTileManager *)object;
-    // SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    SplTileManager *self = (SplTileManager *)object;
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    g_list_free (priv->area_list);
+    spl_index_free (priv->index);
+    spl_pool_free (priv->vertices);
+    spl_pool_free (priv->edges);
+    spl_pool_free (priv->areas);
+    spl_pool_free (priv->nodes);
+    g_ptr_array_free (priv->area_nodes, TRUE);
+    g_ptr_array_free (priv->edge_nodes, TRUE);
 
     G_OBJECT_CLASS (spl_tile_manager_parent_class)->finalize (object);
 }
@@ -193,34 +240,26 @@ print_vertex_single(SplVertex* vertex)
     g_debug ("Vertex: (%f, %f)", x, y);
 }
 
-static void
-cb_print_area (SplArea* area, gpointer null_ptr)
-{
-    print_area_single (area);
-}
-
 void
 print_areas (SplTileManager *self)
 {
     // Get Private
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    GList *areas = priv->areas;
-
-    if (areas == NULL)
+    if (spl_pool_get_n_live (priv->areas) == 0)
     {
-        // List is empty, return
+        // Pool is empty, return
         g_debug("No Areas");
         return;
     }
 
-    // Iterate over list
-    g_list_foreach(priv->areas, (GFunc)cb_print_area, NULL);
-}
-
-static void cb_print_vertex(SplVertex* vertex, gpointer null_ptr)
-{
-    print_vertex_single (vertex);
+    // Iterate over pool
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
+    {
+        SplArea *area = spl_pool_get (priv->areas, i);
+        if (area != NULL)
+            print_area_single (area);
+    }
 }
 
 void
@@ -229,82 +268,190 @@ print_vertices (SplTileManager *self)
     // Get Private
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    GList *vertices = priv->vertices;
-
-    if (vertices == NULL)
+    if (spl_pool_get_n_live (priv->vertices) == 0)
     {
-        // List is empty, return
+        // Pool is empty, return
         g_debug("No Vertices");
         return;
     }
 
-    // Iterate over list
-    g_list_foreach(priv->vertices, (GFunc)cb_print_vertex, NULL);
+    // Iterate over pool
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->vertices); i++)
+    {
+        SplVertex *vertex = spl_pool_get (priv->vertices, i);
+        if (vertex != NULL)
+            print_vertex_single (vertex);
+    }
+}
+
+static SplVertex*
+create_vertex(SplTileManager *self, gdouble x, gdouble y)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    SplVertex* v = spl_pool_alloc (priv->vertices);
+    v->x = x;
+    v->y = y;
+    return v;
+}
+
+static SplEdge*
+create_edge(SplTileManager *self, SplVertex *v1, SplVertex *v2)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    SplEdge *e = spl_pool_alloc (priv->edges);
+    e->v1 = v1;
+    e->v2 = v2;
+    return e;
+}
+
+static SplNode *
+get_node (GPtrArray     *nodes,
+          SplPool       *pool,
+          gconstpointer  element)
+{
+    guint index = spl_pool_get_index (pool, element);
+
+    if (index >= nodes->len)
+        return NULL;
+
+    return g_ptr_array_index (nodes, index);
+}
+
+static void
+set_node (GPtrArray     *nodes,
+          SplPool       *pool,
+          gconstpointer  element,
+          SplNode       *node)
+{
+    guint index = spl_pool_get_index (pool, element);
+
+    if (index >= nodes->len)
+        g_ptr_array_set_size (nodes, index + 1);
+
+    g_ptr_array_index (nodes, index) = node;
 }
 
 static void
-swap_vertices(SplVertex* tl, SplVertex* tr)
+release_edge (SplTileManager *self, SplEdge *edge)
 {
-    // Create a temporary vertex
-    SplVertex* temp = g_malloc(sizeof(SplVertex));
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    // Let temp = tl
-    memcpy (temp, tl, sizeof(SplVertex));
+    set_node (priv->edge_nodes, priv->edges, edge, NULL);
+    spl_pool_release (priv->vertices, edge->v1);
+    spl_pool_release (priv->vertices, edge->v2);
+    spl_pool_release (priv->edges, edge);
+}
 
-    // Make tl = tr
-    memcpy (tl, tr, sizeof(SplVertex));
+static SplNode *
+create_leaf (SplTileManager *self,
+             SplArea        *area,
+             SplNode        *parent)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    // Make tr = temp
-    memcpy (tr, temp, sizeof(SplVertex));
+    SplNode *node = spl_pool_alloc (priv->nodes);
+    node->parent = parent;
+    node->area = area;
+    set_node (priv->area_nodes, priv->areas, area, node);
 
-    // Free temp
-    g_free(temp);
+    return node;
 }
 
+// Turns `node` into a split node. Its children are left to the caller.
 static void
-arrange_vertices(SplVertex* tl, SplVertex* tr, SplVertex* bl, SplVertex* br)
+make_split (SplTileManager *self,
+            SplNode        *node,
+            guint           direction,
+            gdouble         ratio)
 {
-    // Topleft is greater than topright
-    if (tl->x > tr->x)
-    {
-        swap_vertices(tl, tr);
-    }
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    node->area = NULL;
+    node->direction = direction;
+    node->ratio = ratio;
+    node->edge = create_edge (self, create_vertex (self, 0, 0), create_vertex (self, 0, 0));
+    set_node (priv->edge_nodes, priv->edges, node->edge, node);
+}
+
+static void
+set_vertex (SplVertex *vertex,
+            gdouble    x,
+            gdouble    y)
+{
+    vertex->x = x;
+    vertex->y = y;
+}
+
+static void
+set_rect (SplNode *node,
+          gdouble  x0,
+          gdouble  y0,
+          gdouble  x1,
+          gdouble  y1)
+{
+    node->x0 = x0;
+    node->y0 = y0;
+    node->x1 = x1;
+    node->y1 = y1;
+}
 
-    // Bottomleft greater than bottomright
-    if (bl->x > br->x)
+// Places everything under `node` from its extent and the ratios of the
+// split nodes below it
+static void
+layout_node (SplNode *node)
+{
+    if (node->area != NULL)
     {
-        swap_vertices(bl, br);
+        SplArea *area = node->area;
+        set_vertex (area->tl, node->x0, node->y0);
+        set_vertex (area->tr, node->x1, node->y0);
+        set_vertex (area->bl, node->x0, node->y1);
+        set_vertex (area->br, node->x1, node->y1);
+        return;
     }
 
-    // Topleft greater than bottomleft
-    if (tl->y > bl->y)
+    SplNode *first = node->first;
+    SplNode *second = node->second;
+
+    set_rect (first, node->x0, node->y0, node->x1, node->y1);
+    set_rect (second, node->x0, node->y0, node->x1, node->y1);
+
+    if (node->direction == SPL_HORIZONTAL)
     {
-        swap_vertices(tl, bl);
+        // Side by side
+        gdouble x = node->x0 + node->ratio * (node->x1 - node->x0);
+        first->x1 = second->x0 = x;
+        set_vertex (node->edge->v1, x, node->y0);
+        set_vertex (node->edge->v2, x, node->y1);
     }
-
-    // Topright greater than bottomright
-    if (tr->y > br->y)
+    else
     {
-        swap_vertices(tr, br);
+        // On top of each other
+        gdouble y = node->y0 + node->ratio * (node->y1 - node->y0);
+        first->y1 = second->y0 = y;
+        set_vertex (node->edge->v1, node->x0, y);
+        set_vertex (node->edge->v2, node->x1, y);
     }
-}
 
-static SplVertex*
-create_vertex(gdouble x, gdouble y)
-{
-    SplVertex* v = g_malloc(sizeof(SplVertex));
-    v->x = x;
-    v->y = y;
-    return v;
+    layout_node (first);
+    layout_node (second);
 }
 
-static SplEdge*
-create_edge(SplVertex *v1, SplVertex *v2)
+// Releases `node` and every node and edge below it, but not the areas
+static void
+free_tree (SplTileManager *self,
+           SplNode        *node)
 {
-    SplEdge *e = g_malloc(sizeof(SplEdge));
-    e->v1 = v1;
-    e->v2 = v2;
-    return e;
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    if (node->area == NULL)
+    {
+        release_edge (self, node->edge);
+        free_tree (self, node->first);
+        free_tree (self, node->second);
+    }
+
+    spl_pool_release (priv->nodes, node);
 }
 
 gdouble
@@ -360,26 +507,20 @@ gpointer spl_area_get_userdata(SplArea *area)
 }
 
 static SplArea*
-spl_tile_manager_create_area(SplTileManager *self,
-                             SplVertex      *tl,
-                             SplVertex      *tr,
-                             SplVertex      *bl,
-                             SplVertex      *br)
+spl_tile_manager_create_area(SplTileManager *self)
 {
-    // This function assumes that the vertices and edges are already correct
-    // Up to the caller to make sure.
+    // The area is placed by `layout_node`, and announced by the caller
+    // once it has been
 
-    // Create area
-    SplArea *area = g_malloc (sizeof(SplArea));
-    area->tl = tl;
-    area->tr = tr;
-    area->bl = bl;
-    area->br = br;
+    // Get Private
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    SplEdge* top = create_edge (tl, tr);
-    SplEdge* left = create_edge (tl, bl);
-    SplEdge* bottom = create_edge (bl, br);
-    SplEdge* right = create_edge (tr, br);
+    // Create area
+    SplArea *area = spl_pool_alloc (priv->areas);
+    area->tl = create_vertex (self, 0, 0);
+    area->tr = create_vertex (self, 0, 0);
+    area->bl = create_vertex (self, 0, 0);
+    area->br = create_vertex (self, 0, 0);
 
     // Colours
     area->r = rand() % 256;
@@ -389,40 +530,17 @@ spl_tile_manager_create_area(SplTileManager *self,
     // User Data
     area->user_data = NULL;
 
-    // Get Private
-    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-
-    // Add to array (we use prepend for better linked list performance)
-
-    // Vertices
-    priv->vertices = g_list_prepend (priv->vertices, area->tl);
-    priv->vertices = g_list_prepend (priv->vertices, area->tr);
-    priv->vertices = g_list_prepend (priv->vertices, area->bl);
-    priv->vertices = g_list_prepend (priv->vertices, area->br);
-
-    // Edges
-    priv->edges = g_list_prepend (priv->edges, top);
-    priv->edges = g_list_prepend (priv->edges, left);
-    priv->edges = g_list_prepend (priv->edges, bottom);
-    priv->edges = g_list_prepend (priv->edges, right);
-
-    // Area
-    priv->areas = g_list_prepend (priv->areas, area);
-
-    // Log
-    g_debug("Created Area");
-    g_signal_emit (self, signals[AREA_CREATED], 0, area);
-    print_area_single(area);
+    priv->area_list_dirty = TRUE;
+    priv->index_dirty = TRUE;
 
     return area;
 }
 
 static void
-add_edge(SplTileManager *self,
-         SplEdge        *edge)
+spl_tile_manager_area_created (SplTileManager *self,
+                               SplArea        *area)
 {
-    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-    priv->edges = g_list_prepend(priv->edges, edge);
+    g_signal_emit (self, signals[AREA_CREATED], 0, area);
 }
 
 static inline guint
@@ -520,222 +638,55 @@ spl_area_split (SplTileManager *self,
     // Get Private
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    if (g_list_find(priv->areas, area) == NULL)
+    if (!spl_pool_owns (priv->areas, area))
     {
         // Area not found, oops
         g_error("Foreign area passed to split function");
         return NULL;
     }
 
-    // Total Width and Height
-    gdouble width = spl_area_get_width(area);
-    gdouble height = spl_area_get_height(area);
-
-    // Bordering Vertices
-    SplVertex* top_left = area->tl;
-    SplVertex* top_right = area->tr;
-    SplVertex* bottom_left = area->bl;
-    SplVertex* bottom_right = area->br;
-
-    // Make sure vertices refer to what we expect them to
-    arrange_vertices (top_left, top_right, bottom_left, bottom_right);
-
-    // New Area
-    SplArea* new_area = NULL;
-
-    if (direction == SPL_HORIZONTAL)
+    if (direction != SPL_HORIZONTAL &&
+        direction != SPL_VERTICAL)
     {
-        // Horizontal split means that the areas are placed next to
-        // each other (side by side)
-
-        // If the factor of the split is greater than 0.5, then the split will occur
-        // from the opposite direction, resulting in the new area being placed on the
-        // right.
-        gboolean reverse;
-        if (fac > 0.5)
-            reverse = TRUE;
-        else
-            reverse = FALSE;
-
-        // Check we are big enough to split
-        gboolean result = spl_area_can_split (self, area, SPL_HORIZONTAL);
-        if (result == FALSE)
-            return NULL;
-
-        gdouble a1_width = width * fac;
-
-        // Find Middle Vertices
-        gdouble mid_vertex_x = top_left->x + a1_width;
-        SplVertex* mid_vertex_top = create_vertex (mid_vertex_x, top_left->y);
-        SplVertex* mid_vertex_bottom = create_vertex (mid_vertex_x, bottom_left->y);
-
-        if (reverse)
-        {
-            // # Old Area is placed on the left (Old Area is a1)
-
-            // This means that the area's tl and bl stay the same, while
-            // tr and br point to mid_vertex_top and mid_vertex_bottom
-            // respectively.
-
-            area->tr = mid_vertex_top;
-            area->br = mid_vertex_bottom;
-
-            // In terms of edges, the left edge remains unchanged. The top
-            // and bottom edges have their second vertex changed to the middle
-            // vertex. The right edge is shared with a2, and is created for us
-            // below.
-
-            add_edge(self, create_edge(area->tl, mid_vertex_top));
-            add_edge(self, create_edge(area->bl, mid_vertex_bottom));
-
-            // # New Area is placed on the right (New Area is a2)
-
-            // This means that the area's tl and bl vertices are the middle
-            // vertices, and that its tr and br are the same as the original
-            // non-split area. We do not need to worry about edges as create_area
-            // creates them for us.
-
-            new_area = spl_tile_manager_create_area (self, mid_vertex_top, top_right,
-                                                     mid_vertex_bottom, bottom_right);
-
-        }
-        else
-        {
-            // # New Area is placed on the left (New Area is a1)
-
-            // This means that the area's tl and bl vertices are carried
-            // over from the original area, while the tr and br vertices are
-            // equal to the middle vertices.
-
-            new_area = spl_tile_manager_create_area (self, top_left, mid_vertex_top,
-                                                     bottom_left, mid_vertex_bottom);
-
-            // The above function creates all of the edges needed for us, so we do not
-            // need to do anything here.
-
-            // # Old Area is placed on the right (Old Area is a2)
-
-            // This means that the middle vertices are this areas tl and bl,
-            // and the original rect tr and br are the tr and br for this area.
-
-            area->tl = mid_vertex_top;
-            area->bl = mid_vertex_bottom;
-
-            // In terms of edges, we already have the left and right edges created for
-            // us, the first by the `create_area` function, and the second from the original
-            // rect. We need to create the top and bottom edges here.
-
-            add_edge (self, create_edge (mid_vertex_top, top_right));
-            add_edge (self, create_edge (mid_vertex_bottom, bottom_right));
-        }
-
-        // Finally, to make this work, we need to add the two newly created
-        // vertices to the vertices list
-        priv->vertices = g_list_prepend(priv->vertices, mid_vertex_top);
-        priv->vertices = g_list_prepend(priv->vertices, mid_vertex_bottom);
-
+        g_error("Invalid direction");
+        return NULL;
     }
-    else if (direction == SPL_VERTICAL)
-    {
-        // Vertical split means that the areas are placed on top of
-        // each other
-
-        gdouble a1_height = height * fac;
-
-        // Find Middle Vertices
-        gdouble mid_vertex_y = top_left->y + a1_height;
-        SplVertex* mid_vertex_left = create_vertex (top_left->x, mid_vertex_y);
-        SplVertex* mid_vertex_right = create_vertex (top_right->x, mid_vertex_y);
-
-        // Check we are big enough to split
-        gboolean result = spl_area_can_split (self, area, SPL_VERTICAL);
-        if (result == FALSE)
-            return NULL;
-
-        // If the factor of the split is greater than 0.5, then the split will occur
-        // from the opposite direction, resulting in the new area being placed on the
-        // bottom.
-        if (fac > 0.5)
-        {
-            // # Old Area is placed on the top (Old Area is a1)
-
-            // This means that the area's tl and tr stay the same, while
-            // bl and br point to mid_vertex_left and mid_vertex_right
-            // respectively.
-
-            area->bl = mid_vertex_left;
-            area->br = mid_vertex_right;
-
-            // In terms of edges, the top edge remains unchanged. The left
-            // and right edges have their second vertex changed to the middle
-            // vertex. The bottom edge is shared with a2, and is created for us
-            // below.
-
-            add_edge(self, create_edge(area->tl, mid_vertex_left));
-            add_edge(self, create_edge(area->tr, mid_vertex_right));
-
-            // # New Area is placed on the bottom (New Area is a2)
-
-            // This means that the area's tl and tr vertices are the middle
-            // vertices, and that its bl and br are the same as the original
-            // non-split area. We do not need to worry about edges as create_area
-            // creates them for us.
-
-            new_area = spl_tile_manager_create_area (self, mid_vertex_left, mid_vertex_right,
-                                                     bottom_left, bottom_right);
-
-        }
-        else
-        {
-            // # New Area is placed on the top (New Area is a1)
-
-            // This means that the area's tl and tr vertices are carried
-            // over from the original area, while the bl and br vertices are
-            // equal to the middle vertices.
-
-            new_area = spl_tile_manager_create_area (self, top_left, top_right,
-                                                     mid_vertex_left, mid_vertex_right);
-
-            // The above function creates all of the edges needed for us, so we do not
-            // need to do anything here.
-
-            // # Old Area is placed on the bottom (Old Area is a2)
 
-            // This means that the middle vertices are this areas tl and tr,
-            // and the original rect bl and br are the bl and br for this area (unchanged).
+    g_return_val_if_fail (fac > 0 && fac < 1, NULL);
 
-            area->tl = mid_vertex_left;
-            area->tr = mid_vertex_right;
+    // Check we are big enough to split
+    if (!spl_area_can_split (self, area, direction))
+        return NULL;
 
-            // In terms of edges, we already have the top and bottom edges created for
-            // us, the first by the `create_area` function, and the second from the original
-            // rect. We need to create the left and right edges here.
+    // The leaf holding the area becomes a split node, with the area and
+    // a new one as its children. A horizontal split places them next to
+    // each other (side by side), and a vertical split on top of each other.
+    SplNode *node = get_node (priv->area_nodes, priv->areas, area);
+    SplArea *new_area = spl_tile_manager_create_area (self);
+    SplNode *old_leaf = create_leaf (self, area, node);
+    SplNode *new_leaf = create_leaf (self, new_area, node);
 
-            add_edge (self, create_edge (mid_vertex_left, bottom_left));
-            add_edge (self, create_edge (mid_vertex_right, bottom_right));
-        }
+    make_split (self, node, direction, fac);
 
-        // Finally, to make this work, we need to add the two newly created
-        // vertices to the vertices list
-        priv->vertices = g_list_prepend(priv->vertices, mid_vertex_left);
-        priv->vertices = g_list_prepend(priv->vertices, mid_vertex_right);
+    // If the factor of the split is greater than 0.5, then the split will occur
+    // from the opposite direction, resulting in the new area being placed on the
+    // right (or bottom) and the old area keeping the left (or top).
+    if (fac > 0.5)
+    {
+        node->first = old_leaf;
+        node->second = new_leaf;
     }
     else
     {
-        g_error("Invalid direction");
-        return NULL;
+        node->first = new_leaf;
+        node->second = old_leaf;
     }
 
-    if (new_area != NULL)
-    {
-        g_debug("Area split successfully");
-    }
+    layout_node (node);
+    priv->index_dirty = TRUE;
 
-    // FIXME: We have edges left over from this operation, and this
-    // constitutes a memory leak (if negligible). When a split area shares
-    // edges with bounding areas, these edges cannot be resized (as this would
-    // break adjacent areas), and are instead recreated. Therefore we need to
-    // run an edge deduplication function.
+    g_debug("Area split successfully");
+    spl_tile_manager_area_created (self, new_area);
 
     // Return new area
     return new_area;
@@ -746,180 +697,969 @@ spl_tile_manager_init (SplTileManager *self)
 {
     // Initialisation
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-    priv->areas = NULL;
-    priv->edges = NULL;
-    priv->vertices = NULL;
+    priv->vertices = spl_pool_new (sizeof (SplVertex));
+    priv->edges = spl_pool_new (sizeof (SplEdge));
+    priv->areas = spl_pool_new (sizeof (SplArea));
+    priv->nodes = spl_pool_new (sizeof (SplNode));
+    priv->area_nodes = g_ptr_array_new ();
+    priv->edge_nodes = g_ptr_array_new ();
+    priv->index = spl_index_new ();
+    priv->index_dirty = TRUE;
 
     // The caller is expected to call `create_initial`
     // after setting up signal callbacks
 }
 
+static void
+create_borders (SplTileManager *self)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    if (priv->borders[0] != NULL)
+        return;
+
+    priv->borders[0] = create_edge (self, create_vertex (self, 0, 0), create_vertex (self, 1, 0));
+    priv->borders[1] = create_edge (self, create_vertex (self, 0, 1), create_vertex (self, 1, 1));
+    priv->borders[2] = create_edge (self, create_vertex (self, 0, 0), create_vertex (self, 0, 1));
+    priv->borders[3] = create_edge (self, create_vertex (self, 1, 0), create_vertex (self, 1, 1));
+}
+
 void
 spl_tile_manager_create_initial (SplTileManager *self)
 {
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    g_return_if_fail (priv->root == NULL);
+
     // We are using a top-left origin system
     // where top-left is (0, 0) and bottom-right
     // is (1, 1)
 
-    SplVertex* tl = create_vertex (0, 0);       // TL
-    SplVertex* tr = create_vertex (1, 0);     // TR
-    SplVertex* bl = create_vertex (0, 1);     // BL
-    SplVertex* br = create_vertex (1, 1);   // BR
-
     // Create area
-    spl_tile_manager_create_area(self, tl, tr, bl, br);
+    priv->root = create_leaf (self, spl_tile_manager_create_area (self), NULL);
+    set_rect (priv->root, 0, 0, 1, 1);
+    layout_node (priv->root);
+
+    create_borders (self);
+    spl_tile_manager_area_created (self, priv->root->area);
 }
 
-gboolean within_safety(gdouble n1,
-                       gdouble n2,
-                       gdouble safety)
+// One side of an area or an edge, as a span along a horizontal or
+// vertical line. `v1` is the top/left end and `v2` the bottom/right.
+typedef struct
 {
-    if (n1 > n2)
-        return ((n1 - n2) < safety);
-    else
-        return ((n2 - n1) < safety);
-}
+    gdouble line;
+    gdouble start, end;
+    SplVertex *v1, *v2;
+} Side;
 
-gboolean within_range(gdouble n,
-                      gdouble start,
-                      gdouble end)
+static void
+add_side (GArray    *sides,
+          gdouble    line,
+          gdouble    start,
+          gdouble    end,
+          SplVertex *v1,
+          SplVertex *v2)
 {
-    if (n > start && n < end)
-        return TRUE;
-    else
-        return FALSE;
+    Side side = { line, start, end, v1, v2 };
+    g_array_append_val (sides, side);
 }
 
-guint
-spl_edge_get_orientation(SplEdge* edge)
+static void
+collect_area_sides (SplTileManager *self,
+                    GArray         *horizontal,
+                    GArray         *vertical)
 {
-    SplVertex* v1 = edge->v1;
-    SplVertex* v2 = edge->v2;
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    if (v1->x == v2->x)
-    {
-        return SPL_VERTICAL;
-    }
-    else if (v1->y == v2->y)
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
     {
-        return SPL_HORIZONTAL;
-    }
-    else
-    {
-        g_error("Malformed line");
-        return 0;
+        SplArea *area = spl_pool_get (priv->areas, i);
+        if (area == NULL)
+            continue;
+
+        add_side (horizontal, area->tl->y, area->tl->x, area->tr->x, area->tl, area->tr);
+        add_side (horizontal, area->bl->y, area->bl->x, area->br->x, area->bl, area->br);
+        add_side (vertical, area->tl->x, area->tl->y, area->bl->y, area->tl, area->bl);
+        add_side (vertical, area->tr->x, area->tr->y, area->br->y, area->tr, area->br);
     }
 }
 
-SplArea *
-spl_tile_manager_get_any (SplTileManager *self)
+static gboolean
+sides_overlap (const Side *a,
+               const Side *b)
 {
-    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-    return priv->areas->data;
+    return (a->line == b->line &&
+            a->start < b->end &&
+            b->start < a->end);
 }
 
 static gboolean
-spl_vertex_is_equal(SplVertex *v1, SplVertex *v2)
+side_covers (const Side *outer,
+             const Side *inner)
 {
-    return (v1->x == v2->x &&
-            v1->y == v2->y);
+    return (outer->line == inner->line &&
+            outer->start <= inner->start &&
+            inner->end <= outer->end);
 }
 
-static void
-spl_tile_manager_remove_area (SplTileManager *self, SplArea *remove)
+static gboolean
+check_area (SplTileManager *self,
+            SplArea        *area)
 {
-    g_signal_emit (self, signals[AREA_REMOVED], 0, spl_area_get_userdata (remove));
-
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-    priv->areas = g_list_remove(priv->areas, remove);
-}
 
-gboolean
-spl_area_join(SplTileManager *self, SplArea *keep, SplArea *join)
-{
-    if (join == NULL ||
-        keep == NULL ||
-        !(SPL_IS_TILE_MANAGER (self)))
+    if (!spl_pool_owns (priv->vertices, area->tl) ||
+        !spl_pool_owns (priv->vertices, area->tr) ||
+        !spl_pool_owns (priv->vertices, area->bl) ||
+        !spl_pool_owns (priv->vertices, area->br))
+    {
+        g_warning ("Area %u has a corner which is not a vertex",
+                   spl_pool_get_index (priv->areas, area));
         return FALSE;
+    }
 
-    // Get orientation of areas to each other
-    enum {
-        LEFT,
-        RIGHT,
-        TOP,
-        BOTTOM,
-        INVALID
-    };
-
-    guint direction = INVALID;
-
-    // Get direction of join
-    // Resize keep area to absorb join area's allocation
-    if (spl_vertex_is_equal (keep->tl, join->tr) &&
-        spl_vertex_is_equal (keep->bl, join->br))
+    if (area->tl->y != area->tr->y ||
+        area->bl->y != area->br->y ||
+        area->tl->x != area->bl->x ||
+        area->tr->x != area->br->x)
     {
-        direction = LEFT;
-        g_debug("Join Direction: Left");
-
-        keep->tl = join->tl;
-        keep->bl = join->bl;
-
-        add_edge (self, create_edge (keep->tl, keep->tr));
-        add_edge (self, create_edge (keep->bl, keep->br));
+        g_warning ("Area %u is not a rectangle",
+                   spl_pool_get_index (priv->areas, area));
+        return FALSE;
     }
-    else if (spl_vertex_is_equal (keep->tl, join->bl) &&
-             spl_vertex_is_equal (keep->tr, join->br))
-    {
-        direction = TOP;
-        g_debug("Join Direction: Top");
-
-        keep->tl = join->tl;
-        keep->tr = join->tr;
 
-        add_edge (self, create_edge (keep->tl, keep->bl));
-        add_edge (self, create_edge (keep->tr, keep->br));
-    }
-    else if (spl_vertex_is_equal (keep->tr, join->tl) &&
-             spl_vertex_is_equal (keep->br, join->bl))
+    if (area->tl->x >= area->tr->x ||
+        area->tl->y >= area->bl->y ||
+        area->tl->x < 0 || area->tl->y < 0 ||
+        area->br->x > 1 || area->br->y > 1)
     {
-        direction = RIGHT;
-        g_debug("Join Direction: Right");
+        g_warning ("Area %u is empty or off screen: (%f, %f) to (%f, %f)",
+                   spl_pool_get_index (priv->areas, area),
+                   area->tl->x, area->tl->y, area->br->x, area->br->y);
+        return FALSE;
+    }
 
-        keep->tr = join->tr;
-        keep->br = join->br;
+    return TRUE;
+}
 
-        add_edge (self, create_edge (keep->tl, keep->tr));
-        add_edge (self, create_edge (keep->bl, keep->br));
-    }
-    else if (spl_vertex_is_equal (keep->bl, join->tl) &&
-             spl_vertex_is_equal (keep->br, join->tr))
+// Fills in `side` from a well formed edge, returning its orientation,
+// or NUM_DIRECTIONS if the edge is not one
+static guint
+check_edge (SplTileManager *self,
+            SplEdge        *edge,
+            Side           *side)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    guint index = spl_pool_get_index (priv->edges, edge);
+
+    if (!spl_pool_owns (priv->vertices, edge->v1) ||
+        !spl_pool_owns (priv->vertices, edge->v2))
     {
-        direction = BOTTOM;
-        g_debug("Join Direction: Bottom");
+        g_warning ("Edge %u has an end which is not a vertex", index);
+        return NUM_DIRECTIONS;
+    }
 
-        keep->bl = join->bl;
-        keep->br = join->br;
+    SplVertex *v1 = edge->v1;
+    SplVertex *v2 = edge->v2;
 
-        add_edge (self, create_edge (keep->tl, keep->bl));
-        add_edge (self, create_edge (keep->tr, keep->br));
+    if (v1->x == v2->x && v1->y < v2->y)
+    {
+        *side = (Side) { v1->x, v1->y, v2->y, v1, v2 };
+        return SPL_VERTICAL;
     }
 
-    if (direction == INVALID)
+    if (v1->y == v2->y && v1->x < v2->x)
     {
-        return FALSE;
-        g_debug("Invalid Join");
+        *side = (Side) { v1->y, v1->x, v2->x, v1, v2 };
+        return SPL_HORIZONTAL;
     }
 
-    // Remove join area from list
-    spl_tile_manager_remove_area (self, join);
+    g_warning ("Edge %u is not a horizontal or vertical line running "
+               "top to bottom or left to right", index);
+    return NUM_DIRECTIONS;
+}
+
+// Checks every edge of one orientation against the others and against
+// the sides of the areas
+static gboolean
+check_edges_against_sides (GArray      *edges,
+                           GArray      *sides,
+                           const gchar *orientation)
+{
+    gboolean valid = TRUE;
+
+    for (guint i = 0; i < edges->len; i++)
+    {
+        Side *edge = &g_array_index (edges, Side, i);
+        gboolean bordered = FALSE;
+
+        for (guint j = i + 1; j < edges->len; j++)
+        {
+            if (sides_overlap (edge, &g_array_index (edges, Side, j)))
+            {
+                g_warning ("Overlapping %s edges at %f", orientation, edge->line);
+                valid = FALSE;
+            }
+        }
+
+        for (guint j = 0; j < sides->len && !bordered; j++)
+            bordered = sides_overlap (edge, &g_array_index (sides, Side, j));
+
+        if (!bordered)
+        {
+            g_warning ("%s edge at %f (%f to %f) does not border any area",
+                       orientation, edge->line, edge->start, edge->end);
+            valid = FALSE;
+        }
+    }
+
+    for (guint i = 0; i < sides->len; i++)
+    {
+        Side *side = &g_array_index (sides, Side, i);
+        gboolean covered = FALSE;
+
+        for (guint j = 0; j < edges->len && !covered; j++)
+            covered = side_covers (&g_array_index (edges, Side, j), side);
+
+        if (!covered)
+        {
+            g_warning ("No %s edge along the side of an area at %f (%f to %f)",
+                       orientation, side->line, side->start, side->end);
+            valid = FALSE;
+        }
+    }
+
+    return valid;
+}
+
+static gboolean
+check_node (SplTileManager *self,
+            SplNode        *node,
+            SplNode        *parent,
+            guint          *n_leaves)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    if (node->parent != parent)
+    {
+        g_warning ("Layout tree node has the wrong parent");
+        return FALSE;
+    }
+
+    if (node->area != NULL)
+    {
+        SplArea *area = node->area;
+        (*n_leaves)++;
+
+        if (!spl_pool_owns (priv->areas, area) ||
+            get_node (priv->area_nodes, priv->areas, area) != node)
+        {
+            g_warning ("Layout tree leaf does not hold a live area");
+            return FALSE;
+        }
+
+        if (area->tl->x != node->x0 || area->tl->y != node->y0 ||
+            area->br->x != node->x1 || area->br->y != node->y1)
+        {
+            g_warning ("Area %u is not where the layout tree puts it",
+                       spl_pool_get_index (priv->areas, area));
+            return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    SplNode *first = node->first;
+    SplNode *second = node->second;
+    SplEdge *edge = node->edge;
+
+    if (first == NULL || second == NULL ||
+        !(node->ratio > 0 && node->ratio < 1) ||
+        !spl_pool_owns (priv->edges, edge) ||
+        get_node (priv->edge_nodes, priv->edges, edge) != node)
+    {
+        g_warning ("Layout tree has a malformed split");
+        return FALSE;
+    }
+
+    // The children share out the node, and the edge runs between them
+    gboolean fits;
+
+    if (node->direction == SPL_HORIZONTAL)
+    {
+        fits = (first->x0 == node->x0 && first->x1 == second->x0 && second->x1 == node->x1 &&
+                first->y0 == node->y0 && second->y0 == node->y0 &&
+                first->y1 == node->y1 && second->y1 == node->y1 &&
+                edge->v1->x == first->x1 && edge->v2->x == first->x1 &&
+                edge->v1->y == node->y0 && edge->v2->y == node->y1);
+    }
+    else
+    {
+        fits = (first->y0 == node->y0 && first->y1 == second->y0 && second->y1 == node->y1 &&
+                first->x0 == node->x0 && second->x0 == node->x0 &&
+                first->x1 == node->x1 && second->x1 == node->x1 &&
+                edge->v1->y == first->y1 && edge->v2->y == first->y1 &&
+                edge->v1->x == node->x0 && edge->v2->x == node->x1);
+    }
+
+    if (!fits)
+    {
+        g_warning ("Layout tree split at (%f, %f) to (%f, %f) does not fit its children",
+                   node->x0, node->y0, node->x1, node->y1);
+        return FALSE;
+    }
+
+    return (check_node (self, first, node, n_leaves) &&
+            check_node (self, second, node, n_leaves));
+}
+
+gboolean
+spl_tile_manager_check_invariants (SplTileManager *self)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    gboolean valid = TRUE;
+    gdouble total = 0;
+    GHashTable *used = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    // Areas must be rectangles which tile the screen exactly
+    GPtrArray *areas = g_ptr_array_new ();
+
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
+    {
+        SplArea *area = spl_pool_get (priv->areas, i);
+        if (area == NULL)
+            continue;
+
+        if (!check_area (self, area))
+        {
+            valid = FALSE;
+            continue;
+        }
+
+        g_hash_table_add (used, area->tl);
+        g_hash_table_add (used, area->tr);
+        g_hash_table_add (used, area->bl);
+        g_hash_table_add (used, area->br);
+
+        total += (area->tr->x - area->tl->x) * (area->bl->y - area->tl->y);
+        g_ptr_array_add (areas, area);
+    }
+
+    for (guint i = 0; i < areas->len; i++)
+    {
+        SplArea *area = g_ptr_array_index (areas, i);
+
+        for (guint j = i + 1; j < areas->len; j++)
+        {
+            SplArea *other = g_ptr_array_index (areas, j);
+
+            if (area->tl->x < other->tr->x && other->tl->x < area->tr->x &&
+                area->tl->y < other->bl->y && other->tl->y < area->bl->y)
+            {
+                g_warning ("Areas %u and %u overlap",
+                           spl_pool_get_index (priv->areas, area),
+                           spl_pool_get_index (priv->areas, other));
+                valid = FALSE;
+            }
+        }
+    }
+
+    // The hit testing tables must agree
+    for (guint i = 0; valid && i < areas->len; i++)
+    {
+        SplArea *area = g_ptr_array_index (areas, i);
+        gdouble x = (area->tl->x + area->tr->x) / 2;
+        gdouble y = (area->tl->y + area->bl->y) / 2;
+
+        if (spl_area_get_for_coords (self, x, y) != area)
+        {
+            g_warning ("Area %u is not found at its centre",
+                       spl_pool_get_index (priv->areas, area));
+            valid = FALSE;
+        }
+    }
+
+    g_ptr_array_free (areas, TRUE);
+
+    if (valid && ABS (total - 1.0) > 1e-9)
+    {
+        g_warning ("Areas cover %f of the screen", total);
+        valid = FALSE;
+    }
+
+    // Every side of an area lies along an edge, and edges never overlap
+    GArray *horizontal_edges = g_array_new (FALSE, FALSE, sizeof (Side));
+    GArray *vertical_edges = g_array_new (FALSE, FALSE, sizeof (Side));
+
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->edges); i++)
+    {
+        SplEdge *edge = spl_pool_get (priv->edges, i);
+        if (edge == NULL)
+            continue;
+
+        Side side;
+        guint orientation = check_edge (self, edge, &side);
+
+        if (orientation == SPL_HORIZONTAL)
+            g_array_append_val (horizontal_edges, side);
+        else if (orientation == SPL_VERTICAL)
+            g_array_append_val (vertical_edges, side);
+        else
+            valid = FALSE;
+
+        g_hash_table_add (used, edge->v1);
+        g_hash_table_add (used, edge->v2);
+    }
+
+    if (valid)
+    {
+        GArray *horizontal = g_array_new (FALSE, FALSE, sizeof (Side));
+        GArray *vertical = g_array_new (FALSE, FALSE, sizeof (Side));
+        collect_area_sides (self, horizontal, vertical);
+
+        valid &= check_edges_against_sides (horizontal_edges, horizontal, "Horizontal");
+        valid &= check_edges_against_sides (vertical_edges, vertical, "Vertical");
+
+        g_array_free (horizontal, TRUE);
+        g_array_free (vertical, TRUE);
+    }
+
+    g_array_free (horizontal_edges, TRUE);
+    g_array_free (vertical_edges, TRUE);
+
+    // The layout tree holds every area, where it really is
+    if (priv->root != NULL)
+    {
+        guint n_leaves = 0;
+        SplNode *root = priv->root;
+
+        if (root->x0 != 0 || root->y0 != 0 || root->x1 != 1 || root->y1 != 1)
+        {
+            g_warning ("Layout tree does not cover the screen");
+            valid = FALSE;
+        }
+        else if (!check_node (self, root, NULL, &n_leaves))
+        {
+            valid = FALSE;
+        }
+        else if (n_leaves != spl_pool_get_n_live (priv->areas))
+        {
+            g_warning ("Layout tree holds %u of %u areas",
+                       n_leaves, spl_pool_get_n_live (priv->areas));
+            valid = FALSE;
+        }
+    }
+
+    // And there is nothing left lying around
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->vertices); i++)
+    {
+        SplVertex *vertex = spl_pool_get (priv->vertices, i);
+
+        if (vertex != NULL && !g_hash_table_contains (used, vertex))
+        {
+            g_warning ("Vertex %u (%f, %f) is not used", i, vertex->x, vertex->y);
+            valid = FALSE;
+        }
+    }
+
+    g_hash_table_destroy (used);
+
+    return valid;
+}
+
+gboolean within_safety(gdouble n1,
+                       gdouble n2,
+                       gdouble safety)
+{
+    if (n1 > n2)
+        return ((n1 - n2) < safety);
+    else
+        return ((n2 - n1) < safety);
+}
+
+gboolean within_range(gdouble n,
+                      gdouble start,
+                      gdouble end)
+{
+    if (n > start && n < end)
+        return TRUE;
+    else
+        return FALSE;
+}
+
+guint
+spl_edge_get_orientation(SplEdge* edge)
+{
+    SplVertex* v1 = edge->v1;
+    SplVertex* v2 = edge->v2;
+
+    if (v1->x == v2->x)
+    {
+        return SPL_VERTICAL;
+    }
+    else if (v1->y == v2->y)
+    {
+        return SPL_HORIZONTAL;
+    }
+    else
+    {
+        g_error("Malformed line");
+        return 0;
+    }
+}
+
+SplArea *
+spl_tile_manager_get_any (SplTileManager *self)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
+    {
+        SplArea *area = spl_pool_get (priv->areas, i);
+        if (area != NULL)
+            return area;
+    }
+
+    return NULL;
+}
+
+static gboolean
+spl_vertex_is_equal(SplVertex *v1, SplVertex *v2)
+{
+    return (v1->x == v2->x &&
+            v1->y == v2->y);
+}
+
+static void
+spl_tile_manager_remove_area (SplTileManager *self, SplArea *remove)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    priv->index_dirty = TRUE;
+
+    g_signal_emit (self, signals[AREA_REMOVED], 0, spl_area_get_userdata (remove));
+
+    // The slots are reused by the next area created
+    set_node (priv->area_nodes, priv->areas, remove, NULL);
+    spl_pool_release (priv->vertices, remove->tl);
+    spl_pool_release (priv->vertices, remove->tr);
+    spl_pool_release (priv->vertices, remove->bl);
+    spl_pool_release (priv->vertices, remove->br);
+    spl_pool_release (priv->areas, remove);
+    priv->area_list_dirty = TRUE;
+}
+
+typedef struct
+{
+    gdouble x0, y0, x1, y1;
+    SplArea *area;
+} TreeItem;
+
+static gint
+compare_items_x (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+    const TreeItem *i1 = a;
+    const TreeItem *i2 = b;
+
+    if (i1->x0 != i2->x0)
+        return (i1->x0 < i2->x0) ? -1 : 1;
+
+    return 0;
+}
+
+static gint
+compare_items_y (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+    const TreeItem *i1 = a;
+    const TreeItem *i2 = b;
+
+    if (i1->y0 != i2->y0)
+        return (i1->y0 < i2->y0) ? -1 : 1;
+
+    return 0;
+}
+
+// Finds a line across the whole of `items` which does not cut through
+// any of them, trying x first. Returns the number of items before it,
+// or 0 if there is no such line.
+static guint
+find_cut (TreeItem *items,
+          guint     n_items,
+          guint    *direction)
+{
+    g_qsort_with_data (items, n_items, sizeof (TreeItem), compare_items_x, NULL);
+
+    gdouble reach = 0;
+
+    for (guint i = 0; i + 1 < n_items; i++)
+    {
+        reach = MAX (reach, items[i].x1);
+
+        if (reach <= items[i + 1].x0)
+        {
+            *direction = SPL_HORIZONTAL;
+            return i + 1;
+        }
+    }
+
+    g_qsort_with_data (items, n_items, sizeof (TreeItem), compare_items_y, NULL);
+
+    reach = 0;
+
+    for (guint i = 0; i + 1 < n_items; i++)
+    {
+        reach = MAX (reach, items[i].y1);
+
+        if (reach <= items[i + 1].y0)
+        {
+            *direction = SPL_VERTICAL;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+// Builds a tree for `items`, which exactly cover the given extent, by
+// cutting it in two again and again. Without `self`, only checks that
+// it can be done, as not every layout of rectangles can be cut up.
+static gboolean
+build_tree (SplTileManager  *self,
+            TreeItem        *items,
+            guint            n_items,
+            gdouble          x0,
+            gdouble          y0,
+            gdouble          x1,
+            gdouble          y1,
+            SplNode         *parent,
+            SplNode        **out)
+{
+    if (n_items == 1)
+    {
+        if (self != NULL)
+        {
+            *out = create_leaf (self, items[0].area, parent);
+            set_rect (*out, x0, y0, x1, y1);
+        }
+
+        return TRUE;
+    }
 
-    // Delete join area
-    // g_free(join);
+    guint direction;
+    guint n_first = find_cut (items, n_items, &direction);
 
-    // Remove doubles and unused vertices
-    // TODO
+    if (n_first == 0)
+        return FALSE;
+
+    gdouble cut = (direction == SPL_HORIZONTAL) ? items[n_first].x0 : items[n_first].y0;
+    gdouble fx1 = (direction == SPL_HORIZONTAL) ? cut : x1;
+    gdouble fy1 = (direction == SPL_VERTICAL) ? cut : y1;
+    gdouble sx0 = (direction == SPL_HORIZONTAL) ? cut : x0;
+    gdouble sy0 = (direction == SPL_VERTICAL) ? cut : y0;
+
+    if (self == NULL)
+    {
+        return (build_tree (NULL, items, n_first, x0, y0, fx1, fy1, NULL, NULL) &&
+                build_tree (NULL, items + n_first, n_items - n_first, sx0, sy0, x1, y1, NULL, NULL));
+    }
+
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    SplNode *node = spl_pool_alloc (priv->nodes);
+    node->parent = parent;
+    set_rect (node, x0, y0, x1, y1);
+
+    // The edge goes exactly where the areas meet, which the ratio may
+    // only come close to
+    if (direction == SPL_HORIZONTAL)
+    {
+        make_split (self, node, direction, (cut - x0) / (x1 - x0));
+        set_vertex (node->edge->v1, cut, y0);
+        set_vertex (node->edge->v2, cut, y1);
+    }
+    else
+    {
+        make_split (self, node, direction, (cut - y0) / (y1 - y0));
+        set_vertex (node->edge->v1, x0, cut);
+        set_vertex (node->edge->v2, x1, cut);
+    }
+
+    build_tree (self, items, n_first, x0, y0, fx1, fy1, node, &node->first);
+    build_tree (self, items + n_first, n_items - n_first, sx0, sy0, x1, y1, node, &node->second);
+
+    *out = node;
+    return TRUE;
+}
+
+// Joins two areas which share a whole side but are not siblings, by
+// building the tree again from where the areas are
+static gboolean
+join_by_position (SplTileManager *self,
+                  SplArea        *keep,
+                  SplArea        *join)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    GArray *items = g_array_new (FALSE, FALSE, sizeof (TreeItem));
+
+    for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
+    {
+        SplArea *area = spl_pool_get (priv->areas, i);
+        if (area == NULL || area == join)
+            continue;
+
+        TreeItem item = { area->tl->x, area->tl->y, area->br->x, area->br->y, area };
+
+        if (area == keep)
+        {
+            item.x0 = MIN (keep->tl->x, join->tl->x);
+            item.y0 = MIN (keep->tl->y, join->tl->y);
+            item.x1 = MAX (keep->br->x, join->br->x);
+            item.y1 = MAX (keep->br->y, join->br->y);
+        }
+
+        g_array_append_val (items, item);
+    }
+
+    TreeItem *data = &g_array_index (items, TreeItem, 0);
+    gboolean possible = build_tree (NULL, data, items->len, 0, 0, 1, 1, NULL, NULL);
+
+    if (possible)
+    {
+        free_tree (self, priv->root);
+        spl_tile_manager_remove_area (self, join);
+        build_tree (self, data, items->len, 0, 0, 1, 1, NULL, &priv->root);
+        layout_node (get_node (priv->area_nodes, priv->areas, keep));
+    }
+    else
+    {
+        g_debug ("Joined areas could not be cut apart again");
+    }
+
+    g_array_free (items, TRUE);
+    return possible;
+}
+
+gboolean
+spl_area_join(SplTileManager *self, SplArea *keep, SplArea *join)
+{
+    if (join == NULL ||
+        keep == NULL ||
+        !(SPL_IS_TILE_MANAGER (self)))
+        return FALSE;
+
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    if (keep == join ||
+        !spl_pool_owns (priv->areas, keep) ||
+        !spl_pool_owns (priv->areas, join))
+        return FALSE;
+
+    SplNode *keep_node = get_node (priv->area_nodes, priv->areas, keep);
+    SplNode *join_node = get_node (priv->area_nodes, priv->areas, join);
+    SplNode *parent = keep_node->parent;
+
+    // Siblings are joined by turning their parent back into a leaf
+    if (parent != NULL && parent == join_node->parent)
+    {
+        g_debug("Join Direction: Sibling");
+
+        release_edge (self, parent->edge);
+        parent->edge = NULL;
+        parent->first = NULL;
+        parent->second = NULL;
+        parent->area = keep;
+        set_node (priv->area_nodes, priv->areas, keep, parent);
+
+        spl_pool_release (priv->nodes, keep_node);
+        spl_pool_release (priv->nodes, join_node);
+
+        // Remove and delete join area
+        spl_tile_manager_remove_area (self, join);
+        layout_node (parent);
+
+        // Return success
+        return TRUE;
+    }
+
+    // Otherwise they need to share a whole side
+    if ((spl_vertex_is_equal (keep->tl, join->tr) &&
+         spl_vertex_is_equal (keep->bl, join->br)) ||
+        (spl_vertex_is_equal (keep->tl, join->bl) &&
+         spl_vertex_is_equal (keep->tr, join->br)) ||
+        (spl_vertex_is_equal (keep->tr, join->tl) &&
+         spl_vertex_is_equal (keep->br, join->bl)) ||
+        (spl_vertex_is_equal (keep->bl, join->tl) &&
+         spl_vertex_is_equal (keep->br, join->tr)))
+    {
+        return join_by_position (self, keep, join);
+    }
+
+    g_debug("Invalid Join");
+    return FALSE;
+}
+
+gboolean
+spl_area_swap (SplTileManager *self,
+               SplArea        *a,
+               SplArea        *b)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    if (!spl_pool_owns (priv->areas, a) ||
+        !spl_pool_owns (priv->areas, b))
+        return FALSE;
+
+    SplNode *node_a = get_node (priv->area_nodes, priv->areas, a);
+    SplNode *node_b = get_node (priv->area_nodes, priv->areas, b);
+
+    node_a->area = b;
+    node_b->area = a;
+    set_node (priv->area_nodes, priv->areas, a, node_b);
+    set_node (priv->area_nodes, priv->areas, b, node_a);
+
+    layout_node (node_a);
+    layout_node (node_b);
+    priv->index_dirty = TRUE;
+
+    return TRUE;
+}
+
+static void
+save_node (SplNode         *node,
+           GVariantBuilder *builder)
+{
+    if (node->area != NULL)
+    {
+        g_variant_builder_add (builder, "(yd)", 'a', 0.0);
+        return;
+    }
+
+    g_variant_builder_add (builder, "(yd)",
+                           (node->direction == SPL_HORIZONTAL) ? 'h' : 'v',
+                           node->ratio);
+    save_node (node->first, builder);
+    save_node (node->second, builder);
+}
+
+GVariant *
+spl_tile_manager_save_layout (SplTileManager *self)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(yd)"));
+
+    if (priv->root != NULL)
+        save_node (priv->root, &builder);
+
+    return g_variant_builder_end (&builder);
+}
+
+// Checks that the entries from `*position` on describe a whole tree
+static gboolean
+check_layout (GVariant *layout,
+              gsize    *position)
+{
+    if (*position >= g_variant_n_children (layout))
+        return FALSE;
+
+    guchar type;
+    gdouble ratio;
+    g_variant_get_child (layout, (*position)++, "(yd)", &type, &ratio);
+
+    if (type == 'a')
+        return TRUE;
+
+    if ((type != 'h' && type != 'v') ||
+        !(ratio > 0 && ratio < 1))
+        return FALSE;
+
+    return (check_layout (layout, position) &&
+            check_layout (layout, position));
+}
+
+static SplNode *
+load_node (SplTileManager *self,
+           GVariant       *layout,
+           gsize          *position,
+           SplNode        *parent)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    guchar type;
+    gdouble ratio;
+    g_variant_get_child (layout, (*position)++, "(yd)", &type, &ratio);
+
+    if (type == 'a')
+        return create_leaf (self, spl_tile_manager_create_area (self), parent);
+
+    SplNode *node = spl_pool_alloc (priv->nodes);
+    node->parent = parent;
+    make_split (self, node, (type == 'h') ? SPL_HORIZONTAL : SPL_VERTICAL, ratio);
+    node->first = load_node (self, layout, position, node);
+    node->second = load_node (self, layout, position, node);
+
+    return node;
+}
+
+static void
+announce_areas (SplTileManager *self,
+                SplNode        *node)
+{
+    if (node->area != NULL)
+    {
+        spl_tile_manager_area_created (self, node->area);
+        return;
+    }
+
+    announce_areas (self, node->first);
+    announce_areas (self, node->second);
+}
+
+gboolean
+spl_tile_manager_load_layout (SplTileManager *self,
+                              GVariant       *layout)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+
+    g_return_val_if_fail (g_variant_is_of_type (layout, G_VARIANT_TYPE ("a(yd)")), FALSE);
+
+    gsize position = 0;
+
+    if (!check_layout (layout, &position) ||
+        position != g_variant_n_children (layout))
+    {
+        g_debug ("Invalid layout");
+        return FALSE;
+    }
+
+    // Out with the old
+    if (priv->root != NULL)
+    {
+        for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
+        {
+            SplArea *area = spl_pool_get (priv->areas, i);
+            if (area != NULL)
+                spl_tile_manager_remove_area (self, area);
+        }
+
+        free_tree (self, priv->root);
+    }
+
+    // In with the new
+    position = 0;
+    priv->root = load_node (self, layout, &position, NULL);
+    set_rect (priv->root, 0, 0, 1, 1);
+    layout_node (priv->root);
+
+    create_borders (self);
+    announce_areas (self, priv->root);
 
-    // Return success
     return TRUE;
 }
 
@@ -958,136 +1698,132 @@ spl_edge_is_border (SplEdge *edge)
     return FALSE;
 }
 
-// This function takes the vertices of an SplEdge and moves them to the
-// correct position. This has the added benefit of updating all edges and
-// areas which point to them for free. To avoid malformed edges for areas
-// with an edge not at a vertex, we find all connected edges in the given
-// direction, and resize appropriately.
-gboolean
-spl_edge_move (SplTileManager *self,
-               SplEdge *edge,
-               gdouble new_pos)
+static gdouble *
+get_bound (SplNode  *node,
+           gboolean  along_x,
+           gboolean  end)
 {
-    guint orientation = spl_edge_get_orientation (edge);
+    if (along_x)
+        return end ? &node->x1 : &node->x0;
 
-    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
+    return end ? &node->y1 : &node->y0;
+}
 
-    // Don't let border edges be moved
-    if (spl_edge_is_border (edge))
-        return FALSE;
+// Only the areas touching the `end` (or start) side of `node` change
+// when that side moves. Returns the furthest it can go before the one
+// that shrinks most would vanish: their innermost opposite side.
+static gdouble
+get_side_limit (SplNode  *node,
+                gboolean  along_x,
+                gboolean  end)
+{
+    if (node->area != NULL)
+        return *get_bound (node, along_x, !end);
 
-    // Minimum sizes
-    // Get areas attached to each vertex
-    for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+    // Splits along the same axis only have one child on that side
+    if ((node->direction == SPL_HORIZONTAL) == along_x)
+        return get_side_limit (end ? node->second : node->first, along_x, end);
+
+    gdouble first = get_side_limit (node->first, along_x, end);
+    gdouble second = get_side_limit (node->second, along_x, end);
+
+    return end ? MAX (first, second) : MIN (first, second);
+}
+
+// Moves the `end` (or start) side of `node` to `pos`. Every divider inside
+// stays where it is, so only the areas along that side and the ends of the
+// edges meeting it are updated.
+static void
+move_side (SplNode  *node,
+           gboolean  along_x,
+           gboolean  end,
+           gdouble   pos)
+{
+    *get_bound (node, along_x, end) = pos;
+
+    if (node->area != NULL)
     {
-        SplArea *area = elem->data;
-        gboolean connected = FALSE;
-        if (orientation == SPL_VERTICAL)
-        {
-            // Line is vertical, check if either
-            // (tl and bl) or (tr and br) equal
-            // this edge. It is convention that edge
-            // v1 will be top and edge v2 will be bottom
+        SplArea *area = node->area;
+
+        if (along_x && end)
+            area->tr->x = area->br->x = pos;
+        else if (along_x)
+            area->tl->x = area->bl->x = pos;
+        else if (end)
+            area->bl->y = area->br->y = pos;
+        else
+            area->tl->y = area->tr->y = pos;
 
-            gdouble width;
+        return;
+    }
 
-            // Left Edge
-            if (area->tl == edge->v1 ||
-                area->bl == edge->v2)
-            {
-                connected = TRUE;
-                width = area->tr->x - new_pos;
-            }
+    if ((node->direction == SPL_HORIZONTAL) == along_x)
+    {
+        move_side (end ? node->second : node->first, along_x, end, pos);
 
-            // Right Edge
-            if (area->tr == edge->v1 ||
-                area->br == edge->v2)
-            {
-                connected = TRUE;
-                width = new_pos - area->tl->x;
-            }
+        // Keep the divider in place
+        gdouble start = *get_bound (node, along_x, FALSE);
+        gdouble divider = *get_bound (node->first, along_x, TRUE);
+        node->ratio = (divider - start) / (*get_bound (node, along_x, TRUE) - start);
+        return;
+    }
 
-            if (connected &&
-                width < priv->min_size)
-                return FALSE; // Deny the resize
-        }
-        if (orientation == SPL_HORIZONTAL)
-        {
-            // Line is horizontal, check if either
-            // (tl and tr) or (bl and br) equal
-            // this edge. It is convention that edge
-            // v1 will be left and edge v2 will be right
+    // The edge between the children runs into the side being moved
+    SplVertex *vertex = end ? node->edge->v2 : node->edge->v1;
 
-            gdouble height;
+    if (along_x)
+        vertex->x = pos;
+    else
+        vertex->y = pos;
 
-            // Top Edge
-            if (area->tl == edge->v1 ||
-                area->tr == edge->v2)
-            {
-                connected = TRUE;
-                height = area->bl->y - new_pos;
-            }
+    move_side (node->first, along_x, end, pos);
+    move_side (node->second, along_x, end, pos);
+}
 
-            // Bottom Edge
-            if (area->bl == edge->v1 ||
-                area->br == edge->v2)
-            {
-                connected = TRUE;
-                height = new_pos - area->tr->y;
-            }
+// Each edge between areas belongs to the split node it divides. Moving
+// it only resizes the areas on either side that touch it, and shortens
+// or lengthens the edges that end on it. Nothing else in the layout moves.
+gboolean
+spl_edge_move (SplTileManager *self,
+               SplEdge *edge,
+               gdouble new_pos)
+{
+    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-            if (connected &&
-                height < priv->min_size)
-                return FALSE; // Deny the resize
-        }
-    }
+    if (!spl_pool_owns (priv->edges, edge))
+        return FALSE;
 
-    // The line is vertical
-    if (orientation == SPL_VERTICAL)
-    {
-        g_assert (edge->v1->x == edge->v2->x);
+    SplNode *node = get_node (priv->edge_nodes, priv->edges, edge);
 
-        // Find connected vertices
-        gdouble old_x = edge->v1->x;
-        for (GList *elem = priv->vertices; elem != NULL; elem = elem->next)
-        {
-            SplVertex *cmp = elem->data;
-            if (cmp->x == old_x)
-            {
-                g_debug ("New Vertex x = %f", new_pos);
-                cmp->x = new_pos;
-            }
-        }
+    // Don't let border edges be moved
+    if (node == NULL)
+        return FALSE;
 
-        return TRUE;
-    }
+    gboolean along_x = (node->direction == SPL_HORIZONTAL);
+    gdouble low = get_side_limit (node->first, along_x, TRUE);
+    gdouble high = get_side_limit (node->second, along_x, FALSE);
 
-    // The line is horizontal
-    if (orientation == SPL_HORIZONTAL)
-    {
-        g_assert (edge->v1->y == edge->v2->y);
+    // Minimum sizes
+    if (new_pos <= low ||
+        new_pos >= high ||
+        new_pos - low < priv->min_size ||
+        high - new_pos < priv->min_size)
+        return FALSE; // Deny the resize
 
-        // Find connected vertices
-        gdouble old_y = edge->v1->y;
-        for (GList *elem = priv->vertices; elem != NULL; elem = elem->next)
-        {
-            SplVertex *cmp = elem->data;
-            if (cmp->y == old_y)
-            {
-                cmp->y = new_pos;
-                g_debug ("New Vertex y = %f", new_pos);
-            }
-        }
+    move_side (node->first, along_x, TRUE, new_pos);
+    move_side (node->second, along_x, FALSE, new_pos);
 
-        return TRUE;
-    }
+    gdouble start = *get_bound (node, along_x, FALSE);
+    node->ratio = (new_pos - start) / (*get_bound (node, along_x, TRUE) - start);
 
-    // print_vertex_single (edge->v1);
-    // print_vertex_single (edge->v2);
+    if (along_x)
+        edge->v1->x = edge->v2->x = new_pos;
+    else
+        edge->v1->y = edge->v2->y = new_pos;
 
-    // print_areas (self);
+    priv->index_dirty = TRUE;
 
-    return FALSE;
+    return TRUE;
 }
 
 gboolean
@@ -1138,39 +1874,32 @@ spl_area_check_for_coords (SplArea *area, gdouble mouse_x, gdouble mouse_y)
     return FALSE;
 }
 
-SplArea*
-spl_area_get_for_coords (SplTileManager *self, gdouble mouse_x, gdouble mouse_y)
+static SplIndex *
+get_index (SplTileManager *self)
 {
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
 
-    for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+    // Moves only come in while dragging, and hit tests mostly while
+    // not, so the tables are rebuilt once between the two
+    if (priv->index_dirty)
     {
-        SplArea *area = elem->data;
-        if (spl_area_check_for_coords(area, mouse_x, mouse_y))
-        {
-            return area;
-        }
+        spl_index_rebuild (priv->index, priv->areas, priv->edges);
+        priv->index_dirty = FALSE;
     }
 
-    return NULL;
+    return priv->index;
+}
+
+SplArea*
+spl_area_get_for_coords (SplTileManager *self, gdouble mouse_x, gdouble mouse_y)
+{
+    return spl_index_find_area (get_index (self), mouse_x, mouse_y);
 }
 
 SplEdge*
 spl_edge_get_for_coords (SplTileManager *self, gdouble mouse_x, gdouble mouse_y, gdouble safety)
 {
-    SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-
-    for (GList *elem = priv->edges; elem != NULL; elem = elem->next)
-    {
-        SplEdge* edge = elem->data;
-        if (spl_edge_check_for_coords(edge, mouse_x, mouse_y, safety))
-        {
-            return edge;
-        }
-    }
-
-    // No edge found (default behaviour)
-    return NULL;
+    return spl_index_find_edge (get_index (self), mouse_x, mouse_y, safety);
 }
 
 SplArea* focus_nav_get_adjacent(SplTileManager *context, SplArea *area, guint direction, gboolean inverse)
@@ -1185,9 +1914,12 @@ SplArea* focus_nav_get_adjacent(SplTileManager *context, SplArea *area, guint di
             SplVertex* vert = area->bl;
 
             // Find area where vert is tl
-            for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+            for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
             {
-                SplArea *iter = elem->data;
+                SplArea *iter = spl_pool_get (priv->areas, i);
+                if (iter == NULL)
+                    continue;
+
                 if (spl_vertex_is_equal (vert, iter->tl))
                     return iter;
             }
@@ -1198,9 +1930,12 @@ SplArea* focus_nav_get_adjacent(SplTileManager *context, SplArea *area, guint di
             SplVertex* vert = area->tl;
 
             // Find area where vert is bl
-            for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+            for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
             {
-                SplArea *iter = elem->data;
+                SplArea *iter = spl_pool_get (priv->areas, i);
+                if (iter == NULL)
+                    continue;
+
                 if (spl_vertex_is_equal (vert, iter->bl))
                     return iter;
             }
@@ -1214,9 +1949,12 @@ SplArea* focus_nav_get_adjacent(SplTileManager *context, SplArea *area, guint di
             SplVertex* vert = area->tr;
 
             // Find area where vert is tl
-            for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+            for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
             {
-                SplArea *iter = elem->data;
+                SplArea *iter = spl_pool_get (priv->areas, i);
+                if (iter == NULL)
+                    continue;
+
                 if (spl_vertex_is_equal (vert, iter->tl))
                     return iter;
             }
@@ -1227,9 +1965,12 @@ SplArea* focus_nav_get_adjacent(SplTileManager *context, SplArea *area, guint di
             SplVertex* vert = area->tl;
 
             // Find area where vert is tr
-            for (GList *elem = priv->areas; elem != NULL; elem = elem->next)
+            for (guint i = 0; i < spl_pool_get_n_slots (priv->areas); i++)
             {
-                SplArea *iter = elem->data;
+                SplArea *iter = spl_pool_get (priv->areas, i);
+                if (iter == NULL)
+                    continue;
+
                 if (spl_vertex_is_equal (vert, iter->tr))
                     return iter;
             }
@@ -1248,48 +1989,79 @@ GList *
 spl_tile_manager_get_areas(SplTileManager *self)
 {
     SplTileManagerPrivate *priv = spl_tile_manager_get_instance_private (self);
-    return priv->areas;
+
+    if (priv->area_list_dirty)
+    {
+        g_clear_pointer (&priv->area_list, g_list_free);
+
+        for (guint i = spl_pool_get_n_slots (priv->areas); i > 0; i--)
+        {
+            SplArea *area = spl_pool_get (priv->areas, i - 1);
+            if (area != NULL)
+                priv->area_list = g_list_prepend (priv->area_list, area);
+        }
+
+        priv->area_list_dirty = FALSE;
+    }
+
+    return priv->area_list;
 }
 
 // Workflow
 //
 // # Assumptions
-// All calculations will be done in screen space coordinates, which will be
-// defined to be between 0 and 100 (guint).
+// All calculations are done in normalised coordinates (gdouble), from (0, 0)
+// at the top left to (1, 1) at the bottom right. They only become pixels
+// through `spl_scale_width` and `spl_scale_height`, so resizing the screen
+// never changes the layout.
+//
+// # Layout Tree
+// The layout is a binary tree of SplNodes, each covering the rectangle
+// (x0, y0) to (x1, y1). A leaf holds one area. Any other node is split in a
+// direction, SPL_HORIZONTAL for halves side by side and SPL_VERTICAL for
+// halves on top of each other, and its ratio is the share of the rectangle
+// given to the first (left or top) half. It also owns the edge between the
+// two halves. The leaf for an area and the node for an edge are found by
+// pool index in `area_nodes` and `edge_nodes`. The four border edges have
+// no node and never move.
 //
 // # Splitting
 // Find direction of split (vertical/horizontal). Find the factor of the split
 // from either left to right or top to bottom (e.g. 0.6 means that the new tile
-// will appear on the right for a vertical split). Take the area and resize it
-// to give it its new, smaller allocation. Create a new area in the left over
-// space. Fix edges and vertices and add them to the corresponding linked lists.
-// Finally, clean up vertices and edges.
+// will appear on the right for a vertical split). Turn the area's leaf into a
+// split node with the old and new areas as its children, and lay it out.
 //
 // # Joining
-// Get two areas. Check that they are eligible for joining (vertices match up
-// and areas share an edge). Remove the second area, and resize the
-// first area to take up its entire allocation. Clean up vertices and edges.
+// Get two areas. If they are siblings, their parent becomes a leaf for the
+// first area. Otherwise check that they share a whole side, remove the second
+// area, and rebuild the tree from the positions of the remaining areas. The
+// join is refused if those cannot be cut back into halves.
+//
+// # Moving
+// Moving an edge sets the ratio of the node that owns it. Only the leaves
+// touching the edge on either side are resized. Nodes between them and the
+// edge adjust their own ratios so that every other divider stays where it
+// is.
 //
 // # Inserting
-// Get any edge. Find the orientation of the edge. Get areas adjacent to the
-// edge. Find the total size of the two areas, and divide it equally between
-// the three areas. Resize and reposition the newly inserted area. It is the
-// calling function's responsiblity to get connected edges. Alternatively, they
-// can call the insert_connected variant of the function.
+// Get any edge and the node that owns it. Split the leaf on one side of the
+// edge in the edge's direction, then set the ratios of the new split node and
+// its parent so the three areas share the parent's extent equally. Only the
+// parent's subtree has to be laid out again. Inserting beside a run of
+// connected edges is the same thing done to the nearest common ancestor.
 //
 // # Removing
-// Find the orientational preference (default is vertical). Firstly, look at
-// area edges and see if there is an adjacent area with the same height/width
-// (depending on preference). If there is, resize that area to take up the
-// combined allocation of both. If there are connected edges with the same
-// height/width, then allow that group to fill the removed area. If no candidate
-// area can be found, then remove anyway and resize horizontally and vertically
-// to take up the remaining space.
+// Find the area's leaf. Its sibling takes its parent's place in the tree and
+// is laid out over the parent's rectangle, so it fills the space the area
+// leaves behind. The parent's edge and the area's vertices are released. This
+// is the sibling case of joining, so a removal never fails and never has to
+// look further than one node.
 //
 // # Swap
-// This simply takes two areas and swaps their vertices and edges.
+// This simply takes two areas and swaps their leaves in the tree.
 //
 // # Safety
-// Rather than have complicated clean up functions like Blender, and to reduce
-// complexity, each function must be responsible for cleaning up any vertices
-// it touches. This ensures that functions use computing power appropriately.
+// Every area owns its four vertices and every edge its two, so nothing is
+// shared between them, and releasing one releases its vertices with it.
+// Coordinates are only written by laying out a subtree from its ratios or
+// by moving an edge, so they always agree with the tree.
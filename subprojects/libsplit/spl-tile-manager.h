@@ -98,6 +98,33 @@ SplArea*          spl_tile_manager_get_any (SplTileManager *self);
 
 
 
+// Check that the areas tile the screen without gaps or overlaps, that every
+// side of an area lies along an edge, that the layout tree agrees with
+// them and that no vertices are left unused. Every problem found is logged
+// as a warning. Returns FALSE if there were any, for use in tests.
+gboolean          spl_tile_manager_check_invariants (SplTileManager *self);
+
+
+
+// Describe the layout as a GVariant of type a(yd), which can be stored and
+// given to `spl_tile_manager_load_layout` later. Each entry is a node of the
+// layout tree, listed before the two nodes it is split into: ('h', ratio)
+// for a split with areas side by side, ('v', ratio) for one with areas on
+// top of each other, and ('a', 0) for an area. The ratio is the share of
+// the node given to the left or top.
+GVariant *        spl_tile_manager_save_layout (SplTileManager *self);
+
+
+
+// Replace the current layout with one from `spl_tile_manager_save_layout`.
+// Every area is removed, and new ones are created in the order the layout
+// lists them. Returns FALSE without changing anything if the layout is
+// not valid.
+gboolean          spl_tile_manager_load_layout (SplTileManager *self,
+                                                GVariant       *layout);
+
+
+
 //
 guint spl_scale_width (SplTileManager *self, gdouble value);
 guint spl_scale_height (SplTileManager *self, gdouble value);
@@ -111,7 +138,10 @@ gdouble spl_unscale_height (SplTileManager *self, guint mouse);
 // ==============
 
 // Move an edge. Update the given edge's vertices to
-// resize the associated areas
+// resize the associated areas. `edge` must come from this manager's
+// `spl_edge_get_for_coords` since the layout last changed, as joins
+// and loads free edges and splits reuse their slots. A freed edge is
+// refused with FALSE only until then.
 gboolean  spl_edge_move (SplTileManager *self,
                          SplEdge        *edge,
                          gdouble         new_pos);
@@ -139,6 +169,13 @@ gboolean  spl_edge_check_for_coords (SplEdge *edge,
 // --------------
 // ==============
 
+// Areas are checked against the manager's pool in constant time, which
+// only works for pointers it handed out. Passing anything else (a
+// pointer from another allocator, or from a manager since finalized) is
+// undefined behaviour. An area removed by a join or a load is caught as
+// foreign until a later split reuses its slot. After that the old pointer
+// names the new area, so drop areas once "area-removed" is emitted.
+
 // Set the area's associated data
 void      spl_area_set_userdata (SplArea  *area,
                                  gpointer  data);
@@ -154,7 +191,8 @@ gdouble   spl_area_get_width (SplArea *area);
 
 // Split the area into two distinct areas. If the operation
 // succeeds, return the newly created SplArea, otherwise return
-// NULL if they area could not be split
+// NULL if they area could not be split. `area` must be live in
+// this manager; a foreign one aborts.
 SplArea * spl_area_split (SplTileManager *self,
                           SplArea        *area,
                           guint           direction,
@@ -162,8 +200,18 @@ SplArea * spl_area_split (SplTileManager *self,
 
 // Join the two areas into one area, deleting the second area. If
 // the operation is successful, return TRUE, otherwise return FALSE.
+// Areas that are not live in this manager are refused with FALSE.
+// `join` is released here, so it must not be passed to any function
+// afterwards.
 gboolean  spl_area_join(SplTileManager *self, SplArea *keep, SplArea *join);
 
+// Swap the places of the two areas. Return TRUE if successful.
+// Areas that are not live in this manager are refused with FALSE.
+// Neither area is freed.
+gboolean  spl_area_swap (SplTileManager *self,
+                         SplArea        *a,
+                         SplArea        *b);
+
 // Get the area at the given coordinates
 SplArea * spl_area_get_for_coords (SplTileManager *self,
                                    gdouble         mouse_x,
@@ -0,0 +1,230 @@
+/* bl-journal-test.c
+ *
+ * Copyright 2019 Matthew Jakeman <mjakeman26@outlook.co.nz>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Replays a journal cut short at every byte, as a crash part way
+// through a write would leave it. Each replay must stop cleanly at a
+// record boundary, giving the document as it was after some prefix of
+// the edits.
+
+#include "bl-journal.h"
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define BASE_TEXT "base text\n"
+
+typedef struct
+{
+    gchar type;
+    gint first;
+    gint second;
+    const gchar *text;
+} Edit;
+
+// Multi-byte characters and inserted newlines, so that character and
+// byte offsets disagree and a record's text can look like a record
+static const Edit edits[] = {
+    { 'i', 0, 0, "héllo " },
+    { 'd', 2, 4, NULL },
+    { 'i', 8, 0, "wörld\ni 9 0 1\n" },
+    { 'd', 0, 1, NULL },
+    { 'i', 3, 0, "" },
+    { 'i', 0, 0, "ünd\n" },
+};
+
+static gchar *
+write_journal (void)
+{
+    GString *log = g_string_new ("BLUEDIT-JOURNAL 1\n");
+    g_string_append (log, "uri file:///tmp/replay.md\n");
+
+    // No hash, so only the length of the base is checked
+    g_string_append_printf (log, "base %d 0\n", (gint)g_utf8_strlen (BASE_TEXT, -1));
+
+    for (guint i = 0; i < G_N_ELEMENTS (edits); i++)
+    {
+        const Edit *edit = &edits[i];
+
+        if (edit->type == 'i')
+        {
+            g_string_append_printf (log, "i %u %d %" G_GSIZE_FORMAT "\n%s\n",
+                                    i + 1, edit->first, strlen (edit->text), edit->text);
+        }
+        else
+        {
+            g_string_append_printf (log, "d %u %d %d\n",
+                                    i + 1, edit->first, edit->second);
+        }
+    }
+
+    return g_string_free (log, FALSE);
+}
+
+// The document after each prefix of the edits, the base first
+static GPtrArray *
+expected_states (void)
+{
+    GPtrArray *states = g_ptr_array_new_with_free_func (g_free);
+    GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+    GtkTextIter start;
+    GtkTextIter end;
+
+    gtk_text_buffer_set_text (buffer, BASE_TEXT, -1);
+
+    for (guint i = 0; i <= G_N_ELEMENTS (edits); i++)
+    {
+        gtk_text_buffer_get_bounds (buffer, &start, &end);
+        g_ptr_array_add (states, gtk_text_buffer_get_text (buffer, &start, &end, TRUE));
+
+        if (i == G_N_ELEMENTS (edits))
+            break;
+
+        const Edit *edit = &edits[i];
+        gtk_text_buffer_get_iter_at_offset (buffer, &start, edit->first);
+
+        if (edit->type == 'i')
+        {
+            gtk_text_buffer_insert (buffer, &start, edit->text, -1);
+        }
+        else
+        {
+            gtk_text_buffer_get_iter_at_offset (buffer, &end, edit->second);
+            gtk_text_buffer_delete (buffer, &start, &end);
+        }
+    }
+
+    g_object_unref (buffer);
+    return states;
+}
+
+// Most cuts leave a damaged record at the end, which is warned about
+// but is what this test is for
+static gboolean
+ignore_damaged_record (const gchar    *log_domain,
+                       GLogLevelFlags  log_level,
+                       const gchar    *message,
+                       gpointer        user_data)
+{
+    return strstr (message, "damaged record") == NULL;
+}
+
+static void
+test_journal_truncated (void)
+{
+    gchar *journal = write_journal ();
+    gsize length = strlen (journal);
+    GPtrArray *states = expected_states ();
+
+    gchar *dir = g_build_filename (g_getenv ("XDG_STATE_HOME"), "bluedit", "journal", NULL);
+    gchar *path = g_build_filename (dir, "replay.journal", NULL);
+    g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+
+    guint last = 0;
+
+    for (gsize cut = 0; cut <= length; cut++)
+    {
+        g_assert_true (g_file_set_contents (path, journal, cut, NULL));
+
+        // Those cut inside the header, or before the first record,
+        // hold nothing to recover
+        GList *recoveries = bl_journal_find_recoveries ();
+
+        if (recoveries == NULL)
+        {
+            g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+            g_assert_cmpuint (last, ==, 0);
+            continue;
+        }
+
+        g_assert_null (recoveries->next);
+
+        BlJournalRecovery *recovery = recoveries->data;
+        GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+        GtkTextIter start;
+        GtkTextIter end;
+        GError *error = NULL;
+
+        g_assert_cmpstr (bl_journal_recovery_get_uri (recovery), ==, "file:///tmp/replay.md");
+
+        gtk_text_buffer_set_text (buffer, BASE_TEXT, -1);
+        g_assert_true (bl_journal_recovery_apply (recovery, buffer,
+                                                  gtk_text_buffer_get_char_count (buffer),
+                                                  0, &error));
+        g_assert_no_error (error);
+
+        gtk_text_buffer_get_bounds (buffer, &start, &end);
+        gchar *text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+
+        guint state = last;
+
+        while (state < states->len && g_strcmp0 (g_ptr_array_index (states, state), text) != 0)
+            state++;
+
+        if (state == states->len)
+            g_error ("Replaying %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes gave %s",
+                     cut, length, text);
+
+        last = state;
+
+        g_free (text);
+        g_object_unref (buffer);
+        bl_journal_recovery_free (recovery);
+        g_list_free (recoveries);
+    }
+
+    // The whole journal replays every edit
+    g_assert_cmpuint (last, ==, G_N_ELEMENTS (edits));
+
+    g_unlink (path);
+    g_free (path);
+    g_free (dir);
+    g_ptr_array_unref (states);
+    g_free (journal);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    // Journals are looked for under here, so keep them out of the
+    // user's own
+    gchar *state = g_dir_make_tmp ("bl-journal-test-XXXXXX", NULL);
+    g_assert_nonnull (state);
+    g_setenv ("XDG_STATE_HOME", state, TRUE);
+
+    g_test_log_set_fatal_handler (ignore_damaged_record, NULL);
+    g_test_add_func ("/journal/truncated", test_journal_truncated);
+
+    gint result = g_test_run ();
+
+    gchar *journal = g_build_filename (state, "bluedit", "journal", NULL);
+    gchar *bluedit = g_build_filename (state, "bluedit", NULL);
+    g_rmdir (journal);
+    g_rmdir (bluedit);
+    g_rmdir (state);
+    g_free (bluedit);
+    g_free (journal);
+    g_free (state);
+
+    return result;
+}